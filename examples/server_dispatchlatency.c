@@ -0,0 +1,161 @@
+/*
+ * This work is licensed under a Creative Commons CCZero 1.0 Universal License.
+ * See http://creativecommons.org/publicdomain/zero/1.0/ for more information.
+ */
+
+/*
+ * Measures the time from the dispatch of a job in the main loop until its
+ * execution in a worker thread. A dummy networklayer returns a burst of jobs in
+ * every round. Between the rounds, the workers become idle and have to be woken
+ * up again. Usage: server_dispatchlatency [rounds] [burst] [spincount]
+ */
+
+#define _XOPEN_SOURCE 500 // usleep
+
+#ifdef UA_NO_AMALGAMATION
+# include "ua_types.h"
+# include "ua_server.h"
+# include "logger_stdout.h"
+#else
+# include "open62541.h"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <unistd.h>
+#endif
+
+typedef struct {
+    UA_DateTime dispatched;
+    volatile UA_DateTime executed;
+} Sample;
+
+typedef struct {
+    Sample *samples;
+    size_t burst;
+    volatile UA_Boolean pending; // the next call to getJobs dispatches a burst
+} LatencyLayer;
+
+static void measure(UA_Server *server, void *data) {
+    Sample *sample = data;
+    sample->executed = UA_DateTime_nowMonotonic();
+}
+
+static UA_StatusCode latencyStart(UA_ServerNetworkLayer *nl, UA_Logger logger) {
+    return UA_STATUSCODE_GOOD;
+}
+
+static size_t latencyGetJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt16 timeout) {
+    LatencyLayer *layer = nl->handle;
+    if(!layer->pending)
+        return 0;
+    layer->pending = false;
+    UA_Job *js = malloc(layer->burst * sizeof(UA_Job));
+    if(!js)
+        return 0;
+    UA_DateTime now = UA_DateTime_nowMonotonic();
+    for(size_t i = 0; i < layer->burst; i++) {
+        layer->samples[i].dispatched = now;
+        layer->samples[i].executed = 0;
+        js[i].type = UA_JOBTYPE_METHODCALL;
+        js[i].priority = UA_JOBPRIORITY_NORMAL;
+        js[i].job.methodCall.method = measure;
+        js[i].job.methodCall.data = &layer->samples[i];
+    }
+    *jobs = js;
+    return layer->burst;
+}
+
+static size_t latencyStop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
+    *jobs = NULL;
+    return 0;
+}
+
+static void latencyDeleteMembers(UA_ServerNetworkLayer *nl) {
+    UA_String_deleteMembers(&nl->discoveryUrl);
+}
+
+static void sleepMs(unsigned int ms) {
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+static void
+runBenchmark(UA_UInt16 nThreads, size_t rounds, size_t burst, UA_UInt16 spinCount) {
+    LatencyLayer layer;
+    layer.samples = malloc(burst * sizeof(Sample));
+    layer.burst = burst;
+    layer.pending = false;
+
+    UA_ServerNetworkLayer nl;
+    nl.handle = &layer;
+    nl.discoveryUrl = UA_STRING_ALLOC("opc.tcp://localhost:16664");
+    nl.start = latencyStart;
+    nl.getJobs = latencyGetJobs;
+    nl.stop = latencyStop;
+    nl.deleteMembers = latencyDeleteMembers;
+
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.logger = Logger_Stdout;
+    config.networkLayers = &nl;
+    config.networkLayersSize = 1;
+    config.nThreads = nThreads;
+    config.workerSpinCount = spinCount;
+    UA_Server *server = UA_Server_new(config);
+    UA_Server_run_startup(server);
+
+    UA_DateTime sum = 0;
+    UA_DateTime max = 0;
+    for(size_t r = 0; r < rounds; r++) {
+        sleepMs(1); // let the workers park
+        layer.pending = true;
+        UA_Server_run_iterate(server, false);
+        for(size_t i = 0; i < burst; i++) {
+            while(layer.samples[i].executed == 0)
+                UA_Server_run_iterate(server, false);
+            UA_DateTime latency = layer.samples[i].executed - layer.samples[i].dispatched;
+            sum += latency;
+            if(latency > max)
+                max = latency;
+        }
+    }
+
+    UA_Server_run_shutdown(server);
+    UA_Server_delete(server);
+    nl.deleteMembers(&nl);
+    free(layer.samples);
+
+    /* UA_DateTime has a resolution of 100ns */
+    printf("%2u worker(s): mean latency %.1f us, max latency %.1f us\n", nThreads,
+           (double)sum / (double)(rounds * burst) / 10.0, (double)max / 10.0);
+}
+
+int main(int argc, char** argv) {
+#ifndef UA_ENABLE_MULTITHREADING
+    printf("The dispatch latency requires multithreading\n");
+    return 0;
+#else
+    size_t rounds = 1000;
+    size_t burst = 1;
+    UA_UInt16 spinCount = 0;
+    if(argc > 1)
+        rounds = (size_t)atoi(argv[1]);
+    if(argc > 2)
+        burst = (size_t)atoi(argv[2]);
+    if(argc > 3)
+        spinCount = (UA_UInt16)atoi(argv[3]);
+    if(rounds == 0 || burst == 0)
+        return 1;
+
+    const UA_UInt16 workers[3] = {1, 4, 16};
+    for(size_t i = 0; i < 3; i++)
+        runBenchmark(workers[i], rounds, burst, spinCount);
+    return 0;
+#endif
+}
@@ -39,6 +39,10 @@ typedef struct UA_ConnectionConfig {
 
 extern const UA_EXPORT UA_ConnectionConfig UA_ConnectionConfig_standard;
 
+/* Number of chunked requests per connection that are tracked to select the
+   dispatch lane of the messages */
+#define UA_CONNECTION_CHUNKEDREQUESTS 4
+
 /* Forward declaration */
 struct UA_SecureChannel;
 typedef struct UA_SecureChannel UA_SecureChannel;
@@ -57,6 +61,9 @@ struct UA_Connection {
                      ///  simplifies the design.
     void *handle; ///< A pointer to the networklayer
     UA_ByteString incompleteMessage; ///< A half-received message (TCP is a streaming protocol) is stored here
+    UA_UInt32 chunkedRequests[UA_CONNECTION_CHUNKEDREQUESTS]; ///< Requests whose final chunk was not yet
+                                                               ///  received. Used only in the server main loop.
+    size_t chunkedRequestsSize; ///< Exceeds UA_CONNECTION_CHUNKEDREQUESTS if requests were not tracked
 
     /** Get a buffer for sending */
     UA_StatusCode (*getSendBuffer)(UA_Connection *connection, size_t length, UA_ByteString *buf);
@@ -28,6 +28,14 @@ typedef struct UA_Server UA_Server;
 
 typedef void (*UA_ServerCallback)(UA_Server *server, void *data);
 
+/** With multithreading, jobs are dispatched to the workers in separate lanes
+    per priority. The lanes are scheduled with a weighted round-robin. */
+typedef enum {
+    UA_JOBPRIORITY_NORMAL = 0, ///< The default
+    UA_JOBPRIORITY_REALTIME = 1, ///< Latency-critical jobs, e.g. publish and session handling
+    UA_JOBPRIORITY_BULK = 2 ///< Large requests that shall not delay the other jobs
+} UA_JobPriority;
+
 /** Jobs describe work that is executed once or repeatedly in the server */
 typedef struct {
     enum {
@@ -38,6 +46,7 @@ typedef struct {
         UA_JOBTYPE_METHODCALL, ///< Call the method as soon as possible
         UA_JOBTYPE_METHODCALL_DELAYED, ///< Call the method as soon as all previous jobs have finished
     } type;
+    UA_JobPriority priority; ///< Selects the dispatch lane (only if multithreading is enabled)
     union {
         UA_Connection *closeConnection;
         struct {
@@ -42,6 +42,28 @@ typedef struct {
 
 typedef struct {
     UA_UInt16 nThreads; // only if multithreading is enabled
+    UA_Boolean workStealing; // one dispatch queue per worker thread (only if multithreading is enabled)
+    UA_UInt32 batchPoolSize; // preallocated batches of jobs for the workers (only if multithreading is enabled)
+    UA_UInt32 mainLoopJobsCapacity; // slots in the ring of jobs for the main loop, rounded up to a power of two
+                                    // (only if multithreading is enabled)
+    UA_Boolean adaptiveBatching; // size the batches of jobs by their measured cost (only if multithreading is enabled)
+    UA_Boolean connectionAffinity; // process the jobs of a connection always in the same worker and in order. The
+                                   // messages are not sorted into the priority lanes (only if multithreading is enabled)
+    UA_UInt16 affinityRebalanceFactor; // move jobs away from a worker whose queue exceeds this multiple of the average
+                                       // queue length. 0 disables rebalancing. Rebalanced connections lose the ordering.
+    UA_UInt16 realtimeLaneWeight; // share of the workers for the job priority lanes (only if multithreading is enabled)
+    UA_UInt16 normalLaneWeight;
+    UA_UInt16 bulkLaneWeight;
+    UA_UInt32 bulkOperationsThreshold; // Browse/Read/Write requests with more operations use the bulk lane. 0 disables.
+    UA_UInt16 workerSpinCount; // low-latency mode: idle workers poll their queue this often before they sleep.
+                               // 0 disables spinning (only if multithreading is enabled)
+
+    /* Placement of the threads (only if multithreading is enabled and only on
+       Linux). A pinned worker allocates its memory on its local NUMA node. */
+    size_t workerCpusSize;
+    UA_UInt16 *workerCpus; // worker i runs on the i-th cpu (round-robin) except mainLoopCpu. Empty disables pinning.
+    UA_Int32 mainLoopCpu; // pin the thread that runs the main loop and the networklayers. -1 disables pinning.
+    UA_Boolean nameThreads; // name the worker threads "ua-worker-<n>" for profilers
     UA_Logger logger;
 
     UA_BuildInfo buildInfo;
@@ -117,6 +139,56 @@ UA_StatusCode UA_EXPORT UA_Server_addRepeatedJob(UA_Server *server, UA_Job job,
  */
 UA_StatusCode UA_EXPORT UA_Server_removeRepeatedJob(UA_Server *server, UA_Guid jobId);
 
+/** Opaque handle of a repeated job */
+struct UA_RepeatedJob;
+typedef struct UA_RepeatedJob UA_RepeatedJob;
+
+/**
+ * Add a repeated job and return a handle for it. Removing the job via the handle does not require
+ * a search among all repeated jobs (as removing via the guid does).
+ *
+ * @param server The server object.
+ * @param job The job that shall be added.
+ * @param interval The job shall be repeatedly executed with the given interval (in ms). The
+ *        interval must be larger than 5ms.
+ * @param handle Set to the handle of the repeated job. The handle is valid until the job is
+ *        removed with UA_Server_removeRepeatedJobHandle.
+ * @return Upon success, UA_STATUSCODE_GOOD is returned. An error code otherwise.
+ */
+UA_StatusCode UA_EXPORT
+UA_Server_addRepeatedJobHandle(UA_Server *server, UA_Job job, UA_UInt32 interval,
+                               UA_RepeatedJob **handle);
+
+/**
+ * Remove a repeated job via its handle. The entry will be removed asynchronously during the next
+ * iteration of the server main loop. The handle must not be used afterwards.
+ *
+ * @param server The server object.
+ * @param handle The handle of the job that shall be removed.
+ * @return Upon sucess, UA_STATUSCODE_GOOD is returned. An error code otherwise.
+ */
+UA_StatusCode UA_EXPORT UA_Server_removeRepeatedJobHandle(UA_Server *server, UA_RepeatedJob *handle);
+
+#ifdef UA_ENABLE_MULTITHREADING
+typedef struct {
+    UA_UInt32 batchSize; // average number of jobs per batch in the last dispatch
+    UA_UInt32 queueDepth; // number of batches waiting to be processed by the workers
+    UA_UInt32 mainLoopJobsOverflow; // jobs for the main loop that did not fit into the ring (since the start)
+    UA_UInt32 delayedJobsPending; // objects waiting in UA_Server_delayedFree (and delayed callbacks)
+                                  // until no worker can access them anymore
+} UA_DispatchStatistics;
+
+/**
+ * Get the live statistics of the job dispatch to the worker threads.
+ *
+ * @param server The server object.
+ * @param stats The statistics are written here.
+ * @return Upon success, UA_STATUSCODE_GOOD is returned. An error code otherwise.
+ */
+UA_StatusCode UA_EXPORT
+UA_Server_getDispatchStatistics(UA_Server *server, UA_DispatchStatistics *stats);
+#endif
+
 /** @brief Add a new namespace to the server. Returns the index of the new namespace */
 UA_UInt16 UA_EXPORT UA_Server_addNamespace(UA_Server *server, const char* name);
 
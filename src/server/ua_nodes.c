@@ -1,6 +1,89 @@
 #include "ua_nodes.h"
 #include "ua_util.h"
 
+#ifdef UA_ENABLE_MULTITHREADING
+
+typedef struct {
+    UA_Variant value;
+    struct rcu_head rcu_head;
+} UA_VariableNodeValue;
+
+struct UA_VariableNodeValueSlot {
+    UA_UInt32 refCount; // copies of the node that share the slot
+    UA_VariableNodeValue *current;
+};
+
+static void deleteValue(struct rcu_head *head) {
+    UA_VariableNodeValue *v = container_of(head, UA_VariableNodeValue, rcu_head);
+    UA_Variant_deleteMembers(&v->value);
+    UA_free(v);
+}
+
+const UA_Variant * UA_VariableNode_getValue(const UA_VariableNode *node) {
+    if(node->nodeClass != UA_NODECLASS_VARIABLE || !node->valueSlot)
+        return &node->value.variant.value;
+    UA_VariableNodeValue *v = rcu_dereference(node->valueSlot->current);
+    return &v->value;
+}
+
+UA_StatusCode UA_VariableNode_initValueSlot(UA_VariableNode *node) {
+    UA_assert(node->nodeClass == UA_NODECLASS_VARIABLE);
+    UA_assert(node->valueSource == UA_VALUESOURCE_VARIANT && !node->valueSlot);
+    struct UA_VariableNodeValueSlot *slot = UA_malloc(sizeof(struct UA_VariableNodeValueSlot));
+    if(!slot)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    slot->current = UA_malloc(sizeof(UA_VariableNodeValue));
+    if(!slot->current) {
+        UA_free(slot);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    slot->refCount = 1;
+    slot->current->value = node->value.variant.value;
+    UA_Variant_init(&node->value.variant.value);
+    node->valueSlot = slot;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* When the last copy of the node is deleted, no reader can reach the slot
+   anymore. So the current value is deleted right away. */
+void UA_VariableNode_releaseValueSlot(UA_VariableNode *node) {
+    struct UA_VariableNodeValueSlot *slot = node->valueSlot;
+    if(!slot)
+        return;
+    node->valueSlot = NULL;
+    if(uatomic_add_return(&slot->refCount, -1) > 0)
+        return;
+    deleteValue(&slot->current->rcu_head);
+    UA_free(slot);
+}
+
+UA_StatusCode
+UA_VariableNode_updateValue(const UA_VariableNode *node,
+                            UA_VariableNodeValueUpdate update, const void *data) {
+    UA_ASSERT_RCU_LOCKED();
+    struct UA_VariableNodeValueSlot *slot = node->valueSlot;
+    UA_VariableNodeValue *v = UA_malloc(sizeof(UA_VariableNodeValue));
+    if(!v)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    while(true) {
+        UA_VariableNodeValue *old = rcu_dereference(slot->current);
+        UA_Variant_init(&v->value);
+        UA_StatusCode retval = update(&old->value, &v->value, data);
+        if(retval != UA_STATUSCODE_GOOD) {
+            UA_Variant_deleteMembers(&v->value);
+            UA_free(v);
+            return retval;
+        }
+        if(rcu_cmpxchg_pointer(&slot->current, old, v) == old) {
+            call_rcu(&old->rcu_head, deleteValue);
+            return UA_STATUSCODE_GOOD;
+        }
+        UA_Variant_deleteMembers(&v->value);
+    }
+}
+
+#endif
+
 void UA_Node_deleteMembersAnyNodeClass(UA_Node *node) {
     /* delete standard content */
     UA_NodeId_deleteMembers(&node->nodeId);
@@ -24,6 +107,10 @@ void UA_Node_deleteMembersAnyNodeClass(UA_Node *node) {
         UA_VariableNode *p = (UA_VariableNode*)node;
         if(p->valueSource == UA_VALUESOURCE_VARIANT)
             UA_Variant_deleteMembers(&p->value.variant.value);
+#ifdef UA_ENABLE_MULTITHREADING
+        if(node->nodeClass == UA_NODECLASS_VARIABLE)
+            UA_VariableNode_releaseValueSlot(p);
+#endif
         break;
     }
     case UA_NODECLASS_REFERENCETYPE: {
@@ -56,6 +143,13 @@ UA_VariableNode_copy(const UA_VariableNode *src, UA_VariableNode *dst) {
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
         dst->value.variant.callback = src->value.variant.callback;
+#ifdef UA_ENABLE_MULTITHREADING
+        /* The copy shares the value slot */
+        if(src->valueSlot) {
+            uatomic_inc(&src->valueSlot->refCount);
+            dst->valueSlot = src->valueSlot;
+        }
+#endif
     } else
         dst->value.dataSource = src->value.dataSource;
     dst->accessLevel = src->accessLevel;
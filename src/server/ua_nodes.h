@@ -78,8 +78,42 @@ typedef struct {
     UA_Byte userAccessLevel;
     UA_Double minimumSamplingInterval;
     UA_Boolean historizing;
+#ifdef UA_ENABLE_MULTITHREADING
+    /* After the first write, the value is moved to a slot that is shared by all
+       copies of the node. Writes swap the value in the slot without replacing
+       the node. */
+    struct UA_VariableNodeValueSlot *valueSlot;
+#endif
 } UA_VariableNode;
 
+/* Returns the current value of a VariableNode or VariableTypeNode with a
+ * variant value source. With multithreading, the value is valid until the rcu
+ * read lock is released. */
+#ifdef UA_ENABLE_MULTITHREADING
+const UA_Variant * UA_VariableNode_getValue(const UA_VariableNode *node);
+
+/* Moves the value of the node into a new value slot */
+UA_StatusCode UA_VariableNode_initValueSlot(UA_VariableNode *node);
+
+/* Release the value slot of the node (if present). The value is deleted if no
+ * other copy of the node uses the slot. */
+void UA_VariableNode_releaseValueSlot(UA_VariableNode *node);
+
+/* Computes the new value from the current value of the slot */
+typedef UA_StatusCode (*UA_VariableNodeValueUpdate)(const UA_Variant *oldValue,
+                                                    UA_Variant *newValue, const void *data);
+
+/* Swap a new value into the slot. The update is repeated if the value was
+ * changed concurrently. The old value is freed after the rcu grace period. */
+UA_StatusCode UA_VariableNode_updateValue(const UA_VariableNode *node,
+                                          UA_VariableNodeValueUpdate update, const void *data);
+#else
+static UA_INLINE const UA_Variant *
+UA_VariableNode_getValue(const UA_VariableNode *node) {
+    return &node->value.variant.value;
+}
+#endif
+
 /********************/
 /* VariableTypeNode */
 /********************/
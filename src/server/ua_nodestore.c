@@ -3,46 +3,45 @@
 #include "ua_statuscodes.h"
 #include <stdio.h>
 
-#define UA_NODESTORE_MINSIZE 64
+/* The single-threaded nodestore. The nodes are kept in the direct index of
+ * ua_nodestore_dense.inc or in a hash-map. The hash-map is selected at build
+ * time: ua_nodestore_hashmap.inc (default) or ua_nodestore_robinhood.inc. */
+
+#define UA_NODESTORE_BATCH 16 // lookups that are prefetched together
 
 typedef struct UA_NodeStoreEntry {
     struct UA_NodeStoreEntry *orig; // the version this is a copy from (or NULL)
+    UA_Boolean packed; // the strings and references are in the arena
+    size_t interned; // the first strings of the node are in the string pool
+    struct UA_NodeStoreChildIndex *children; // built on the first lookup by browsename
+    struct UA_NodeStoreRefIndex *refGroups; // built on the first lookup by reference type
     UA_Node node;
 } UA_NodeStoreEntry;
 
-struct UA_NodeStore {
-    UA_NodeStoreEntry **entries;
-    UA_UInt32 size;
-    UA_UInt32 count;
-    UA_UInt32 sizePrimeIndex;
-};
-
 #include "ua_nodestore_hash.inc"
+#include "ua_nodestore_hashmap.inc"
+#include "ua_nodestore_robinhood.inc"
+#include "ua_nodestore_dense.inc"
+#include "ua_nodestore_strings.inc"
+#include "ua_nodestore_alloc.inc"
+#include "ua_nodestore_image.inc"
+#include "ua_nodestore_snapshot.inc"
+#include "ua_nodestore_children.inc"
+#include "ua_nodestore_references.inc"
 
-/* The size of the hash-map is always a prime number. They are chosen to be
-   close to the next power of 2. So the size ca. doubles with each prime. */
-static hash_t const primes[] = {
-    7,         13,         31,         61,         127,         251,
-    509,       1021,       2039,       4093,       8191,        16381,
-    32749,     65521,      131071,     262139,     524287,      1048573,
-    2097143,   4194301,    8388593,    16777213,   33554393,    67108859,
-    134217689, 268435399,  536870909,  1073741789, 2147483647,  4294967291
+struct UA_NodeStore {
+    UA_NodeStoreDenseIndex dense;
+    UA_NodeStoreArena arena;
+    UA_NodeStoreImageOverlay image;
+    UA_NodeStoreSnapshotOverlay snapshot;
+    UA_NodeStoreChildren children;
+    const UA_Node *editable; // the last node returned by UA_NodeStore_getEditable
+    UA_NodeStoreMap map;
+    UA_NodeStoreSlab slabs[UA_NODESTORE_SLABS];
+    UA_NodeStoreStringPool strings;
 };
 
-static UA_UInt16 higher_prime_index(hash_t n) {
-    UA_UInt16 low  = 0;
-    UA_UInt16 high = (UA_UInt16)(sizeof(primes) / sizeof(hash_t));
-    while(low != high) {
-        UA_UInt16 mid = (UA_UInt16)(low + ((high - low) / 2));
-        if(n > primes[mid])
-            low = (UA_UInt16)(mid + 1);
-        else
-            high = mid;
-    }
-    return low;
-}
-
-static UA_NodeStoreEntry * instantiateEntry(UA_NodeClass nodeClass) {
+static UA_NodeStoreEntry * instantiateEntry(UA_NodeStore *ns, UA_NodeClass nodeClass) {
     size_t size = sizeof(UA_NodeStoreEntry) - sizeof(UA_Node);
     switch(nodeClass) {
     case UA_NODECLASS_OBJECT:
@@ -72,90 +71,204 @@ static UA_NodeStoreEntry * instantiateEntry(UA_NodeClass nodeClass) {
     default:
         return NULL;
     }
-    UA_NodeStoreEntry *entry = UA_calloc(1, size);
+    UA_NodeStoreEntry *entry = slabAlloc(ns->slabs, nodeClass, size);
     if(!entry)
         return NULL;
     entry->node.nodeClass = nodeClass;
     return entry;
 }
 
-static void deleteEntry(UA_NodeStoreEntry *entry) {
+static void deleteEntry(UA_NodeStore *ns, UA_NodeStoreEntry *entry) {
+    if(entry->packed || entry->interned > 0) {
+        releaseNodeStrings(&ns->strings, &entry->node, entry->interned, entry->packed);
+        arenaForgetNode(&entry->node);
+    }
+    UA_free(entry->children);
+    refIndexDelete(entry->refGroups);
+    UA_NodeClass nodeClass = entry->node.nodeClass;
     UA_Node_deleteMembersAnyNodeClass(&entry->node);
-    UA_free(entry);
+    slabFree(ns->slabs, nodeClass, entry);
 }
 
-/* Returns true if an entry was found under the nodeid. Otherwise, returns
-   false and sets slot to a pointer to the next free slot. */
-static UA_Boolean
-containsNodeId(const UA_NodeStore *ns, const UA_NodeId *nodeid, UA_NodeStoreEntry ***entry) {
-    hash_t h = hash(nodeid);
-    UA_UInt32 size = ns->size;
-    hash_t idx = mod(h, size);
-    UA_NodeStoreEntry *e = ns->entries[idx];
+static size_t packedSize(UA_NodeStoreEntry *entry) {
+    return entry->packed ? 0 : arenaNodeSize(&entry->node, entry->interned);
+}
 
-    if(!e) {
-        *entry = &ns->entries[idx];
-        return false;
-    }
+static void packEntry(UA_NodeStoreEntry *entry, UA_Byte **pos) {
+    if(entry->packed)
+        return;
+    arenaPackNode(&entry->node, entry->interned, pos);
+    entry->packed = true;
+}
 
-    if(UA_NodeId_equal(&e->node.nodeId, nodeid)) {
-        *entry = &ns->entries[idx];
-        return true;
-    }
+/* Returns the entry from the direct index or the hash-map */
+static UA_NodeStoreEntry *
+findEntry(const UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    UA_Node **slot = denseSlot(&ns->dense, nodeid);
+    if(!slot)
+        slot = mapFind(&ns->map, nodeid, hash(nodeid));
+    if(!slot || !*slot)
+        return NULL;
+    return container_of(*slot, UA_NodeStoreEntry, node);
+}
 
-    hash_t hash2 = mod2(h, size);
-    for(;;) {
-        idx += hash2;
-        if(idx >= size)
-            idx -= size;
-        e = ns->entries[idx];
-        if(!e) {
-            *entry = &ns->entries[idx];
-            return false;
-        }
-        if(UA_NodeId_equal(&e->node.nodeId, nodeid)) {
-            *entry = &ns->entries[idx];
-            return true;
+/* Move the entries from the hash-map into the grown direct range of the
+   namespace */
+static void
+moveToDense(UA_NodeStore *ns, UA_UInt16 namespaceIndex, UA_UInt32 grownFrom) {
+    size_t i = 0;
+    for(UA_Node **slot; (slot = mapNext(&ns->map, &i));) {
+        UA_Node *node = *slot;
+        if(!denseMoved(&ns->dense, &node->nodeId, namespaceIndex, grownFrom)) {
+            i++;
+            continue;
         }
+        *denseSlot(&ns->dense, &node->nodeId) = node;
+        mapRemove(&ns->map, slot); // the slot may be refilled
     }
+}
 
-    /* NOTREACHED */
-    return true;
+/* Is the nodeid used by an entry, a visible image node or a snapshot node that
+   was not decoded yet? */
+static UA_Boolean containsNode(const UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    UA_UInt32 snapshotSlot;
+    return findEntry(ns, nodeid) || imageGet(&ns->image, nodeid) ||
+        snapshotFind(&ns->snapshot, nodeid, &snapshotSlot);
 }
 
-/* The occupancy of the table after the call will be about 50% */
-static UA_StatusCode expand(UA_NodeStore *ns) {
-    UA_UInt32 osize = ns->size;
-    UA_UInt32 count = ns->count;
-    /* Resize only when table after removal of unused elements is either too full or too empty  */
-    if(count * 2 < osize && (count * 8 > osize || osize <= UA_NODESTORE_MINSIZE))
-        return UA_STATUSCODE_GOOD;
+/* Insert the editable copy of an image node. The image node is hidden until
+   the copy is removed. If insertion fails, the node is deleted. */
+static UA_StatusCode shadowImageNode(UA_NodeStore *ns, UA_Node *node, UA_UInt32 imageSlot) {
+    imageHide(&ns->image, imageSlot);
+    UA_StatusCode retval = UA_NodeStore_insert(ns, node);
+    if(retval != UA_STATUSCODE_GOOD)
+        imageUnhide(&ns->image, imageSlot);
+    return retval;
+}
 
-    UA_NodeStoreEntry **oentries = ns->entries;
-    UA_UInt32 nindex = higher_prime_index(count * 2);
-    UA_UInt32 nsize = primes[nindex];
-    UA_NodeStoreEntry **nentries;
-    if(!(nentries = UA_calloc(nsize, sizeof(UA_NodeStoreEntry*))))
-        return UA_STATUSCODE_BADOUTOFMEMORY;
+/* Image nodes are hidden instead of removed */
+static UA_StatusCode removeImageNode(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    UA_UInt32 slot;
+    if(!imageFind(&ns->image, nodeid, &slot) || imageHidden(&ns->image, slot))
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    imageHide(&ns->image, slot);
+    return UA_STATUSCODE_GOOD;
+}
 
-    ns->entries = nentries;
-    ns->size = nsize;
-    ns->sizePrimeIndex = nindex;
+/* Insert the node that takes the place of a snapshot node. The snapshot node
+   is marked as loaded. If insertion fails, the node is deleted. */
+static UA_StatusCode
+replaceSnapshotNode(UA_NodeStore *ns, UA_Node *node, UA_UInt32 snapshotSlot) {
+    snapshotSetLoaded(&ns->snapshot, snapshotSlot, true);
+    UA_StatusCode retval = UA_NodeStore_insert(ns, node);
+    if(retval != UA_STATUSCODE_GOOD)
+        snapshotSetLoaded(&ns->snapshot, snapshotSlot, false);
+    return retval;
+}
 
-    /* recompute the position of every entry and insert the pointer */
-    for(size_t i = 0, j = 0; i < osize && j < count; i++) {
-        if(!oentries[i])
-            continue;
-        UA_NodeStoreEntry **e;
-        containsNodeId(ns, &oentries[i]->node.nodeId, &e);  /* We know this returns an empty entry here */
-        *e = oentries[i];
-        j++;
-    }
+/* Snapshot nodes that were not decoded yet are only marked as loaded */
+static UA_StatusCode removeSnapshotNode(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    UA_UInt32 slot;
+    if(!snapshotFind(&ns->snapshot, nodeid, &slot))
+        return removeImageNode(ns, nodeid);
+    snapshotSetLoaded(&ns->snapshot, slot, true);
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Decode a node of the snapshot into the nodestore */
+static UA_NodeStoreEntry *
+loadSnapshotEntry(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    UA_UInt32 slot;
+    if(!snapshotFind(&ns->snapshot, nodeid, &slot))
+        return NULL;
+    UA_Node *node = snapshotDecode(ns, &ns->snapshot, slot);
+    if(!node || replaceSnapshotNode(ns, node, slot) != UA_STATUSCODE_GOOD)
+        return NULL;
+    return container_of(node, UA_NodeStoreEntry, node);
+}
 
-    UA_free(oentries);
+static UA_NodeStoreEntry *
+findOrLoadEntry(UA_NodeStore *ns, const UA_NodeId *nodeid) {
+    UA_NodeStoreEntry *entry = findEntry(ns, nodeid);
+    if(!entry)
+        entry = loadSnapshotEntry(ns, nodeid);
+    return entry;
+}
+
+/* Decode all remaining nodes of the snapshot */
+static UA_StatusCode loadSnapshotEntries(UA_NodeStore *ns) {
+    for(size_t i = 0; snapshotNext(&ns->snapshot, &i); i++) {
+        UA_Node *node = snapshotDecode(ns, &ns->snapshot, (UA_UInt32)i);
+        if(!node)
+            return UA_STATUSCODE_BADDECODINGERROR;
+        UA_StatusCode retval = replaceSnapshotNode(ns, node, (UA_UInt32)i);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+    }
     return UA_STATUSCODE_GOOD;
 }
 
+/* The parts of the nodestore in the order of the cursor. Snapshot nodes are
+   decoded into the hash-map when the cursor reaches them. So they come last
+   and are visited once. */
+#define UA_NODESTORE_CURSOR_DENSE 0
+#define UA_NODESTORE_CURSOR_HASHMAP 1
+#define UA_NODESTORE_CURSOR_IMAGE 2
+#define UA_NODESTORE_CURSOR_SNAPSHOT 3
+#define UA_NODESTORE_CURSOR_DONE 4
+
+/* Returns the next node that is kept in an entry (dense ranges and hash-map)
+   or NULL when the cursor has passed the entries */
+static UA_Node * nextEntry(UA_NodeStore *ns, UA_NodeStoreCursor *c) {
+    if(c->part == UA_NODESTORE_CURSOR_DENSE) {
+        UA_Node *node = denseNext(&ns->dense, &c->index, &c->offset);
+        if(node)
+            return node;
+        c->part = UA_NODESTORE_CURSOR_HASHMAP;
+        c->index = 0;
+    }
+    if(c->part != UA_NODESTORE_CURSOR_HASHMAP)
+        return NULL;
+    UA_Node **slot = mapNext(&ns->map, &c->index);
+    if(slot) {
+        c->index++;
+        return *slot;
+    }
+    c->part = UA_NODESTORE_CURSOR_IMAGE;
+    c->index = 0;
+    return NULL;
+}
+
+static const UA_Node * nextNode(UA_NodeStore *ns, UA_NodeStoreCursor *c) {
+    const UA_Node *node = nextEntry(ns, c);
+    if(node)
+        return node;
+    if(c->part == UA_NODESTORE_CURSOR_IMAGE) {
+        if((node = imageNext(&ns->image, &c->index)))
+            return node;
+        c->part = UA_NODESTORE_CURSOR_SNAPSHOT;
+        c->index = 0;
+    }
+    /* Nodes that cannot be decoded are skipped */
+    for(; c->part == UA_NODESTORE_CURSOR_SNAPSHOT &&
+            snapshotNext(&ns->snapshot, &c->index); c->index++) {
+        UA_UInt32 slot = (UA_UInt32)c->index;
+        UA_Node *decoded = snapshotDecode(ns, &ns->snapshot, slot);
+        if(decoded && replaceSnapshotNode(ns, decoded, slot) == UA_STATUSCODE_GOOD) {
+            c->index++;
+            return decoded;
+        }
+    }
+    c->part = UA_NODESTORE_CURSOR_DONE;
+    c->done = true;
+    return NULL;
+}
+
+static UA_Boolean isEmpty(const UA_NodeStore *ns) {
+    return ns->map.count == 0 && denseEmpty(&ns->dense) && !ns->image.image &&
+        !ns->snapshot.data.data;
+}
+
 /**********************/
 /* Exported functions */
 /**********************/
@@ -164,10 +277,15 @@ UA_NodeStore * UA_NodeStore_new(void) {
     UA_NodeStore *ns;
     if(!(ns = UA_malloc(sizeof(UA_NodeStore))))
         return NULL;
-    ns->sizePrimeIndex = higher_prime_index(UA_NODESTORE_MINSIZE);
-    ns->size = primes[ns->sizePrimeIndex];
-    ns->count = 0;
-    if(!(ns->entries = UA_calloc(ns->size, sizeof(UA_NodeStoreEntry*)))) {
+    denseInit(&ns->dense);
+    arenaInit(&ns->arena);
+    imageInit(&ns->image);
+    snapshotInit(&ns->snapshot);
+    childrenInit(&ns->children);
+    ns->editable = NULL;
+    slabsInit(ns->slabs);
+    stringPoolInit(&ns->strings);
+    if(mapInit(&ns->map) != UA_STATUSCODE_GOOD) {
         UA_free(ns);
         return NULL;
     }
@@ -175,96 +293,208 @@ UA_NodeStore * UA_NodeStore_new(void) {
 }
 
 void UA_NodeStore_delete(UA_NodeStore *ns) {
-    UA_UInt32 size = ns->size;
-    UA_NodeStoreEntry **entries = ns->entries;
-    for(UA_UInt32 i = 0; i < size; i++) {
-        if(entries[i])
-            deleteEntry(entries[i]);
-    }
-    UA_free(ns->entries);
+    UA_NodeStoreCursor c;
+    UA_NodeStoreCursor_init(&c);
+    for(UA_Node *node; (node = nextEntry(ns, &c));)
+        UA_NodeStore_deleteNode(ns, node);
+    denseDeleteMembers(&ns->dense);
+    arenaDeleteMembers(&ns->arena);
+    imageDeleteMembers(&ns->image);
+    snapshotDeleteMembers(&ns->snapshot);
+    childrenDeleteMembers(&ns->children);
+    mapDeleteMembers(&ns->map);
     UA_free(ns);
 }
 
-UA_Node * UA_NodeStore_newNode(UA_NodeClass class) {
-    UA_NodeStoreEntry *entry = instantiateEntry(class);
+UA_Node * UA_NodeStore_newNode(UA_NodeStore *ns, UA_NodeClass class) {
+    UA_NodeStoreEntry *entry = instantiateEntry(ns, class);
     if(!entry)
         return NULL;
     return (UA_Node*)&entry->node;
 }
 
-void UA_NodeStore_deleteNode(UA_Node *node) {
-    deleteEntry(container_of(node, UA_NodeStoreEntry, node));
+void UA_NodeStore_deleteNode(UA_NodeStore *ns, UA_Node *node) {
+    deleteEntry(ns, container_of(node, UA_NodeStoreEntry, node));
 }
 
-UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
-    if(ns->size * 3 <= ns->count * 4) {
-        if(expand(ns) != UA_STATUSCODE_GOOD)
-            return UA_STATUSCODE_BADINTERNALERROR;
+UA_Node * UA_NodeStore_newInstance(UA_NodeStore *ns, const UA_Node *prototype) {
+    UA_NodeStoreEntry *entry = instantiateEntry(ns, prototype->nodeClass);
+    if(!entry)
+        return NULL;
+    /* Image nodes are constant and have no entry */
+    size_t interned = 0;
+    if(imageGet(&ns->image, &prototype->nodeId) != prototype) {
+        const UA_NodeStoreEntry *orig = container_of(prototype, UA_NodeStoreEntry, node);
+        interned = orig->interned;
     }
+    if(shareInstanceStrings(&ns->strings, &entry->node, &entry->interned, prototype,
+                            interned) != UA_STATUSCODE_GOOD) {
+        deleteEntry(ns, entry);
+        return NULL;
+    }
+    return &entry->node;
+}
 
+UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
+    UA_NodeStoreEntry *entry = container_of(node, UA_NodeStoreEntry, node);
     UA_NodeId tempNodeid;
     tempNodeid = node->nodeId;
     tempNodeid.namespaceIndex = 0;
-    UA_NodeStoreEntry **entry;
     if(UA_NodeId_isNull(&tempNodeid)) {
         if(node->nodeId.namespaceIndex == 0)
             node->nodeId.namespaceIndex = 1;
         /* find a free nodeid */
-        UA_UInt32 identifier = ns->count+1; // start value
-        UA_UInt32 size = ns->size;
+        UA_UInt32 identifier = ns->map.count+1; // start value
+        UA_UInt32 size = ns->map.size;
         hash_t increase = mod2(identifier, size);
         while(true) {
             node->nodeId.identifier.numeric = identifier;
-            if(!containsNodeId(ns, &node->nodeId, &entry))
+            if(!containsNode(ns, &node->nodeId))
                 break;
             identifier += increase;
             if(identifier >= size)
                 identifier -= size;
         }
     } else {
-        if(containsNodeId(ns, &node->nodeId, &entry)) {
-            deleteEntry(container_of(node, UA_NodeStoreEntry, node));
+        if(containsNode(ns, &node->nodeId)) {
+            deleteEntry(ns, entry);
             return UA_STATUSCODE_BADNODEIDEXISTS;
         }
     }
 
-    *entry = container_of(node, UA_NodeStoreEntry, node);
-    ns->count++;
+    /* Numeric nodeids from a dense range are indexed directly */
+    UA_UInt32 grownFrom;
+    UA_Node **dense = denseAdd(&ns->dense, &node->nodeId, &grownFrom);
+    if(dense) {
+        *dense = node;
+        if(node->nodeId.identifier.numeric >= grownFrom)
+            moveToDense(ns, node->nodeId.namespaceIndex, grownFrom);
+        ns->children.inserts++;
+        return UA_STATUSCODE_GOOD;
+    }
+
+    UA_StatusCode retval = mapInsert(&ns->map, node);
+    if(retval != UA_STATUSCODE_GOOD) {
+        deleteEntry(ns, entry);
+        return retval;
+    }
+    ns->children.inserts++;
     return UA_STATUSCODE_GOOD;
 }
 
 UA_StatusCode
 UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
-    UA_NodeStoreEntry **entry;
-    if(!containsNodeId(ns, &node->nodeId, &entry))
-        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    childrenFinishEdit(&ns->children);
     UA_NodeStoreEntry *newEntry = container_of(node, UA_NodeStoreEntry, node);
-    if(*entry != newEntry->orig) {
-        deleteEntry(newEntry);
+    UA_Node **slot = denseSlot(&ns->dense, &node->nodeId);
+    if(!slot)
+        slot = mapFind(&ns->map, &node->nodeId, hash(&node->nodeId));
+    UA_NodeStoreEntry *entry = NULL;
+    if(slot && *slot)
+        entry = container_of(*slot, UA_NodeStoreEntry, node);
+    if(!entry) {
+        /* The copy of an image node shadows the image node */
+        UA_UInt32 imageSlot;
+        if(!newEntry->orig && imageFind(&ns->image, &node->nodeId, &imageSlot) &&
+           !imageHidden(&ns->image, imageSlot)) {
+            childrenReplace(&ns->children, ns->image.image->table[imageSlot], node);
+            return shadowImageNode(ns, node, imageSlot);
+        }
+        UA_UInt32 snapshotSlot;
+        if(!newEntry->orig && snapshotFind(&ns->snapshot, &node->nodeId, &snapshotSlot)) {
+            ns->children.epoch++; // the browsename of the snapshot node is unknown
+            return replaceSnapshotNode(ns, node, snapshotSlot);
+        }
+        deleteEntry(ns, newEntry);
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    }
+    if(entry != newEntry->orig) {
+        deleteEntry(ns, newEntry);
         return UA_STATUSCODE_BADINTERNALERROR; // the node was replaced since the copy was made
     }
-    deleteEntry(*entry);
-    *entry = newEntry;
+    childrenReplace(&ns->children, &entry->node, node);
+    deleteEntry(ns, entry);
+    newEntry->orig = NULL;
+    *slot = node;
     return UA_STATUSCODE_GOOD;
 }
 
 const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_NodeStoreEntry **entry;
-    if(!containsNodeId(ns, nodeid, &entry))
-        return NULL;
-    return (const UA_Node*)&(*entry)->node;
+    UA_NodeStoreEntry *entry = findOrLoadEntry(ns, nodeid);
+    if(!entry)
+        return imageGet(&ns->image, nodeid);
+    return (const UA_Node*)&entry->node;
+}
+
+/* The lookups of a chunk are done in three passes. The first pass computes the
+   hashes and prefetches the slots, the second pass prefetches the nodes in the
+   slots and the third pass resolves the nodeids. */
+void
+UA_NodeStore_getBatch(UA_NodeStore *ns, const UA_NodeId *ids, size_t n, const UA_Node **out) {
+    hash_t hashes[UA_NODESTORE_BATCH];
+    UA_Node **dense[UA_NODESTORE_BATCH];
+    for(size_t start = 0; start < n; start += UA_NODESTORE_BATCH) {
+        const UA_NodeId *chunkIds = &ids[start];
+        size_t chunk = n - start;
+        if(chunk > UA_NODESTORE_BATCH)
+            chunk = UA_NODESTORE_BATCH;
+
+        for(size_t i = 0; i < chunk; i++) {
+            dense[i] = denseSlot(&ns->dense, &chunkIds[i]);
+            if(dense[i]) {
+                UA_prefetch(dense[i]);
+            } else {
+                hashes[i] = hash(&chunkIds[i]);
+                mapPrefetch(&ns->map, hashes[i], false);
+            }
+            imagePrefetch(&ns->image, &chunkIds[i], false);
+        }
+
+        for(size_t i = 0; i < chunk; i++) {
+            if(dense[i])
+                UA_prefetch(*dense[i]);
+            else
+                mapPrefetch(&ns->map, hashes[i], true);
+            imagePrefetch(&ns->image, &chunkIds[i], true);
+        }
+
+        /* Decoding a snapshot node inserts it and invalidates the slots */
+        UA_Boolean inserted = false;
+        for(size_t i = 0; i < chunk; i++) {
+            if(inserted) {
+                out[start + i] = UA_NodeStore_get(ns, &chunkIds[i]);
+                continue;
+            }
+            const UA_Node *node = NULL;
+            UA_Node **slot;
+            if(dense[i])
+                node = *dense[i];
+            else if((slot = mapFind(&ns->map, &chunkIds[i], hashes[i])))
+                node = *slot;
+            if(!node)
+                node = imageGet(&ns->image, &chunkIds[i]);
+            if(!node) {
+                UA_NodeStoreEntry *entry = loadSnapshotEntry(ns, &chunkIds[i]);
+                if(entry) {
+                    node = &entry->node;
+                    inserted = true;
+                }
+            }
+            out[start + i] = node;
+        }
+    }
 }
 
 UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_NodeStoreEntry **slot;
-    if(!containsNodeId(ns, nodeid, &slot))
+    UA_NodeStoreEntry *entry = findOrLoadEntry(ns, nodeid);
+    const UA_Node *node = entry ? &entry->node : imageGet(&ns->image, nodeid);
+    if(!node)
         return NULL;
-    UA_NodeStoreEntry *entry = *slot;
-    UA_NodeStoreEntry *new = instantiateEntry(entry->node.nodeClass);
+    UA_NodeStoreEntry *new = instantiateEntry(ns, node->nodeClass);
     if(!new)
         return NULL;
-    if(UA_Node_copyAnyNodeClass(&entry->node, &new->node) != UA_STATUSCODE_GOOD) {
-        deleteEntry(new);
+    if(UA_Node_copyAnyNodeClass(node, &new->node) != UA_STATUSCODE_GOOD) {
+        deleteEntry(ns, new);
         return NULL;
     }
     new->orig = entry;
@@ -272,21 +502,233 @@ UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
 }
 
 UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
-    UA_NodeStoreEntry **slot;
-    if(!containsNodeId(ns, nodeid, &slot))
-        return UA_STATUSCODE_BADNODEIDUNKNOWN;
-    deleteEntry(*slot);
-    *slot = NULL;
-    ns->count--;
-    /* Downsize the hashmap if it is very empty */
-    if(ns->count * 8 < ns->size && ns->size > 32)
-        expand(ns); // this can fail. we just continue with the bigger hashmap.
+    /* The child indices may point to the node */
+    childrenFinishEdit(&ns->children);
+    ns->children.epoch++;
+    UA_Node **dense = denseSlot(&ns->dense, nodeid);
+    if(dense) {
+        if(!*dense)
+            return removeSnapshotNode(ns, nodeid);
+        denseRemove(&ns->dense, nodeid);
+        UA_NodeStore_deleteNode(ns, *dense);
+        *dense = NULL;
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_Node **slot = mapFind(&ns->map, nodeid, hash(nodeid));
+    if(!slot)
+        return removeSnapshotNode(ns, nodeid);
+    denseRemove(&ns->dense, nodeid);
+    UA_NodeStore_deleteNode(ns, *slot);
+    mapRemove(&ns->map, slot);
+    mapShrink(&ns->map);
     return UA_STATUSCODE_GOOD;
 }
 
 void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor) {
-    for(UA_UInt32 i = 0; i < ns->size; i++) {
-        if(ns->entries[i])
-            visitor((UA_Node*)&ns->entries[i]->node);
+    UA_NodeStoreCursor c;
+    UA_NodeStoreCursor_init(&c);
+    for(const UA_Node *node; (node = nextNode(ns, &c));)
+        visitor(node);
+}
+
+void UA_NodeStoreCursor_init(UA_NodeStoreCursor *cursor) {
+    memset(cursor, 0, sizeof(UA_NodeStoreCursor));
+}
+
+void UA_NodeStoreCursor_deleteMembers(UA_NodeStoreCursor *cursor) {
+    UA_NodeStoreCursor_init(cursor);
+}
+
+UA_StatusCode
+UA_NodeStore_iterateCursor(UA_NodeStore *ns, UA_NodeStoreCursor *cursor, size_t max,
+                           UA_NodeStore_nodeCallback callback, void *handle) {
+    for(size_t i = 0; max == 0 || i < max; i++) {
+        const UA_Node *node = nextNode(ns, cursor);
+        if(!node)
+            break;
+        UA_StatusCode retval = callback(node, handle);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
     }
+    return UA_STATUSCODE_GOOD;
+}
+
+void UA_NodeStore_maintain(UA_NodeStore *ns, UA_NodeStoreCursor *cursor, size_t max) {
+    childrenFinishEdit(&ns->children);
+    for(size_t i = 0; max == 0 || i < max; i++) {
+        UA_Node *node = nextEntry(ns, cursor);
+        if(!node) {
+            cursor->done = true;
+            return;
+        }
+        UA_NodeStoreEntry *entry = container_of(node, UA_NodeStoreEntry, node);
+        childIndexCollect(&ns->children, &entry->children);
+        if(node != ns->editable)
+            internNodeStrings(&ns->strings, node, &entry->interned, entry->packed);
+    }
+}
+
+UA_StatusCode UA_NodeStore_pack(UA_NodeStore *ns) {
+    size_t size = 0;
+    UA_NodeStoreCursor c;
+    UA_NodeStoreCursor_init(&c);
+    for(UA_Node *node; (node = nextEntry(ns, &c));) {
+        UA_NodeStoreEntry *entry = container_of(node, UA_NodeStoreEntry, node);
+        if(node != ns->editable && !entry->packed)
+            internNodeStrings(&ns->strings, node, &entry->interned, false);
+        size += packedSize(entry);
+    }
+    if(size == 0)
+        return UA_STATUSCODE_GOOD;
+
+    UA_Byte *pos = arenaAddBlock(&ns->arena, size);
+    if(!pos)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    UA_NodeStoreCursor_init(&c);
+    for(UA_Node *node; (node = nextEntry(ns, &c));)
+        packEntry(container_of(node, UA_NodeStoreEntry, node), &pos);
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode UA_NodeStore_unpack(UA_NodeStore *ns, UA_Node *node) {
+    UA_NodeStoreEntry *entry = container_of(node, UA_NodeStoreEntry, node);
+    if(!entry->packed && entry->interned == 0)
+        return UA_STATUSCODE_GOOD;
+    UA_Node shared = *node;
+    UA_StatusCode retval = arenaUnpackNode(node);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    releaseNodeStrings(&ns->strings, &shared, entry->interned, entry->packed);
+    entry->packed = false;
+    entry->interned = 0;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode UA_NodeStore_setImage(UA_NodeStore *ns, const UA_NodeStoreImage *image) {
+    if(ns->snapshot.data.data)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_StatusCode retval = imageSet(&ns->image, image);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    /* Nodes that are already in the nodestore shadow the image */
+    UA_UInt32 size = (UA_UInt32)1 << image->tableBits;
+    for(UA_UInt32 i = 0; i < size; i++) {
+        if(image->table[i] && findEntry(ns, &image->table[i]->nodeId))
+            imageHide(&ns->image, i);
+    }
+    ns->children.inserts++;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode UA_NodeStore_getEditable(UA_NodeStore *ns, const UA_NodeId *nodeid, UA_Node **node) {
+    childrenFinishEdit(&ns->children);
+    UA_NodeStoreEntry *entry = findOrLoadEntry(ns, nodeid);
+    if(entry) {
+        UA_StatusCode retval = UA_NodeStore_unpack(ns, &entry->node);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        /* The references may change */
+        UA_free(entry->children);
+        entry->children = NULL;
+        refIndexDelete(entry->refGroups);
+        entry->refGroups = NULL;
+        childrenEdit(&ns->children, &entry->node);
+        ns->editable = &entry->node;
+        *node = &entry->node;
+        return UA_STATUSCODE_GOOD;
+    }
+    UA_UInt32 slot;
+    if(!imageFind(&ns->image, nodeid, &slot) || imageHidden(&ns->image, slot))
+        return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    const UA_Node *imageNode = ns->image.image->table[slot];
+    UA_NodeStoreEntry *copy = instantiateEntry(ns, imageNode->nodeClass);
+    if(!copy)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    if(UA_Node_copyAnyNodeClass(imageNode, &copy->node) != UA_STATUSCODE_GOOD) {
+        deleteEntry(ns, copy);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    UA_StatusCode retval = shadowImageNode(ns, &copy->node, slot);
+    if(retval == UA_STATUSCODE_GOOD) {
+        childrenEdit(&ns->children, &copy->node);
+        ns->editable = &copy->node;
+        *node = &copy->node;
+    }
+    return retval;
+}
+
+size_t
+UA_NodeStore_findChild(UA_NodeStore *ns, const UA_Node *node, const UA_QualifiedName *browseName,
+                       size_t from, const UA_Node **target) {
+    /* Image nodes are constant and have no entry to keep the index */
+    UA_NodeStoreChildIndex **index = NULL;
+    if(imageGet(&ns->image, &node->nodeId) != node) {
+        UA_NodeStoreEntry *entry = container_of(node, UA_NodeStoreEntry, node);
+        index = &entry->children;
+    }
+    return childIndexFind(ns, &ns->children, index, node, browseName, from, target);
+}
+
+size_t
+UA_NodeStore_findReference(UA_NodeStore *ns, const UA_Node *node, const UA_NodeId *referenceTypeId,
+                           UA_Boolean isInverse, size_t from, UA_NodeId *target) {
+    UA_NodeStoreRefIndex **index = NULL;
+    if(imageGet(&ns->image, &node->nodeId) != node) {
+        UA_NodeStoreEntry *entry = container_of(node, UA_NodeStoreEntry, node);
+        index = &entry->refGroups;
+    }
+    return refIndexFind(index, node == ns->editable, node, referenceTypeId, isInverse,
+                        from, target);
+}
+
+/* The nodes are encoded in the order of UA_NodeStore_iterate */
+static void writeSnapshotNodes(UA_NodeStore *ns, UA_NodeStoreSnapshotWriter *w) {
+    UA_NodeStoreCursor c;
+    UA_NodeStoreCursor_init(&c);
+    for(const UA_Node *node; (node = nextNode(ns, &c));)
+        snapshotWriteNode(w, node);
+}
+
+UA_StatusCode UA_NodeStore_saveSnapshot(UA_NodeStore *ns, UA_ByteString *snapshot) {
+    UA_StatusCode retval = loadSnapshotEntries(ns);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    UA_NodeStoreSnapshotWriter w;
+    memset(&w, 0, sizeof(UA_NodeStoreSnapshotWriter));
+    w.offset = UA_NODESTORE_SNAPSHOT_HEADERSIZE;
+    writeSnapshotNodes(ns, &w);
+    retval = snapshotWriterAlloc(&w);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    writeSnapshotNodes(ns, &w);
+    if(w.retval != UA_STATUSCODE_GOOD) {
+        UA_ByteString_deleteMembers(&w.dst);
+        return w.retval;
+    }
+    *snapshot = w.dst;
+    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode UA_NodeStore_loadSnapshot(UA_NodeStore *ns, const UA_ByteString *snapshot) {
+    if(!isEmpty(ns))
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return snapshotSet(&ns->snapshot, snapshot);
+}
+
+#ifdef UA_ENABLE_NODESTORE_MMAP
+UA_StatusCode UA_NodeStore_saveSnapshotFile(UA_NodeStore *ns, const char *path) {
+    UA_ByteString snapshot;
+    UA_StatusCode retval = UA_NodeStore_saveSnapshot(ns, &snapshot);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    retval = snapshotWriteFile(&snapshot, path);
+    UA_ByteString_deleteMembers(&snapshot);
+    return retval;
+}
+
+UA_StatusCode UA_NodeStore_loadSnapshotFile(UA_NodeStore *ns, const char *path) {
+    if(!isEmpty(ns))
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return snapshotMapFile(&ns->snapshot, path);
 }
+#endif
@@ -15,23 +15,39 @@ typedef struct UA_NodeStore UA_NodeStore;
 /** Create a new nodestore */
 UA_NodeStore * UA_NodeStore_new(void);
 
+#ifdef UA_ENABLE_MULTITHREADING
+/** Create a nodestore that consists of the given number of independently
+    resized hash-maps. UA_NodeStore_new uses UA_NODESTORE_SHARDS (16). */
+UA_NodeStore * UA_NodeStore_newSharded(size_t shards);
+#endif
+
 /** Delete the nodestore and all nodes in it. Do not call from a read-side
     critical section (multithreading). */
 void UA_NodeStore_delete(UA_NodeStore *ns);
 
-/** Create an editable node of the given NodeClass. */
-UA_Node * UA_NodeStore_newNode(UA_NodeClass nodeClass);
-#define UA_NodeStore_newObjectNode() (UA_ObjectNode*)UA_NodeStore_newNode(UA_NODECLASS_OBJECT)
-#define UA_NodeStore_newVariableNode() (UA_VariableNode*)UA_NodeStore_newNode(UA_NODECLASS_VARIABLE)
-#define UA_NodeStore_newMethodNode() (UA_MethodNode*)UA_NodeStore_newNode(UA_NODECLASS_METHOD)
-#define UA_NodeStore_newObjectTypeNode() (UA_ObjectTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_OBJECTTYPE)
-#define UA_NodeStore_newVariableTypeNode() (UA_VariableTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_VARIABLETYPE)
-#define UA_NodeStore_newReferenceTypeNode() (UA_ReferenceTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_REFERENCETYPE)
-#define UA_NodeStore_newDataTypeNode() (UA_DataTypeNode*)UA_NodeStore_newNode(UA_NODECLASS_DATATYPE)
-#define UA_NodeStore_newViewNode() (UA_ViewNode*)UA_NodeStore_newNode(UA_NODECLASS_VIEW)
+/** Create an editable node of the given NodeClass. The node is inserted into
+    or deleted with the same nodestore. */
+UA_Node * UA_NodeStore_newNode(UA_NodeStore *ns, UA_NodeClass nodeClass);
+#define UA_NodeStore_newObjectNode(ns) (UA_ObjectNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_OBJECT)
+#define UA_NodeStore_newVariableNode(ns) (UA_VariableNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_VARIABLE)
+#define UA_NodeStore_newMethodNode(ns) (UA_MethodNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_METHOD)
+#define UA_NodeStore_newObjectTypeNode(ns) (UA_ObjectTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_OBJECTTYPE)
+#define UA_NodeStore_newVariableTypeNode(ns) (UA_VariableTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_VARIABLETYPE)
+#define UA_NodeStore_newReferenceTypeNode(ns) (UA_ReferenceTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_REFERENCETYPE)
+#define UA_NodeStore_newDataTypeNode(ns) (UA_DataTypeNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_DATATYPE)
+#define UA_NodeStore_newViewNode(ns) (UA_ViewNode*)UA_NodeStore_newNode(ns, UA_NODECLASS_VIEW)
 
 /** Delete an editable node. */
-void UA_NodeStore_deleteNode(UA_Node *node);
+void UA_NodeStore_deleteNode(UA_NodeStore *ns, UA_Node *node);
+
+/**
+ * Create an editable instance of a node of the nodestore, e.g. the child of a
+ * new object that is copied from the object type. The instance has the
+ * nodeclass, browsename, displayname and description of the prototype. The
+ * other members are empty. The single-threaded nodestores share the interned
+ * strings of the prototype with the instance until the instance is edited.
+ */
+UA_Node * UA_NodeStore_newInstance(UA_NodeStore *ns, const UA_Node *prototype);
 
 /**
  * Inserts a new node into the nodestore. If the nodeid is zero, then a fresh
@@ -57,6 +73,38 @@ UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid);
  */
 const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid);
 
+/**
+ * Looks up n nodes at once and writes the node for ids[i] (or NULL) to out[i].
+ * The hashes are computed and the slots prefetched for several nodeids before
+ * the first one is resolved. So the cache misses of the lookups overlap. The
+ * returned pointers are valid as for UA_NodeStore_get.
+ */
+void UA_NodeStore_getBatch(UA_NodeStore *ns, const UA_NodeId *ids, size_t n,
+                           const UA_Node **out);
+
+/**
+ * Returns the index of the first reference of the node, starting at from,
+ * whose target has the browsename. The target is written to target. Returns
+ * node->referencesSize if there is no such reference. The node must have been
+ * returned from the nodestore. The single-threaded nodestores index the
+ * references of nodes with many references by the browsename of the target.
+ */
+size_t UA_NodeStore_findChild(UA_NodeStore *ns, const UA_Node *node,
+                              const UA_QualifiedName *browseName, size_t from,
+                              const UA_Node **target);
+
+/**
+ * Returns the index of the first reference of the node, starting at from, with
+ * the reference type and direction. The nodeid of the target is written to
+ * target (if not NULL) without a copy. It is valid as long as the node.
+ * Returns node->referencesSize if there is no such reference. The node must
+ * have been returned from the nodestore. The single-threaded nodestores group
+ * the references of nodes with many references by type and direction.
+ */
+size_t UA_NodeStore_findReference(UA_NodeStore *ns, const UA_Node *node,
+                                  const UA_NodeId *referenceTypeId, UA_Boolean isInverse,
+                                  size_t from, UA_NodeId *target);
+
 /** Returns the copy of a node. */
 UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid);
 
@@ -69,4 +117,126 @@ typedef void (*UA_NodeStore_nodeVisitor)(const UA_Node *node);
 /** Iterate over all nodes in a nodestore. */
 void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor);
 
+/**
+ * A position in the nodestore for iterating over the nodes in steps, e.g. from
+ * a job that must not block the main loop for long. The cursor stays valid when
+ * the nodestore is changed between the steps. Nodes that were inserted or
+ * removed in the meantime may or may not be visited. Nodes may be skipped or
+ * visited twice after the hash-map was resized (single-threaded) or when the
+ * next node of the cursor was removed (multithreading).
+ */
+typedef struct {
+    UA_Boolean done; // all nodes were visited
+    /* The position is private to the nodestore */
+    UA_UInt32 part;
+    size_t index;
+    size_t offset;
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_NodeId next;
+#endif
+} UA_NodeStoreCursor;
+
+/** Set the cursor to the first node. */
+void UA_NodeStoreCursor_init(UA_NodeStoreCursor *cursor);
+
+void UA_NodeStoreCursor_deleteMembers(UA_NodeStoreCursor *cursor);
+
+/**
+ * Called for the nodes visited by UA_NodeStore_iterateCursor. A status code
+ * other than UA_STATUSCODE_GOOD stops the iteration.
+ */
+typedef UA_StatusCode (*UA_NodeStore_nodeCallback)(const UA_Node *node, void *handle);
+
+/**
+ * Visit up to max nodes (all remaining nodes if max is zero) from the position
+ * of the cursor and advance the cursor behind them. cursor->done is set once
+ * the cursor has passed the last node. If the callback returns an error, the
+ * iteration stops behind the node and the error is returned. In the
+ * single-threaded nodestores, the callback must not change the nodestore. With
+ * multithreading, call from a read-side critical section. The next step can be
+ * made from another one.
+ */
+UA_StatusCode
+UA_NodeStore_iterateCursor(UA_NodeStore *ns, UA_NodeStoreCursor *cursor, size_t max,
+                           UA_NodeStore_nodeCallback callback, void *handle);
+
+#ifndef UA_ENABLE_MULTITHREADING
+/**
+ * Move the strings and reference arrays of all nodes into an arena that is
+ * freed together with the nodestore. Use this for nodes that rarely change,
+ * e.g. after namespace zero was created. Strings that are shared between nodes
+ * (browsenames, locales, string nodeids) are interned into a reference-counted
+ * pool instead.
+ */
+UA_StatusCode UA_NodeStore_pack(UA_NodeStore *ns);
+
+/** Copy the members of a packed or interned node to the heap before it is
+    edited in place. */
+UA_StatusCode UA_NodeStore_unpack(UA_NodeStore *ns, UA_Node *node);
+
+/**
+ * Free the memory of the browsename indices (see UA_NodeStore_findChild) that
+ * are no longer valid and intern the strings of nodes that were inserted or
+ * edited. Equal interned strings share their data. Visits up to max nodes
+ * (all if max is zero) from the position of the cursor and sets cursor->done
+ * after the last node. So a recurring job can walk a large nodestore in short
+ * steps.
+ */
+void UA_NodeStore_maintain(UA_NodeStore *ns, UA_NodeStoreCursor *cursor, size_t max);
+
+/**
+ * A read-only image of nodes with numeric nodeids from one namespace. The
+ * nodes and the table are constant data, usually generated for namespace zero
+ * by tools/pyUANamespace (--image). The table is an open-addressing hash-map
+ * with 2^tableBits slots. A node is placed at the slot
+ * UA_NODESTORE_IMAGEHASH(identifier, tableBits) or, if taken, at the next free
+ * slot after it. At least one slot must be empty.
+ */
+typedef struct {
+    UA_UInt16 namespaceIndex;
+    UA_Byte tableBits;
+    const UA_Node *const *table;
+} UA_NodeStoreImage;
+
+#define UA_NODESTORE_IMAGEHASH(identifier, tableBits)                    \
+    ((UA_UInt32)((UA_UInt32)(identifier) * 2654435761u) >> (32 - (tableBits)))
+
+/**
+ * Serve the nodes of the image without copying them. Nodes in the nodestore
+ * take precedence over image nodes with the same nodeid. Only one image can be
+ * set and it must outlive the nodestore.
+ */
+UA_StatusCode UA_NodeStore_setImage(UA_NodeStore *ns, const UA_NodeStoreImage *image);
+
+/**
+ * Returns a node that can be edited in place. Packed nodes are unpacked. Image
+ * nodes are copied into the nodestore first (copy-on-write).
+ */
+UA_StatusCode UA_NodeStore_getEditable(UA_NodeStore *ns, const UA_NodeId *nodeid, UA_Node **node);
+
+/**
+ * Encode all nodes with their references into a versioned binary snapshot.
+ * Callbacks and handles (data sources, value callbacks, methods, lifecycle
+ * management) are not stored. Variables with a data source are restored
+ * without one.
+ */
+UA_StatusCode UA_NodeStore_saveSnapshot(UA_NodeStore *ns, UA_ByteString *snapshot);
+
+/**
+ * Serve the nodes of a snapshot. A node is decoded into the nodestore when it
+ * is first accessed. The nodestore must be empty and have no image. The
+ * snapshot must outlive the nodestore.
+ */
+UA_StatusCode UA_NodeStore_loadSnapshot(UA_NodeStore *ns, const UA_ByteString *snapshot);
+
+#ifdef UA_ENABLE_NODESTORE_MMAP
+/** Write a snapshot of the nodestore to a file */
+UA_StatusCode UA_NodeStore_saveSnapshotFile(UA_NodeStore *ns, const char *path);
+
+/** Map a snapshot file into memory and serve its nodes. The file is unmapped
+    when the nodestore is deleted. */
+UA_StatusCode UA_NodeStore_loadSnapshotFile(UA_NodeStore *ns, const char *path);
+#endif
+#endif
+
 #endif /* UA_NODESTORE_H_ */
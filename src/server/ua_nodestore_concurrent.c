@@ -10,6 +10,25 @@ struct nodeEntry {
 
 #include "ua_nodestore_hash.inc"
 
+#ifndef UA_NODESTORE_SHARDS
+# define UA_NODESTORE_SHARDS 16
+#endif
+
+#define UA_NODESTORE_BATCH 16 // lookups that are prefetched together
+
+/* The nodestore consists of independent hash-maps (shards). The shard of a
+ * nodeid is selected by the upper bits of its hash. So every shard is resized
+ * on its own, and concurrent writers only contend when they hit the same
+ * shard. */
+struct UA_NodeStore {
+    size_t shardsSize;
+    struct cds_lfht *shards[1]; // allocated with shardsSize elements
+};
+
+static struct cds_lfht * shard(UA_NodeStore *ns, hash_t h) {
+    return ns->shards[((UA_UInt64)h * ns->shardsSize) >> 32];
+}
+
 static struct nodeEntry * instantiateEntry(UA_NodeClass class) {
     size_t size = sizeof(struct nodeEntry) - sizeof(UA_Node);
     switch(class) {
@@ -62,44 +81,74 @@ static int compare(struct cds_lfht_node *htn, const void *orig) {
 }
 
 UA_NodeStore * UA_NodeStore_new() {
-    /* 64 is the minimum size for the hashtable. */
-    return (UA_NodeStore*)cds_lfht_new(64, 64, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+    return UA_NodeStore_newSharded(UA_NODESTORE_SHARDS);
+}
+
+UA_NodeStore * UA_NodeStore_newSharded(size_t shards) {
+    if(shards == 0)
+        shards = 1;
+    UA_NodeStore *ns = UA_malloc(sizeof(UA_NodeStore) + sizeof(struct cds_lfht*) * (shards - 1));
+    if(!ns)
+        return NULL;
+    for(ns->shardsSize = 0; ns->shardsSize < shards; ns->shardsSize++) {
+        /* 64 is the minimum size for the hashtable. */
+        ns->shards[ns->shardsSize] = cds_lfht_new(64, 64, 0, CDS_LFHT_AUTO_RESIZE, NULL);
+        if(!ns->shards[ns->shardsSize]) {
+            UA_NodeStore_delete(ns);
+            return NULL;
+        }
+    }
+    return ns;
+}
+
+static UA_StatusCode removeVisited(const UA_Node *node, void *handle) {
+    UA_NodeStore *ns = (UA_NodeStore*)handle;
+    struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
+    if(!cds_lfht_del(shard(ns, hash(&node->nodeId)), &entry->htn))
+        call_rcu(&entry->rcu_head, deleteEntry);
+    return UA_STATUSCODE_GOOD;
 }
 
 /* do not call with read-side critical section held!! */
 void UA_NodeStore_delete(UA_NodeStore *ns) {
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
-    struct cds_lfht_iter iter;
-    cds_lfht_first(ht, &iter);
-    while(iter.node) {
-        if(!cds_lfht_del(ht, iter.node)) {
-            /* points to the htn entry, which is first */
-            struct nodeEntry *entry = (struct nodeEntry*) iter.node;
-            call_rcu(&entry->rcu_head, deleteEntry);
-        }
-        cds_lfht_next(ht, &iter);
-    }
-    cds_lfht_destroy(ht, NULL);
+    UA_NodeStoreCursor c;
+    UA_NodeStoreCursor_init(&c);
+    UA_NodeStore_iterateCursor(ns, &c, 0, removeVisited, ns);
+    for(size_t i = 0; i < ns->shardsSize; i++)
+        cds_lfht_destroy(ns->shards[i], NULL);
     UA_free(ns);
 }
 
-UA_Node * UA_NodeStore_newNode(UA_NodeClass class) {
+UA_Node * UA_NodeStore_newNode(UA_NodeStore *ns, UA_NodeClass class) {
     struct nodeEntry *entry = instantiateEntry(class);
     if(!entry)
         return NULL;
     return (UA_Node*)&entry->node;
 }
 
-void UA_NodeStore_deleteNode(UA_Node *node) {
+void UA_NodeStore_deleteNode(UA_NodeStore *ns, UA_Node *node) {
     struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
     deleteEntry(&entry->rcu_head);
 }
 
+UA_Node * UA_NodeStore_newInstance(UA_NodeStore *ns, const UA_Node *prototype) {
+    UA_Node *node = UA_NodeStore_newNode(ns, prototype->nodeClass);
+    if(!node)
+        return NULL;
+    UA_StatusCode retval = UA_QualifiedName_copy(&prototype->browseName, &node->browseName);
+    retval |= UA_LocalizedText_copy(&prototype->displayName, &node->displayName);
+    retval |= UA_LocalizedText_copy(&prototype->description, &node->description);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_NodeStore_deleteNode(ns, node);
+        return NULL;
+    }
+    return node;
+}
+
 UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
     UA_ASSERT_RCU_LOCKED();
     struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
     cds_lfht_node_init(&entry->htn);
     struct cds_lfht_node *result;
     //namespace index is assumed to be valid
@@ -108,7 +157,7 @@ UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
     tempNodeid.namespaceIndex = 0;
     if(!UA_NodeId_isNull(&tempNodeid)) {
         hash_t h = hash(&node->nodeId);
-        result = cds_lfht_add_unique(ht, h, compare, &node->nodeId, &entry->htn);
+        result = cds_lfht_add_unique(shard(ns, h), h, compare, &node->nodeId, &entry->htn);
         /* If the nodeid exists already */
         if(result != &entry->htn) {
             deleteEntry(&entry->rcu_head);
@@ -130,15 +179,19 @@ UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
 		((UA_VariableNode*)node)->browseName.namespaceIndex = node->nodeId.namespaceIndex;
 	}
 	
-        unsigned long identifier;
-        long before, after;
-        cds_lfht_count_nodes(ht, &before, &identifier, &after); // current amount of nodes stored
+        unsigned long identifier = 0;
+        for(size_t i = 0; i < ns->shardsSize; i++) {
+            unsigned long count;
+            long before, after;
+            cds_lfht_count_nodes(ns->shards[i], &before, &count, &after);
+            identifier += count; // current amount of nodes stored
+        }
         identifier++;
 
         node->nodeId.identifier.numeric = (UA_UInt32)identifier;
         while(true) {
             hash_t h = hash(&node->nodeId);
-            result = cds_lfht_add_unique(ht, h, compare, &node->nodeId, &entry->htn);
+            result = cds_lfht_add_unique(shard(ns, h), h, compare, &node->nodeId, &entry->htn);
             if(result == &entry->htn)
                 break;
             node->nodeId.identifier.numeric += (UA_UInt32)(identifier * 2654435761);
@@ -150,19 +203,23 @@ UA_StatusCode UA_NodeStore_insert(UA_NodeStore *ns, UA_Node *node) {
 UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
     UA_ASSERT_RCU_LOCKED();
     struct nodeEntry *entry = container_of(node, struct nodeEntry, node);
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
 
     /* Get the current version */
     hash_t h = hash(&node->nodeId);
+    struct cds_lfht *ht = shard(ns, h);
     struct cds_lfht_iter iter;
     cds_lfht_lookup(ht, h, compare, &node->nodeId, &iter);
-    if(!iter.node)
+    if(!iter.node) {
+        deleteEntry(&entry->rcu_head);
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
+    }
 
     /* We try to replace an obsolete version of the node */
     struct nodeEntry *oldEntry = (struct nodeEntry*)iter.node;
-    if(oldEntry != entry->orig)
+    if(oldEntry != entry->orig) {
+        deleteEntry(&entry->rcu_head);
         return UA_STATUSCODE_BADINTERNALERROR;
+    }
     
     cds_lfht_node_init(&entry->htn);
     if(cds_lfht_replace(ht, &iter, h, compare, &node->nodeId, &entry->htn) != 0) {
@@ -178,10 +235,10 @@ UA_StatusCode UA_NodeStore_replace(UA_NodeStore *ns, UA_Node *node) {
 
 UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
     hash_t h = hash(nodeid);
+    struct cds_lfht *ht = shard(ns, h);
     struct cds_lfht_iter iter;
-    cds_lfht_lookup(ht, h, compare, &nodeid, &iter);
+    cds_lfht_lookup(ht, h, compare, nodeid, &iter);
     if(!iter.node || cds_lfht_del(ht, iter.node) != 0)
         return UA_STATUSCODE_BADNODEIDUNKNOWN;
     struct nodeEntry *entry = (struct nodeEntry*)iter.node;
@@ -191,22 +248,76 @@ UA_StatusCode UA_NodeStore_remove(UA_NodeStore *ns, const UA_NodeId *nodeid) {
 
 const UA_Node * UA_NodeStore_get(UA_NodeStore *ns, const UA_NodeId *nodeid) {
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
     hash_t h = hash(nodeid);
     struct cds_lfht_iter iter;
-    cds_lfht_lookup(ht, h, compare, nodeid, &iter);
+    cds_lfht_lookup(shard(ns, h), h, compare, nodeid, &iter);
     struct nodeEntry *found_entry = (struct nodeEntry*)iter.node;
     if(!found_entry)
         return NULL;
     return &found_entry->node;
 }
 
+/* The bucket tables of the urcu hash-maps are opaque. So only the hashes are
+   computed and the shards prefetched before the nodeids are resolved. */
+void
+UA_NodeStore_getBatch(UA_NodeStore *ns, const UA_NodeId *ids, size_t n, const UA_Node **out) {
+    UA_ASSERT_RCU_LOCKED();
+    hash_t hashes[UA_NODESTORE_BATCH];
+    for(size_t start = 0; start < n; start += UA_NODESTORE_BATCH) {
+        const UA_NodeId *chunkIds = &ids[start];
+        size_t chunk = n - start;
+        if(chunk > UA_NODESTORE_BATCH)
+            chunk = UA_NODESTORE_BATCH;
+        for(size_t i = 0; i < chunk; i++) {
+            hashes[i] = hash(&chunkIds[i]);
+            UA_prefetch(shard(ns, hashes[i]));
+        }
+        for(size_t i = 0; i < chunk; i++) {
+            struct cds_lfht_iter iter;
+            cds_lfht_lookup(shard(ns, hashes[i]), hashes[i], compare, &chunkIds[i], &iter);
+            struct nodeEntry *found_entry = (struct nodeEntry*)iter.node;
+            out[start + i] = found_entry ? &found_entry->node : NULL;
+        }
+    }
+}
+
+/* Without an index. Nodes are replaced concurrently and not edited in place. */
+size_t
+UA_NodeStore_findChild(UA_NodeStore *ns, const UA_Node *node, const UA_QualifiedName *browseName,
+                       size_t from, const UA_Node **target) {
+    UA_ASSERT_RCU_LOCKED();
+    for(size_t i = from; i < node->referencesSize; i++) {
+        const UA_Node *next = UA_NodeStore_get(ns, &node->references[i].targetId.nodeId);
+        if(next && next->browseName.namespaceIndex == browseName->namespaceIndex &&
+           UA_String_equal(&next->browseName.name, &browseName->name)) {
+            *target = next;
+            return i;
+        }
+    }
+    return node->referencesSize;
+}
+
+/* Without an index */
+size_t
+UA_NodeStore_findReference(UA_NodeStore *ns, const UA_Node *node, const UA_NodeId *referenceTypeId,
+                           UA_Boolean isInverse, size_t from, UA_NodeId *target) {
+    UA_ASSERT_RCU_LOCKED();
+    for(size_t i = from; i < node->referencesSize; i++) {
+        const UA_ReferenceNode *ref = &node->references[i];
+        if(ref->isInverse == isInverse && UA_NodeId_equal(&ref->referenceTypeId, referenceTypeId)) {
+            if(target)
+                *target = ref->targetId.nodeId;
+            return i;
+        }
+    }
+    return node->referencesSize;
+}
+
 UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
     hash_t h = hash(nodeid);
     struct cds_lfht_iter iter;
-    cds_lfht_lookup(ht, h, compare, nodeid, &iter);
+    cds_lfht_lookup(shard(ns, h), h, compare, nodeid, &iter);
     struct nodeEntry *entry = (struct nodeEntry*)iter.node;
     if(!entry)
         return NULL;
@@ -223,12 +334,84 @@ UA_Node * UA_NodeStore_getCopy(UA_NodeStore *ns, const UA_NodeId *nodeid) {
 
 void UA_NodeStore_iterate(UA_NodeStore *ns, UA_NodeStore_nodeVisitor visitor) {
     UA_ASSERT_RCU_LOCKED();
-    struct cds_lfht *ht = (struct cds_lfht*)ns;
-    struct cds_lfht_iter iter;
-    cds_lfht_first(ht, &iter);
-    while(iter.node != NULL) {
-        struct nodeEntry *found_entry = (struct nodeEntry*)iter.node;
-        visitor(&found_entry->node);
-        cds_lfht_next(ht, &iter);
+    for(size_t i = 0; i < ns->shardsSize; i++) {
+        struct cds_lfht *ht = ns->shards[i];
+        struct cds_lfht_iter iter;
+        cds_lfht_first(ht, &iter);
+        while(iter.node != NULL) {
+            struct nodeEntry *found_entry = (struct nodeEntry*)iter.node;
+            visitor(&found_entry->node);
+            cds_lfht_next(ht, &iter);
+        }
+    }
+}
+
+void UA_NodeStoreCursor_init(UA_NodeStoreCursor *cursor) {
+    memset(cursor, 0, sizeof(UA_NodeStoreCursor));
+}
+
+void UA_NodeStoreCursor_deleteMembers(UA_NodeStoreCursor *cursor) {
+    UA_NodeId_deleteMembers(&cursor->next);
+    UA_NodeStoreCursor_init(cursor);
+}
+
+/* The cursor points into the shard cursor->part after cursor->index visited
+ * nodes. The iteration continues at the node cursor->next. The order of the
+ * nodes in a shard does not change when the shard is resized. If the node was
+ * removed, the visited nodes are skipped by their count instead. */
+static void
+cursorResume(UA_NodeStore *ns, UA_NodeStoreCursor *c, struct cds_lfht_iter *iter) {
+    struct cds_lfht *ht = ns->shards[c->part];
+    if(c->index > 0 && !UA_NodeId_isNull(&c->next)) {
+        hash_t h = hash(&c->next);
+        cds_lfht_lookup(ht, h, compare, &c->next, iter);
+        if(iter->node)
+            return;
     }
+    cds_lfht_first(ht, iter);
+    for(size_t i = 0; i < c->index && iter->node; i++)
+        cds_lfht_next(ht, iter);
+}
+
+/* Remember the next node when the iteration stops. If the copy fails, the
+ * iteration continues by the count of the visited nodes. */
+static void cursorSetNext(UA_NodeStoreCursor *c, const struct cds_lfht_iter *iter) {
+    UA_NodeId_deleteMembers(&c->next);
+    UA_NodeId_init(&c->next);
+    if(iter->node)
+        UA_NodeId_copy(&((struct nodeEntry*)iter->node)->node.nodeId, &c->next);
+}
+
+UA_StatusCode
+UA_NodeStore_iterateCursor(UA_NodeStore *ns, UA_NodeStoreCursor *cursor, size_t max,
+                           UA_NodeStore_nodeCallback callback, void *handle) {
+    UA_ASSERT_RCU_LOCKED();
+    size_t visited = 0;
+    for(; cursor->part < ns->shardsSize; cursor->part++, cursor->index = 0) {
+        struct cds_lfht *ht = ns->shards[cursor->part];
+        struct cds_lfht_iter iter;
+        cursorResume(ns, cursor, &iter);
+        while(iter.node) {
+            if(max > 0 && visited == max) {
+                cursorSetNext(cursor, &iter);
+                return UA_STATUSCODE_GOOD;
+            }
+            struct nodeEntry *entry = (struct nodeEntry*)iter.node;
+            /* Advance before the callback. It may remove the node. */
+            cds_lfht_next(ht, &iter);
+            cursor->index++;
+            visited++;
+            UA_StatusCode retval = callback(&entry->node, handle);
+            if(retval != UA_STATUSCODE_GOOD) {
+                cursorSetNext(cursor, &iter);
+                if(!iter.node) {
+                    cursor->part++;
+                    cursor->index = 0;
+                }
+                return retval;
+            }
+        }
+    }
+    cursor->done = true;
+    return UA_STATUSCODE_GOOD;
 }
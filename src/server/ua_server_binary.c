@@ -565,6 +565,127 @@ processCLO(UA_Connection *connection, UA_Server *server, const UA_ByteString *ms
     Service_CloseSecureChannel(server, secureChannelId);
 }
 
+#ifdef UA_ENABLE_MULTITHREADING
+/**
+ * Select the dispatch lane for a message before it is handed to the workers.
+ * Only the headers are decoded. Closing a channel, publish and session creation
+ * go to the realtime lane. Read, Write and Browse requests with more operations
+ * than the configured threshold go to the bulk lane.
+ *
+ * Only buffers with a single message are classified. The chunks of a message
+ * must be processed in order. So all chunks are normal, including the final
+ * chunk whose payload cannot be decoded on its own. The main loop tracks the
+ * chunked requests of the connection to tell a final chunk from a message that
+ * consists of one chunk.
+ */
+
+/* Returns true if the request had chunks before */
+static UA_Boolean
+trackChunkedRequest(UA_Connection *connection, UA_UInt32 requestId, UA_Byte chunkType) {
+    size_t size = connection->chunkedRequestsSize;
+    if(size > UA_CONNECTION_CHUNKEDREQUESTS)
+        return true; // not tracked. every message may be a final chunk.
+    for(size_t i = 0; i < size; i++) {
+        if(connection->chunkedRequests[i] != requestId)
+            continue;
+        if(chunkType != 'C') {
+            connection->chunkedRequests[i] = connection->chunkedRequests[size - 1];
+            connection->chunkedRequestsSize--;
+        }
+        return true;
+    }
+    if(chunkType != 'C')
+        return false;
+    if(size == UA_CONNECTION_CHUNKEDREQUESTS)
+        connection->chunkedRequestsSize++; // stop tracking the connection
+    else
+        connection->chunkedRequests[connection->chunkedRequestsSize++] = requestId;
+    return false;
+}
+
+UA_JobPriority
+UA_Server_classifyBinaryMessage(UA_Server *server, UA_Connection *connection,
+                                const UA_ByteString *msg) {
+    /* Track the chunks of all messages in the buffer */
+    size_t pos = 0;
+    size_t messages = 0;
+    UA_Boolean single = false;
+    UA_UInt32 messageType = 0;
+    while(pos < msg->length) {
+        size_t start = pos;
+        UA_TcpMessageHeader tcpMessageHeader;
+        if(UA_TcpMessageHeader_decodeBinary(msg, &pos, &tcpMessageHeader) != UA_STATUSCODE_GOOD ||
+           tcpMessageHeader.messageSize < 8 || tcpMessageHeader.messageSize > msg->length - start)
+            return UA_JOBPRIORITY_NORMAL;
+        messageType = tcpMessageHeader.messageTypeAndFinal & 0xffffff;
+        if(messageType == (UA_MESSAGETYPEANDFINAL_MSGF & 0xffffff)) {
+            /* skip the channel id and token id and the sequence number */
+            size_t requestIdPos = start + 20;
+            UA_UInt32 requestId;
+            if(UA_UInt32_decodeBinary(msg, &requestIdPos, &requestId) != UA_STATUSCODE_GOOD)
+                return UA_JOBPRIORITY_NORMAL;
+            UA_Byte chunkType = (UA_Byte)(tcpMessageHeader.messageTypeAndFinal >> 24);
+            single = !trackChunkedRequest(connection, requestId, chunkType) && chunkType == 'F';
+        }
+        pos = start + tcpMessageHeader.messageSize;
+        messages++;
+    }
+    if(messages != 1)
+        return UA_JOBPRIORITY_NORMAL;
+    if(messageType == (UA_MESSAGETYPEANDFINAL_CLOF & 0xffffff))
+        return UA_JOBPRIORITY_REALTIME;
+    if(!single)
+        return UA_JOBPRIORITY_NORMAL;
+
+    /* skip the message header, channel id, token id and sequence header */
+    pos = 24;
+    UA_NodeId requestTypeId;
+    if(UA_NodeId_decodeBinary(msg, &pos, &requestTypeId) != UA_STATUSCODE_GOOD)
+        return UA_JOBPRIORITY_NORMAL;
+    if(requestTypeId.namespaceIndex != 0 ||
+       requestTypeId.identifierType != UA_NODEIDTYPE_NUMERIC) {
+        UA_NodeId_deleteMembers(&requestTypeId);
+        return UA_JOBPRIORITY_NORMAL;
+    }
+
+    UA_UInt32 requestType = requestTypeId.identifier.numeric - UA_ENCODINGOFFSET_BINARY;
+    switch(requestType) {
+    case UA_NS0ID_PUBLISHREQUEST:
+    case UA_NS0ID_CREATESESSIONREQUEST:
+        return UA_JOBPRIORITY_REALTIME;
+    case UA_NS0ID_READREQUEST:
+    case UA_NS0ID_WRITEREQUEST:
+    case UA_NS0ID_BROWSEREQUEST:
+        break;
+    default:
+        return UA_JOBPRIORITY_NORMAL;
+    }
+    if(server->config.bulkOperationsThreshold == 0)
+        return UA_JOBPRIORITY_NORMAL;
+
+    /* Decode up to the length of the operations array */
+    UA_RequestHeader requestHeader;
+    if(UA_RequestHeader_decodeBinary(msg, &pos, &requestHeader) != UA_STATUSCODE_GOOD)
+        return UA_JOBPRIORITY_NORMAL;
+    UA_RequestHeader_deleteMembers(&requestHeader);
+    if(requestType == UA_NS0ID_READREQUEST) {
+        pos += 12; // maxAge and timestampsToReturn
+    } else if(requestType == UA_NS0ID_BROWSEREQUEST) {
+        UA_ViewDescription view;
+        if(UA_ViewDescription_decodeBinary(msg, &pos, &view) != UA_STATUSCODE_GOOD)
+            return UA_JOBPRIORITY_NORMAL;
+        UA_ViewDescription_deleteMembers(&view);
+        pos += 4; // requestedMaxReferencesPerNode
+    }
+    UA_Int32 operations;
+    if(UA_Int32_decodeBinary(msg, &pos, &operations) != UA_STATUSCODE_GOOD)
+        return UA_JOBPRIORITY_NORMAL;
+    if(operations > 0 && (UA_UInt32)operations > server->config.bulkOperationsThreshold)
+        return UA_JOBPRIORITY_BULK;
+    return UA_JOBPRIORITY_NORMAL;
+}
+#endif
+
 /**
  * process binary message received from Connection
  * dose not modify UA_ByteString you have to free it youself.
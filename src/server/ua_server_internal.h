@@ -26,13 +26,47 @@ typedef struct UA_ExternalNamespace {
 #endif
 
 #ifdef UA_ENABLE_MULTITHREADING
+#define UA_JOBTYPECOUNT (UA_JOBTYPE_METHODCALL_DELAYED + 1)
+#define UA_JOBCOST_FRACBITS 4 // fixed point precision of the job cost estimate
+#define UA_JOBPRIORITYCOUNT 3
+
+/* Slot in the ring of jobs for the main loop. The sequence tells whether the
+   slot is free or filled in the current round. */
+typedef struct {
+    UA_UInt32 sequence;
+    UA_Job job;
+} UA_MainLoopJobSlot;
+
+/* A dispatch queue has one lane per job priority */
+typedef struct {
+    struct cds_wfcq_head head;
+    struct cds_wfcq_tail tail;
+} UA_DispatchLane;
+
 typedef struct {
     UA_Server *server;
     pthread_t thr;
     UA_UInt32 counter;
     volatile UA_Boolean running;
-    char padding[64 - sizeof(void*) - sizeof(pthread_t) -
-                 sizeof(UA_UInt32) - sizeof(UA_Boolean)]; // separate cache lines
+
+    /* Per-worker dispatch queue. Only used if config.workStealing or
+       config.connectionAffinity is set. With work stealing, idle workers steal
+       from the queues of their peers. */
+    UA_UInt32 queued; // approximate number of batches in the queue
+    UA_DispatchLane lanes[UA_JOBPRIORITYCOUNT];
+
+    /* Objects retired by the worker with UA_Server_delayedFree. Handed to the
+       main loop in bulk when full or when the worker becomes idle. */
+    struct DelayedJobs *retired;
+
+    /* The worker parks here if no work is found. sleeping is set by the worker
+       and cleared by whoever wakes it up. On Linux, it is used as a futex. */
+    UA_UInt32 sleeping;
+#ifndef __linux__
+    pthread_mutex_t wakeupMutex;
+    pthread_cond_t wakeupCondition;
+#endif
+    char padding[64]; // separate cache lines of neighbouring workers
 } UA_Worker;
 #endif
 
@@ -48,6 +82,13 @@ struct UA_Server {
 
     /* Address Space */
     UA_NodeStore *nodestore;
+#ifndef UA_ENABLE_MULTITHREADING
+    UA_NodeStoreCursor nodestoreMaintenance; /* position of the recurring maintenance */
+#endif
+    struct UA_ReferenceTypeClosures *referenceTypes; /* subtypes of the reference types */
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_UInt32 referenceTypesVersion; /* changes of the reference types */
+#endif
 
     size_t namespacesSize;
     UA_String *namespaces;
@@ -57,18 +98,38 @@ struct UA_Server {
     UA_ExternalNamespace *externalNamespaces;
 #endif
      
-    /* Jobs with a repetition interval */
-    LIST_HEAD(RepeatedJobsList, RepeatedJobs) repeatedJobs;
+    /* Jobs with a repetition interval (min-heap ordered by the next execution) */
+    UA_RepeatedJob **repeatedJobs;
+    size_t repeatedJobsSize;
+    size_t repeatedJobsCapacity;
+#ifdef UA_ENABLE_MULTITHREADING
+    size_t repeatedJobsReserved; /* jobs in the heap and jobs not yet added */
+#endif
     
 #ifdef UA_ENABLE_MULTITHREADING
-    /* Dispatch queue head for the worker threads (the tail should not be in the same cache line) */
-	struct cds_wfcq_head dispatchQueue_head;
+    /* Dispatch queue for the worker threads with one lane per job priority */
+    UA_DispatchLane dispatchLanes[UA_JOBPRIORITYCOUNT];
     UA_Worker *workers; /* there are nThread workers in a running server */
-    struct cds_lfs_stack mainLoopJobs; /* Work that shall be executed only in the main loop and not
-                                          by worker threads */
+    /* Work that shall be executed only in the main loop and not by worker
+       threads. Multiple producers, the main loop is the only consumer. */
+    UA_MainLoopJobSlot *mainLoopRing; /* bounded ring of jobs in fifo order */
+    UA_UInt32 mainLoopRingMask; /* capacity - 1 */
+    UA_UInt32 mainLoopRingHead; /* next slot for the producers */
+    UA_UInt32 mainLoopRingTail; /* next slot for the main loop */
+    struct cds_lfs_stack mainLoopJobs; /* jobs that did not fit into the ring */
+    UA_UInt32 mainLoopJobsOverflow; /* number of jobs that did not fit into the ring */
     struct DelayedJobs *delayedJobs;
-    pthread_cond_t dispatchQueue_condition; /* so the workers don't spin if the queue is empty */
-	struct cds_wfcq_tail dispatchQueue_tail; /* Dispatch queue tail for the worker threads */
+    UA_UInt32 delayedJobsPending; /* delayed jobs (and retired objects) not yet processed */
+    size_t dispatchNext; /* round-robin start for the dispatch and the wakeups */
+    UA_UInt32 idleWorkers; /* number of parked workers */
+    struct DispatchJobsList **affineBatches; /* open batch per worker with connection affinity */
+    struct DispatchJobsList *batchPool; /* preallocated job batches */
+    struct cds_lfs_node *batchCache; /* free batches owned by the main loop */
+    struct cds_lfs_stack batchFreeList; /* batches returned by the workers */
+    UA_UInt32 dispatchQueueSize; /* batches waiting to be processed */
+    UA_UInt32 lastBatchSize; /* average batch size of the last dispatch */
+    UA_UInt32 jobCost[UA_JOBTYPECOUNT]; /* moving average of the execution time per job type
+                                           (in 100ns with UA_JOBCOST_FRACBITS fractional bits) */
 #endif
 
     /* Config is the last element so that MSVC allows the usernamePasswordLogins
@@ -88,8 +149,26 @@ typedef UA_StatusCode (*UA_EditNodeCallback)(UA_Server*, UA_Session*, UA_Node*,
 UA_StatusCode UA_Server_editNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId,
                                  UA_EditNodeCallback callback, const void *data);
 
+/* Drop the cached subtypes of the reference types (used by Browse and
+   TranslateBrowsePaths with includeSubtypes). Call after a reference type or a
+   HasSubtype reference was added or removed. */
+void UA_Server_invalidateReferenceTypes(UA_Server *server);
+
 void UA_Server_processBinaryMessage(UA_Server *server, UA_Connection *connection, const UA_ByteString *msg);
 
+#ifdef UA_ENABLE_MULTITHREADING
+/* Inspect the service request in the message to select the dispatch lane. Call
+   for all messages of the connection in the order of their arrival. */
+UA_JobPriority UA_Server_classifyBinaryMessage(UA_Server *server, UA_Connection *connection,
+                                               const UA_ByteString *msg);
+#endif
+
+#ifdef UA_ENABLE_MULTITHREADING
+/* Allocate the ring of jobs for the main loop. Without memory, all jobs go to
+   the overflow stack. */
+void UA_Server_initMainLoopJobs(UA_Server *server);
+#endif
+
 UA_StatusCode UA_Server_delayedCallback(UA_Server *server, UA_ServerCallback callback, void *data);
 UA_StatusCode UA_Server_delayedFree(UA_Server *server, void *data);
 void UA_Server_deleteAllRepeatedJobs(UA_Server *server);
@@ -1,5 +1,12 @@
 #include "ua_util.h"
 #include "ua_server_internal.h"
+#if defined(UA_ENABLE_MULTITHREADING) && defined(__linux__)
+# include <linux/futex.h>
+# include <sys/prctl.h>
+# include <sys/syscall.h>
+# include <unistd.h>
+# include <stdio.h>
+#endif
 
 /**
  * There are four types of job execution:
@@ -9,7 +16,7 @@
  * 2. Repeated jobs with a repetition interval (dispatched to worker threads)
  *
  * 3. Mainloop jobs are executed (once) from the mainloop and not in the worker threads. The server
- * contains a stack structure where all threads can add mainloop jobs for the next mainloop
+ * contains a ring buffer where all threads can add mainloop jobs for the next mainloop
  * iteration. This is used e.g. to trigger adding and removing repeated jobs without blocking the
  * mainloop.
  *
@@ -17,7 +24,8 @@
  * dispatched earlier have been executed. This is achieved by a counter in the worker threads. We
  * compute from the counter if all previous jobs have finished. The delay can be very long, since we
  * try to not interfere too much with normal execution. A use case is to eventually free obsolete
- * structures that _could_ still be accessed from concurrent threads.
+ * structures that _could_ still be accessed from concurrent threads. The workers collect their
+ * delayed frees locally and hand them over in bulk.
  *
  * - Remove the entry from the list
  * - mark it as "dead" with an atomic operation
@@ -37,37 +45,65 @@
 #define MAXTIMEOUT 50 // max timeout in millisec until the next main loop iteration
 #define BATCHSIZE 20 // max number of jobs that are dispatched at once to workers
 
+static void processJob(UA_Server *server, UA_Job *job) {
+    switch(job->type) {
+    case UA_JOBTYPE_NOTHING:
+        break;
+    case UA_JOBTYPE_DETACHCONNECTION:
+        UA_Connection_detachSecureChannel(job->job.closeConnection);
+        break;
+    case UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER:
+        UA_Server_processBinaryMessage(server, job->job.binaryMessage.connection,
+                                       &job->job.binaryMessage.message);
+        UA_Connection *connection = job->job.binaryMessage.connection;
+        connection->releaseRecvBuffer(connection, &job->job.binaryMessage.message);
+        break;
+    case UA_JOBTYPE_BINARYMESSAGE_ALLOCATED:
+        UA_Server_processBinaryMessage(server, job->job.binaryMessage.connection,
+                                       &job->job.binaryMessage.message);
+        UA_ByteString_deleteMembers(&job->job.binaryMessage.message);
+        break;
+    case UA_JOBTYPE_METHODCALL:
+    case UA_JOBTYPE_METHODCALL_DELAYED:
+        job->job.methodCall.method(server, job->job.methodCall.data);
+        break;
+    default:
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Trying to execute a job of unknown type");
+        break;
+    }
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+/* Update the moving average of the execution time for the job type. Several
+   workers may update concurrently. A lost update only makes the estimate a bit
+   less accurate. */
+static void updateJobCost(UA_Server *server, int type, UA_DateTime duration) {
+    if(type < 0 || type >= UA_JOBTYPECOUNT)
+        return;
+    UA_Int64 sample = duration << UA_JOBCOST_FRACBITS;
+    if(sample > UA_UINT32_MAX)
+        sample = UA_UINT32_MAX;
+    UA_Int64 cost = (UA_Int64)uatomic_read(&server->jobCost[type]);
+    cost += (sample - cost) / 8;
+    uatomic_set(&server->jobCost[type], (UA_UInt32)cost);
+}
+#endif
+
 static void processJobs(UA_Server *server, UA_Job *jobs, size_t jobsSize) {
     UA_ASSERT_RCU_UNLOCKED();
     UA_RCU_LOCK();
     for(size_t i = 0; i < jobsSize; i++) {
-        UA_Job *job = &jobs[i];
-        switch(job->type) {
-        case UA_JOBTYPE_NOTHING:
-            break;
-        case UA_JOBTYPE_DETACHCONNECTION:
-            UA_Connection_detachSecureChannel(job->job.closeConnection);
-            break;
-        case UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER:
-            UA_Server_processBinaryMessage(server, job->job.binaryMessage.connection,
-                                           &job->job.binaryMessage.message);
-            UA_Connection *connection = job->job.binaryMessage.connection;
-            connection->releaseRecvBuffer(connection, &job->job.binaryMessage.message);
-            break;
-        case UA_JOBTYPE_BINARYMESSAGE_ALLOCATED:
-            UA_Server_processBinaryMessage(server, job->job.binaryMessage.connection,
-                                           &job->job.binaryMessage.message);
-            UA_ByteString_deleteMembers(&job->job.binaryMessage.message);
-            break;
-        case UA_JOBTYPE_METHODCALL:
-        case UA_JOBTYPE_METHODCALL_DELAYED:
-            job->job.methodCall.method(server, job->job.methodCall.data);
-            break;
-        default:
-            UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
-                           "Trying to execute a job of unknown type");
-            break;
+#ifdef UA_ENABLE_MULTITHREADING
+        if(server->config.adaptiveBatching) {
+            int type = jobs[i].type;
+            UA_DateTime start = UA_DateTime_nowMonotonic();
+            processJob(server, &jobs[i]);
+            updateJobCost(server, type, UA_DateTime_nowMonotonic() - start);
+            continue;
         }
+#endif
+        processJob(server, &jobs[i]);
     }
     UA_RCU_UNLOCK();
 }
@@ -78,292 +114,1081 @@ static void processJobs(UA_Server *server, UA_Job *jobs, size_t jobsSize) {
 
 #ifdef UA_ENABLE_MULTITHREADING
 
+/**
+ * Mainloop Jobs
+ * -------------
+ * Jobs for the main loop are added from all threads. They are kept in a
+ * bounded ring with a sequence number per slot (multi-producer,
+ * single-consumer). A producer reserves a slot by incrementing the head and
+ * publishes the job by advancing the sequence of the slot. The main loop takes
+ * the jobs in fifo order. Only when the ring is full, the job is allocated and
+ * pushed to the overflow stack. The overflow is processed after the ring.
+ */
+
 struct MainLoopJob {
     struct cds_lfs_node node;
     UA_Job job;
 };
 
-/** Entry in the dispatch queue */
+void UA_Server_initMainLoopJobs(UA_Server *server) {
+    cds_lfs_init(&server->mainLoopJobs);
+    server->mainLoopJobsOverflow = 0;
+    server->mainLoopRingHead = 0;
+    server->mainLoopRingTail = 0;
+    server->mainLoopRingMask = 0;
+    server->mainLoopRing = NULL;
+    UA_UInt32 capacity = 2; // with one slot, free and filled could not be told apart
+    while(capacity < server->config.mainLoopJobsCapacity && capacity < (1u << 30))
+        capacity <<= 1;
+    if(server->config.mainLoopJobsCapacity == 0)
+        return;
+    server->mainLoopRing = UA_malloc(capacity * sizeof(UA_MainLoopJobSlot));
+    if(!server->mainLoopRing)
+        return;
+    for(UA_UInt32 i = 0; i < capacity; i++)
+        server->mainLoopRing[i].sequence = i;
+    server->mainLoopRingMask = capacity - 1;
+}
+
+static UA_Boolean ringPush(UA_Server *server, const UA_Job *job) {
+    if(!server->mainLoopRing)
+        return false;
+    UA_UInt32 pos = uatomic_read(&server->mainLoopRingHead);
+    for(;;) {
+        UA_MainLoopJobSlot *slot = &server->mainLoopRing[pos & server->mainLoopRingMask];
+        UA_UInt32 seq = uatomic_read(&slot->sequence);
+        UA_Int32 diff = (UA_Int32)(seq - pos);
+        if(diff == 0) {
+            /* the slot is free. try to reserve it. */
+            UA_UInt32 old = uatomic_cmpxchg(&server->mainLoopRingHead, pos, pos + 1);
+            if(old == pos) {
+                slot->job = *job;
+                cmm_smp_wmb(); // publish the job before the sequence
+                uatomic_set(&slot->sequence, pos + 1);
+                return true;
+            }
+            pos = old;
+        } else if(diff < 0) {
+            return false; // full
+        } else {
+            pos = uatomic_read(&server->mainLoopRingHead);
+        }
+    }
+}
+
+/* Returns false if the ring is empty (or the next job is not yet published) */
+static UA_Boolean ringPop(UA_Server *server, UA_Job *job) {
+    if(!server->mainLoopRing)
+        return false;
+    UA_UInt32 pos = server->mainLoopRingTail;
+    UA_MainLoopJobSlot *slot = &server->mainLoopRing[pos & server->mainLoopRingMask];
+    if(uatomic_read(&slot->sequence) != pos + 1)
+        return false;
+    cmm_smp_rmb(); // read the job after the sequence
+    *job = slot->job;
+    cmm_smp_mb(); // finish reading before the slot is released to the producers
+    uatomic_set(&slot->sequence, pos + server->mainLoopRingMask + 1);
+    server->mainLoopRingTail = pos + 1;
+    return true;
+}
+
+static UA_StatusCode addMainLoopJob(UA_Server *server, const UA_Job *job) {
+    /* Once the ring overflowed, the following jobs also go to the overflow
+       until the main loop has taken it. That keeps the fifo order. */
+    if(cds_lfs_empty(&server->mainLoopJobs) && ringPush(server, job))
+        return UA_STATUSCODE_GOOD;
+    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
+    if(!mlw)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    mlw->job = *job;
+    uatomic_inc(&server->mainLoopJobsOverflow);
+    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
+    return UA_STATUSCODE_GOOD;
+}
+
+/** Entry in the dispatch queue. The batches have a fixed capacity and are
+    recycled. */
 struct DispatchJobsList {
     struct cds_wfcq_node node; // node for the queue
+    struct cds_lfs_node freeNode; // node for the free-list of the pool
+    UA_Boolean pooled; // part of the preallocated pool or allocated on demand
+    UA_JobPriority priority; // all jobs in the batch have the same priority
     size_t jobsSize;
-    UA_Job *jobs;
+    UA_Job jobs[BATCHSIZE];
 };
 
-static void * workerLoop(UA_Worker *worker) {
+/**
+ * Batch Pool
+ * ----------
+ * The job batches are preallocated when the server starts
+ * (config.batchPoolSize). The workers return processed batches to a lock-free
+ * stack. The main loop is the only consumer. It takes over the entire stack at
+ * once into a private list when the list runs empty. So there is no heap
+ * traffic between the threads in steady state. Only if the pool is exhausted,
+ * additional batches are allocated (and freed after use).
+ */
+
+/* Call only from the main loop */
+static struct DispatchJobsList * getBatch(UA_Server *server) {
+    if(!server->batchCache) {
+        struct cds_lfs_head *head = __cds_lfs_pop_all(&server->batchFreeList);
+        if(head)
+            server->batchCache = &head->node;
+    }
+    struct cds_lfs_node *n = server->batchCache;
+    if(n) {
+        server->batchCache = n->next;
+        return container_of(n, struct DispatchJobsList, freeNode);
+    }
+    struct DispatchJobsList *wln = UA_malloc(sizeof(struct DispatchJobsList));
+    if(wln)
+        wln->pooled = false;
+    return wln;
+}
+
+static void releaseBatch(UA_Server *server, struct DispatchJobsList *wln) {
+    if(!wln->pooled) {
+        UA_free(wln);
+        return;
+    }
+    cds_lfs_node_init(&wln->freeNode);
+    cds_lfs_push(&server->batchFreeList, &wln->freeNode);
+}
+
+static UA_StatusCode initBatchPool(UA_Server *server) {
+    cds_lfs_init(&server->batchFreeList);
+    server->batchCache = NULL;
+    server->batchPool = NULL;
+    size_t size = server->config.batchPoolSize;
+    if(size == 0)
+        return UA_STATUSCODE_GOOD;
+    server->batchPool = UA_malloc(size * sizeof(struct DispatchJobsList));
+    if(!server->batchPool)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    for(size_t i = 0; i < size; i++) {
+        server->batchPool[i].pooled = true;
+        server->batchPool[i].freeNode.next = server->batchCache;
+        server->batchCache = &server->batchPool[i].freeNode;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+/* All batches need to be returned to the pool */
+static void deleteBatchPool(UA_Server *server) {
+    __cds_lfs_pop_all(&server->batchFreeList);
+    server->batchCache = NULL;
+    UA_free(server->batchPool);
+    server->batchPool = NULL;
+}
+
+/* With work stealing enabled, every worker has its own dispatch queue. The
+   main loop pushes batches to the least loaded worker (starting the search
+   round-robin). Workers that run out of work steal from their peers before
+   they park on their own condition variable. So only the worker that received
+   work is woken up and the workers don't contend on a shared queue head.
+
+   With connection affinity, the jobs of a connection are always dispatched to
+   the same worker. The messages of a SecureChannel are then processed in order
+   and the channel and session state stays in the cache of one core. Workers
+   do not steal in this mode, as this would break the ordering. */
+#define PERWORKERQUEUES(server) ((server)->config.nThreads > 0 &&        \
+                                 ((server)->config.workStealing ||      \
+                                  (server)->config.connectionAffinity))
+
+/**
+ * Priority Lanes
+ * --------------
+ * Every dispatch queue has one lane per job priority. The workers select the
+ * lane with a smooth weighted round-robin among the non-empty lanes. Every lane
+ * gets a share of the workers according to its weight in the config. So bulk
+ * jobs progress but cannot starve the realtime lane. The scheduler state is
+ * local to the worker thread.
+ */
+
+static const UA_JobPriority laneOrder[UA_JOBPRIORITYCOUNT] =
+    {UA_JOBPRIORITY_REALTIME, UA_JOBPRIORITY_NORMAL, UA_JOBPRIORITY_BULK};
+
+static UA_Int32 laneWeight(UA_Server *server, size_t lane) {
+    UA_UInt16 weight;
+    switch(lane) {
+    case UA_JOBPRIORITY_REALTIME: weight = server->config.realtimeLaneWeight; break;
+    case UA_JOBPRIORITY_BULK: weight = server->config.bulkLaneWeight; break;
+    default: weight = server->config.normalLaneWeight; break;
+    }
+    return weight > 0 ? weight : 1;
+}
+
+static UA_JobPriority jobPriority(const UA_Job *job) {
+    if(job->priority == UA_JOBPRIORITY_REALTIME || job->priority == UA_JOBPRIORITY_BULK)
+        return job->priority;
+    return UA_JOBPRIORITY_NORMAL;
+}
+
+static UA_Boolean lanesEmpty(UA_DispatchLane *lanes) {
+    for(size_t i = 0; i < UA_JOBPRIORITYCOUNT; i++) {
+        if(!cds_wfcq_empty(&lanes[i].head, &lanes[i].tail))
+            return false;
+    }
+    return true;
+}
+
+static struct DispatchJobsList * dequeueLane(UA_DispatchLane *lane) {
+    return (struct DispatchJobsList*)cds_wfcq_dequeue_blocking(&lane->head, &lane->tail);
+}
+
+/* Take from the lanes in the order of priority */
+static struct DispatchJobsList * dequeueOrdered(UA_DispatchLane *lanes) {
+    for(size_t i = 0; i < UA_JOBPRIORITYCOUNT; i++) {
+        UA_DispatchLane *lane = &lanes[laneOrder[i]];
+        if(cds_wfcq_empty(&lane->head, &lane->tail))
+            continue;
+        struct DispatchJobsList *wln = dequeueLane(lane);
+        if(wln)
+            return wln;
+    }
+    return NULL;
+}
+
+/* Smooth weighted round-robin. credit is the state of the calling worker. */
+static struct DispatchJobsList *
+dequeueWeighted(UA_Server *server, UA_DispatchLane *lanes, UA_Int32 *credit) {
+    UA_Int32 total = 0;
+    size_t best = UA_JOBPRIORITYCOUNT;
+    for(size_t i = 0; i < UA_JOBPRIORITYCOUNT; i++) {
+        if(cds_wfcq_empty(&lanes[i].head, &lanes[i].tail))
+            continue;
+        UA_Int32 weight = laneWeight(server, i);
+        credit[i] += weight;
+        total += weight;
+        if(best == UA_JOBPRIORITYCOUNT || credit[i] > credit[best])
+            best = i;
+    }
+    if(best == UA_JOBPRIORITYCOUNT)
+        return NULL;
+    credit[best] -= total;
+    struct DispatchJobsList *wln = dequeueLane(&lanes[best]);
+    if(!wln) // the lane was emptied concurrently
+        wln = dequeueOrdered(lanes);
+    return wln;
+}
+
+static struct DispatchJobsList *
+dequeueOrSteal(UA_Server *server, UA_Worker *worker, UA_Int32 *credit) {
+    struct DispatchJobsList *wln = dequeueWeighted(server, worker->lanes, credit);
+    if(wln) {
+        uatomic_dec(&worker->queued);
+        uatomic_dec(&server->dispatchQueueSize);
+        return wln;
+    }
+    if(server->config.connectionAffinity)
+        return NULL;
+    /* steal from the peers, starting at the right neighbour */
+    size_t nThreads = server->config.nThreads;
+    size_t self = (size_t)(worker - server->workers);
+    for(size_t i = 1; i < nThreads; i++) {
+        UA_Worker *victim = &server->workers[(self + i) % nThreads];
+        wln = dequeueOrdered(victim->lanes);
+        if(wln) {
+            uatomic_dec(&victim->queued);
+            uatomic_dec(&server->dispatchQueueSize);
+            return wln;
+        }
+    }
+    return NULL;
+}
+
+/* The worker thread that runs the current job. NULL outside the workers. */
+static UA_THREAD_LOCAL UA_Worker *localWorker = NULL;
+
+static void flushRetired(UA_Worker *worker);
+
+/**
+ * Worker Wakeup
+ * -------------
+ * An idle worker parks on its own wakeup word. The main loop wakes exactly one
+ * parked worker for every batch it dispatches. So a single batch does not wake
+ * up all the workers. On Linux, the wakeup word is used as a futex. Elsewhere,
+ * every worker has a mutex and a condition variable.
+ *
+ * Before parking, the worker sets its sleeping flag and checks the queue once
+ * more. The waker enqueues before it reads the flag. So either the worker sees
+ * the batch or the waker sees the sleeping worker. In the low-latency mode
+ * (config.workerSpinCount), the worker polls its queue for a while before it
+ * parks.
+ */
+
+#ifdef __linux__
+static void parkWorker(UA_Worker *worker) {
+    while(uatomic_read(&worker->sleeping))
+        syscall(SYS_futex, &worker->sleeping, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+}
+
+static void unparkWorker(UA_Worker *worker) {
+    syscall(SYS_futex, &worker->sleeping, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+#else
+static void parkWorker(UA_Worker *worker) {
+    pthread_mutex_lock(&worker->wakeupMutex);
+    while(uatomic_read(&worker->sleeping))
+        pthread_cond_wait(&worker->wakeupCondition, &worker->wakeupMutex);
+    pthread_mutex_unlock(&worker->wakeupMutex);
+}
+
+static void unparkWorker(UA_Worker *worker) {
+    pthread_mutex_lock(&worker->wakeupMutex);
+    pthread_cond_signal(&worker->wakeupCondition);
+    pthread_mutex_unlock(&worker->wakeupMutex);
+}
+#endif
+
+/* Returns true if the worker was parked (and is now woken up) */
+static UA_Boolean wakeWorker(UA_Server *server, UA_Worker *worker) {
+    if(uatomic_cmpxchg(&worker->sleeping, 1, 0) != 1)
+        return false;
+    uatomic_dec(&server->idleWorkers);
+    unparkWorker(worker);
+    return true;
+}
+
+/* Wake up one parked worker (round-robin). Call only from the main loop. */
+static void wakeAnyWorker(UA_Server *server) {
+    size_t nThreads = server->config.nThreads;
+    for(size_t i = 0; i < nThreads; i++) {
+        if(uatomic_read(&server->idleWorkers) == 0)
+            return;
+        UA_Worker *worker = &server->workers[server->dispatchNext % nThreads];
+        server->dispatchNext++;
+        if(wakeWorker(server, worker))
+            return;
+    }
+}
+
+/* Wait until there is work in the lanes */
+static void idleWorker(UA_Server *server, UA_Worker *worker, UA_DispatchLane *lanes) {
+    flushRetired(worker);
+    for(UA_UInt16 i = 0; i < server->config.workerSpinCount; i++) {
+        if(!lanesEmpty(lanes) || !worker->running)
+            return;
+        caa_cpu_relax();
+    }
+    uatomic_set(&worker->sleeping, 1);
+    uatomic_inc(&server->idleWorkers);
+    cmm_smp_mb();
+    if(!lanesEmpty(lanes) || !worker->running) {
+        /* Don't park. If the flag is already cleared, the waker has done the
+           bookkeeping. */
+        if(uatomic_cmpxchg(&worker->sleeping, 1, 0) == 1)
+            uatomic_dec(&server->idleWorkers);
+        return;
+    }
+    parkWorker(worker);
+}
+
+static void workerLoopOwnQueue(UA_Worker *worker) {
     UA_Server *server = worker->server;
     UA_UInt32 *counter = &worker->counter;
     volatile UA_Boolean *running = &worker->running;
-    
-    /* Initialize the (thread local) random seed with the ram address of worker */
-    UA_random_seed((uintptr_t)worker);
-   	rcu_register_thread();
+    UA_Int32 credit[UA_JOBPRIORITYCOUNT] = {0};
 
-    pthread_mutex_t mutex; // required for the condition variable
-    pthread_mutex_init(&mutex,0);
-    pthread_mutex_lock(&mutex);
+    while(*running) {
+        struct DispatchJobsList *wln = dequeueOrSteal(server, worker, credit);
+        if(!wln) {
+            uatomic_inc(counter);
+            idleWorker(server, worker, worker->lanes);
+            continue;
+        }
+        processJobs(server, wln->jobs, wln->jobsSize);
+        releaseBatch(server, wln);
+        uatomic_inc(counter);
+    }
+}
+
+static void workerLoopShared(UA_Worker *worker) {
+    UA_Server *server = worker->server;
+    UA_UInt32 *counter = &worker->counter;
+    volatile UA_Boolean *running = &worker->running;
+    UA_Int32 credit[UA_JOBPRIORITYCOUNT] = {0};
 
     while(*running) {
-        struct DispatchJobsList *wln = (struct DispatchJobsList*)
-            cds_wfcq_dequeue_blocking(&server->dispatchQueue_head, &server->dispatchQueue_tail);
+        struct DispatchJobsList *wln = dequeueWeighted(server, server->dispatchLanes, credit);
         if(!wln) {
             uatomic_inc(counter);
-            /* sleep until a work arrives (and wakes up all worker threads) */
-            pthread_cond_wait(&server->dispatchQueue_condition, &mutex);
+            idleWorker(server, worker, server->dispatchLanes);
             continue;
         }
+        uatomic_dec(&server->dispatchQueueSize);
         processJobs(server, wln->jobs, wln->jobsSize);
-        UA_free(wln->jobs);
-        UA_free(wln);
+        releaseBatch(server, wln);
         uatomic_inc(counter);
     }
+}
+
+/**
+ * Thread Placement
+ * ----------------
+ * The workers pin themselves to their cpu before they allocate anything. So
+ * the kernel places their memory (stack, decoded messages, responses) on the
+ * local NUMA node. The main loop thread is pinned in UA_Server_run_startup. Its
+ * cpu is not used by the workers, so that the networklayers run undisturbed.
+ * The raw syscalls are used since the glibc wrappers require _GNU_SOURCE.
+ */
+
+#ifdef __linux__
+#define UA_MAXCPUS 1024
+
+static UA_StatusCode pinThread(UA_UInt32 cpu) {
+    unsigned long mask[UA_MAXCPUS / (8 * sizeof(unsigned long))];
+    const size_t bits = 8 * sizeof(unsigned long);
+    if(cpu >= UA_MAXCPUS)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    memset(mask, 0, sizeof(mask));
+    mask[cpu / bits] |= 1UL << (cpu % bits);
+    if(syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) != 0)
+        return UA_STATUSCODE_BADINTERNALERROR;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* The cpus from the config without the cpu of the main loop */
+static UA_Boolean workerCpu(const UA_ServerConfig *config, size_t index, UA_UInt32 *cpu) {
+    size_t usable = 0;
+    for(size_t i = 0; i < config->workerCpusSize; i++) {
+        if((UA_Int32)config->workerCpus[i] != config->mainLoopCpu)
+            usable++;
+    }
+    if(usable == 0)
+        return false;
+    index = index % usable;
+    for(size_t i = 0; i < config->workerCpusSize; i++) {
+        if((UA_Int32)config->workerCpus[i] == config->mainLoopCpu)
+            continue;
+        if(index == 0) {
+            *cpu = config->workerCpus[i];
+            return true;
+        }
+        index--;
+    }
+    return false;
+}
+
+static void placeWorker(UA_Worker *worker) {
+    UA_Server *server = worker->server;
+    size_t index = (size_t)(worker - server->workers);
+    UA_UInt32 cpu;
+    if(workerCpu(&server->config, index, &cpu) && pinThread(cpu) != UA_STATUSCODE_GOOD)
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Could not pin worker %u to cpu %u", (unsigned int)index, cpu);
+    if(server->config.nameThreads) {
+        char name[16]; // the kernel limit for thread names
+        snprintf(name, sizeof(name), "ua-worker-%u", (unsigned int)index);
+        prctl(PR_SET_NAME, name, 0, 0, 0);
+    }
+}
+
+static void placeMainLoop(UA_Server *server) {
+    if(server->config.mainLoopCpu < 0)
+        return;
+    if(pinThread((UA_UInt32)server->config.mainLoopCpu) != UA_STATUSCODE_GOOD)
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Could not pin the main loop to cpu %i", server->config.mainLoopCpu);
+}
+#else
+static void placeWorker(UA_Worker *worker) {}
+
+static void placeMainLoop(UA_Server *server) {
+    if(server->config.mainLoopCpu >= 0 || server->config.workerCpusSize > 0)
+        UA_LOG_WARNING(server->config.logger, UA_LOGCATEGORY_SERVER,
+                       "Pinning threads to cpus is only supported on Linux");
+}
+#endif
+
+static void * workerLoop(UA_Worker *worker) {
+    placeWorker(worker);
+    /* Initialize the (thread local) random seed with the ram address of worker */
+    UA_random_seed((uintptr_t)worker);
+   	rcu_register_thread();
+    localWorker = worker;
+
+    if(PERWORKERQUEUES(worker->server))
+        workerLoopOwnQueue(worker);
+    else
+        workerLoopShared(worker);
+
+    flushRetired(worker);
+    localWorker = NULL;
 
-    pthread_mutex_unlock(&mutex);
-    pthread_mutex_destroy(&mutex);
     UA_ASSERT_RCU_UNLOCKED();
     rcu_barrier(); // wait for all scheduled call_rcu work to complete
    	rcu_unregister_thread();
     return NULL;
 }
 
-/** Dispatch jobs to workers. Slices the job array up if it contains more than
-    BATCHSIZE items. The jobs array is freed in the worker threads. */
+/* Call only from the main loop */
+static UA_Worker * selectWorker(UA_Server *server) {
+    size_t nThreads = server->config.nThreads;
+    size_t start = server->dispatchNext % nThreads;
+    server->dispatchNext = start + 1;
+    UA_Worker *best = &server->workers[start];
+    UA_UInt32 bestQueued = uatomic_read(&best->queued);
+    for(size_t i = 1; i < nThreads && bestQueued > 0; i++) {
+        UA_Worker *w = &server->workers[(start + i) % nThreads];
+        UA_UInt32 queued = uatomic_read(&w->queued);
+        if(queued < bestQueued) {
+            best = w;
+            bestQueued = queued;
+        }
+    }
+    return best;
+}
+
+/* Enqueue to the given worker. If worker is NULL, select the least loaded
+   worker (or use the shared queue). */
+static void
+enqueueJobsList(UA_Server *server, UA_Worker *worker, struct DispatchJobsList *wln) {
+    cds_wfcq_node_init(&wln->node);
+    uatomic_inc(&server->dispatchQueueSize);
+    if(!PERWORKERQUEUES(server)) {
+        UA_DispatchLane *lane = &server->dispatchLanes[wln->priority];
+        cds_wfcq_enqueue(&lane->head, &lane->tail, &wln->node);
+        cmm_smp_mb();
+        wakeAnyWorker(server);
+        return;
+    }
+    if(!worker)
+        worker = selectWorker(server);
+    uatomic_inc(&worker->queued);
+    UA_DispatchLane *lane = &worker->lanes[wln->priority];
+    cds_wfcq_enqueue(&lane->head, &lane->tail, &wln->node);
+    cmm_smp_mb();
+    /* Wake up the worker that received the batch. If it is busy, a parked
+       peer can steal the batch. */
+    if(!wakeWorker(server, worker) && server->config.workStealing &&
+       !server->config.connectionAffinity)
+        wakeAnyWorker(server);
+}
+
+/**
+ * Adaptive Batching
+ * -----------------
+ * With config.adaptiveBatching, the execution time of every job is measured
+ * and a moving average is kept per job type. The jobs are then sliced into
+ * batches of roughly equal cost, so that every worker receives about the same
+ * share of the work. A batch does not cost less than MINBATCHCOST (unless the
+ * jobs run out), so that cheap jobs are not dispatched one by one.
+ */
+#define MINBATCHCOST ((UA_UInt64)500 << UA_JOBCOST_FRACBITS) // 50 microseconds
+
+static UA_UInt64 estimateJobCost(UA_Server *server, const UA_Job *job) {
+    UA_UInt64 cost = 0;
+    if(job->type >= 0 && job->type < UA_JOBTYPECOUNT)
+        cost = uatomic_read(&server->jobCost[job->type]);
+    return cost > 0 ? cost : 1;
+}
+
+/* Returns the number of jobs for the next batch */
+static size_t
+nextBatchSize(UA_Server *server, UA_Job *jobs, size_t jobsSize, UA_UInt64 targetCost) {
+    size_t max = jobsSize < BATCHSIZE ? jobsSize : BATCHSIZE;
+    if(!server->config.adaptiveBatching)
+        return max;
+    UA_UInt64 cost = 0;
+    size_t size = 0;
+    while(size < max && cost < targetCost) {
+        cost += estimateJobCost(server, &jobs[size]);
+        size++;
+    }
+    return size;
+}
+
+/**
+ * Connection Affinity
+ * -------------------
+ * Jobs that belong to a connection are hashed to a fixed worker. They all go
+ * to the normal lane of the worker, so that they are processed in the order of
+ * their arrival. The priority lanes only apply to the other jobs, which go to
+ * the least loaded worker. Every worker has an open batch during
+ * the dispatch that is enqueued when it is full or when all jobs are sorted
+ * in. With config.affinityRebalanceFactor, a batch is moved to the least
+ * loaded worker if the queue of the affine worker grows beyond that multiple
+ * of the average queue length.
+ */
+
+static UA_Worker * affineWorker(UA_Server *server, const UA_Job *job) {
+    UA_Connection *connection;
+    switch(job->type) {
+    case UA_JOBTYPE_DETACHCONNECTION:
+        connection = job->job.closeConnection;
+        break;
+    case UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER:
+    case UA_JOBTYPE_BINARYMESSAGE_ALLOCATED:
+        connection = job->job.binaryMessage.connection;
+        break;
+    default:
+        return NULL;
+    }
+    UA_UInt32 h = (UA_UInt32)((uintptr_t)connection >> 4) * 2654435761u; // Knuth
+    return &server->workers[h % server->config.nThreads];
+}
+
+/* There is an open batch for every combination of worker and priority */
+static void flushAffineBatch(UA_Server *server, size_t slot) {
+    struct DispatchJobsList *wln = server->affineBatches[slot];
+    server->affineBatches[slot] = NULL;
+    size_t nThreads = server->config.nThreads;
+    size_t workerIndex = slot / UA_JOBPRIORITYCOUNT;
+    UA_Worker *worker = NULL;
+    if(workerIndex < nThreads) {
+        worker = &server->workers[workerIndex];
+        UA_UInt16 factor = server->config.affinityRebalanceFactor;
+        if(factor > 0) {
+            UA_UInt32 average = uatomic_read(&server->dispatchQueueSize) / (UA_UInt32)nThreads;
+            if(uatomic_read(&worker->queued) > (average + 1) * factor)
+                worker = NULL; // rebalance
+        }
+    }
+    enqueueJobsList(server, worker, wln);
+}
+
+static void dispatchJobsAffine(UA_Server *server, UA_Job *jobs, size_t jobsSize) {
+    size_t nThreads = server->config.nThreads;
+    size_t batches = 0;
+    for(size_t i = 0; i < jobsSize; i++) {
+        /* The jobs of a connection stay in one fifo (the normal lane of the
+           worker). Only the other jobs are sorted into the lanes. */
+        UA_Worker *worker = affineWorker(server, &jobs[i]);
+        UA_JobPriority priority = worker ? UA_JOBPRIORITY_NORMAL : jobPriority(&jobs[i]);
+        size_t slot = worker ? (size_t)(worker - server->workers) : nThreads;
+        slot = (slot * UA_JOBPRIORITYCOUNT) + priority;
+        struct DispatchJobsList *wln = server->affineBatches[slot];
+        if(!wln) {
+            wln = getBatch(server);
+            if(!wln) {
+                UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
+                             "Not enough memory to dispatch jobs to the worker threads");
+                processJobs(server, &jobs[i], 1);
+                continue;
+            }
+            wln->priority = priority;
+            wln->jobsSize = 0;
+            server->affineBatches[slot] = wln;
+            batches++;
+        }
+        wln->jobs[wln->jobsSize] = jobs[i];
+        wln->jobsSize++;
+        if(wln->jobsSize == BATCHSIZE)
+            flushAffineBatch(server, slot);
+    }
+    for(size_t slot = 0; slot < (nThreads + 1) * UA_JOBPRIORITYCOUNT; slot++) {
+        if(server->affineBatches[slot])
+            flushAffineBatch(server, slot);
+    }
+    if(jobsSize > 0) {
+        if(batches > 0)
+            server->lastBatchSize = (UA_UInt32)((jobsSize + batches - 1) / batches);
+        UA_free(jobs);
+    }
+}
+
+/* Dispatch jobs of the same priority. Returns the number of batches. */
+static size_t
+dispatchJobsLane(UA_Server *server, UA_Job *jobs, size_t jobsSize, UA_JobPriority priority) {
+    /* The cost per batch so that every worker gets an equal share */
+    UA_UInt64 targetCost = 0;
+    if(server->config.adaptiveBatching) {
+        for(size_t i = 0; i < jobsSize; i++)
+            targetCost += estimateJobCost(server, &jobs[i]);
+        if(server->config.nThreads > 0)
+            targetCost /= server->config.nThreads;
+        if(targetCost < MINBATCHCOST)
+            targetCost = MINBATCHCOST;
+    }
+
+    size_t batches = 0;
+    size_t size;
+    for(size_t i = 0; i < jobsSize; i += size) {
+        size = nextBatchSize(server, &jobs[i], jobsSize - i, targetCost);
+        struct DispatchJobsList *wln = getBatch(server);
+        if(!wln) {
+            /* process the remaining jobs in the main loop */
+            UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
+                         "Not enough memory to dispatch jobs to the worker threads");
+            processJobs(server, &jobs[i], jobsSize - i);
+            break;
+        }
+        memcpy(wln->jobs, &jobs[i], size * sizeof(UA_Job));
+        wln->jobsSize = size;
+        wln->priority = priority;
+        enqueueJobsList(server, NULL, wln);
+        batches++;
+    }
+    return batches;
+}
+
+/** Dispatch jobs to workers. Copies the jobs into batches of up to BATCHSIZE
+    items. The jobs array is freed. Call only from the main loop. */
 static void dispatchJobs(UA_Server *server, UA_Job *jobs, size_t jobsSize) {
-    size_t startIndex = jobsSize; // start at the end
-    while(jobsSize > 0) {
-        size_t size = BATCHSIZE;
-        if(size > jobsSize)
-            size = jobsSize;
-        startIndex = startIndex - size;
-        struct DispatchJobsList *wln = UA_malloc(sizeof(struct DispatchJobsList));
-        if(startIndex > 0) {
-            wln->jobs = UA_malloc(size * sizeof(UA_Job));
-            memcpy(wln->jobs, &jobs[startIndex], size * sizeof(UA_Job));
-            wln->jobsSize = size;
-        } else {
-            /* forward the original array */
-            wln->jobsSize = size;
-            wln->jobs = jobs;
+    if(server->affineBatches) {
+        dispatchJobsAffine(server, jobs, jobsSize);
+        return;
+    }
+    if(jobsSize == 0)
+        return;
+
+    /* Count the jobs per priority */
+    size_t count[UA_JOBPRIORITYCOUNT] = {0};
+    for(size_t i = 0; i < jobsSize; i++)
+        count[jobPriority(&jobs[i])]++;
+
+    size_t batches = 0;
+    UA_JobPriority priority = jobPriority(&jobs[0]);
+    UA_Job *sorted = NULL;
+    if(count[priority] < jobsSize)
+        sorted = UA_malloc(jobsSize * sizeof(UA_Job));
+    if(!sorted) {
+        /* All jobs have the same priority (or no memory to sort them) */
+        batches = dispatchJobsLane(server, jobs, jobsSize, priority);
+    } else {
+        /* Stable counting sort by priority */
+        size_t offset[UA_JOBPRIORITYCOUNT];
+        size_t start = 0;
+        for(size_t p = 0; p < UA_JOBPRIORITYCOUNT; p++) {
+            offset[p] = start;
+            start += count[p];
+        }
+        for(size_t i = 0; i < jobsSize; i++)
+            sorted[offset[jobPriority(&jobs[i])]++] = jobs[i];
+        for(size_t i = 0; i < UA_JOBPRIORITYCOUNT; i++) {
+            UA_JobPriority p = laneOrder[i];
+            size_t first = offset[p] - count[p];
+            if(count[p] > 0)
+                batches += dispatchJobsLane(server, &sorted[first], count[p], p);
         }
-        cds_wfcq_node_init(&wln->node);
-        cds_wfcq_enqueue(&server->dispatchQueue_head, &server->dispatchQueue_tail, &wln->node);
-        jobsSize -= size;
+        UA_free(sorted);
     }
+    if(batches > 0)
+        server->lastBatchSize = (UA_UInt32)((jobsSize + batches - 1) / batches);
+    UA_free(jobs);
+}
+
+UA_StatusCode
+UA_Server_getDispatchStatistics(UA_Server *server, UA_DispatchStatistics *stats) {
+    stats->batchSize = server->lastBatchSize;
+    stats->queueDepth = uatomic_read(&server->dispatchQueueSize);
+    stats->mainLoopJobsOverflow = uatomic_read(&server->mainLoopJobsOverflow);
+    stats->delayedJobsPending = uatomic_read(&server->delayedJobsPending);
+    return UA_STATUSCODE_GOOD;
 }
 
 static void
-emptyDispatchQueue(UA_Server *server) {
-    while(!cds_wfcq_empty(&server->dispatchQueue_head, &server->dispatchQueue_tail)) {
-        struct DispatchJobsList *wln = (struct DispatchJobsList*)
-            cds_wfcq_dequeue_blocking(&server->dispatchQueue_head, &server->dispatchQueue_tail);
+emptyQueue(UA_Server *server, UA_DispatchLane *lanes) {
+    struct DispatchJobsList *wln;
+    while((wln = dequeueOrdered(lanes))) {
+        uatomic_dec(&server->dispatchQueueSize);
         processJobs(server, wln->jobs, wln->jobsSize);
-        UA_free(wln->jobs);
-        UA_free(wln);
+        releaseBatch(server, wln);
     }
 }
 
+static void
+emptyDispatchQueue(UA_Server *server) {
+    emptyQueue(server, server->dispatchLanes);
+}
+
 #endif
 
 /*****************/
 /* Repeated Jobs */
 /*****************/
 
-struct IdentifiedJob {
-    UA_Job job;
-    UA_Guid id;
-};
-
 /**
- * The RepeatedJobs structure contains an array of jobs that are either executed with the same
- * repetition interval. The linked list is sorted, so we can stop traversing when the first element
- * has nextTime > now.
+ * Repeated jobs are kept in a binary min-heap ordered by the time of their next
+ * execution. Every job knows its position in the heap. So a job can be removed
+ * by its handle in O(log n) without searching. The top of the heap is the next
+ * deadline of the main loop.
+ *
+ * With multithreading, the job is added to the heap in the main loop. The
+ * handle is returned before that. So the insertion must not fail. Every job
+ * reserves its heap slot when it is created. If the reservations exceed the
+ * capacity of the heap, the creator allocates a larger heap array that the
+ * main loop takes over. The capacity never shrinks.
  */
-struct RepeatedJobs {
-    LIST_ENTRY(RepeatedJobs) pointers; ///> Links to the next list of repeated jobs (with a different) interval
-    UA_DateTime nextTime; ///> The next time when the jobs are to be executed
+#define REPEATEDJOB_DETACHED ((size_t)-1) // the job is not in the heap
+
+struct UA_RepeatedJob {
+    UA_DateTime nextTime; ///> The next time when the job is to be executed
     UA_UInt32 interval; ///> Interval in 100ns resolution
-    size_t jobsSize; ///> Number of jobs contained
-    struct IdentifiedJob jobs[]; ///> The jobs. This is not a pointer, instead the struct is variable sized.
+    size_t heapIndex; ///> Position in the heap
+    UA_Boolean removed; ///> Removal was requested before the job was added to the heap
+    UA_Guid id;
+    UA_Job job;
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_RepeatedJob **heap; ///> Larger heap array for the reservation of the job (or NULL)
+    size_t heapCapacity;
+#endif
 };
 
-/* throwaway struct for the mainloop callback */
-struct AddRepeatedJob {
-    struct IdentifiedJob job;
-    UA_UInt32 interval;
-};
+static void heapSet(UA_Server *server, size_t index, UA_RepeatedJob *rj) {
+    server->repeatedJobs[index] = rj;
+    rj->heapIndex = index;
+}
 
-/* internal. call only from the main loop. */
-static UA_StatusCode addRepeatedJob(UA_Server *server, struct AddRepeatedJob * UA_RESTRICT arw) {
-    struct RepeatedJobs *matchingTw = NULL; // add the item here
-    struct RepeatedJobs *lastTw = NULL; // if there is no repeated job, add a new one this entry
-    struct RepeatedJobs *tempTw;
-    UA_StatusCode retval = UA_STATUSCODE_GOOD;
-
-    /* search for matching entry */
-    UA_DateTime firstTime = UA_DateTime_nowMonotonic() + arw->interval;
-    tempTw = LIST_FIRST(&server->repeatedJobs);
-    while(tempTw) {
-        if(arw->interval == tempTw->interval) {
-            matchingTw = tempTw;
+static void heapSiftUp(UA_Server *server, size_t index) {
+    UA_RepeatedJob *rj = server->repeatedJobs[index];
+    while(index > 0) {
+        size_t parent = (index - 1) / 2;
+        if(server->repeatedJobs[parent]->nextTime <= rj->nextTime)
             break;
-        }
-        if(tempTw->nextTime > firstTime)
+        heapSet(server, index, server->repeatedJobs[parent]);
+        index = parent;
+    }
+    heapSet(server, index, rj);
+}
+
+static void heapSiftDown(UA_Server *server, size_t index) {
+    UA_RepeatedJob *rj = server->repeatedJobs[index];
+    size_t size = server->repeatedJobsSize;
+    while(true) {
+        size_t child = (2 * index) + 1;
+        if(child >= size)
+            break;
+        if(child + 1 < size &&
+           server->repeatedJobs[child + 1]->nextTime < server->repeatedJobs[child]->nextTime)
+            child++;
+        if(rj->nextTime <= server->repeatedJobs[child]->nextTime)
             break;
-        lastTw = tempTw;
-        tempTw = LIST_NEXT(lastTw, pointers);
+        heapSet(server, index, server->repeatedJobs[child]);
+        index = child;
     }
+    heapSet(server, index, rj);
+}
 
-    if(matchingTw) {
-        /* append to matching entry */
-        matchingTw = UA_realloc(matchingTw, sizeof(struct RepeatedJobs) +
-                                (sizeof(struct IdentifiedJob) * (matchingTw->jobsSize + 1)));
-        if(!matchingTw) {
-            retval = UA_STATUSCODE_BADOUTOFMEMORY;
-            goto cleanup;
-        }
-        /* link the reallocated tw into the list */
-        LIST_REPLACE(matchingTw, matchingTw, pointers);
-    } else {
-        /* create a new entry */
-        matchingTw = UA_malloc(sizeof(struct RepeatedJobs) + sizeof(struct IdentifiedJob));
-        if(!matchingTw) {
-            retval = UA_STATUSCODE_BADOUTOFMEMORY;
-            goto cleanup;
+static UA_StatusCode heapInsert(UA_Server *server, UA_RepeatedJob *rj) {
+#ifdef UA_ENABLE_MULTITHREADING
+    /* take over the larger heap array allocated with the reservation */
+    if(rj->heap) {
+        if(rj->heapCapacity > server->repeatedJobsCapacity) {
+            if(server->repeatedJobsSize > 0)
+                memcpy(rj->heap, server->repeatedJobs,
+                       server->repeatedJobsSize * sizeof(UA_RepeatedJob*));
+            UA_free(server->repeatedJobs);
+            server->repeatedJobs = rj->heap;
+            uatomic_set(&server->repeatedJobsCapacity, rj->heapCapacity);
+        } else {
+            UA_free(rj->heap);
         }
-        matchingTw->jobsSize = 0;
-        matchingTw->nextTime = firstTime;
-        matchingTw->interval = arw->interval;
-        if(lastTw)
-            LIST_INSERT_AFTER(lastTw, matchingTw, pointers);
-        else
-            LIST_INSERT_HEAD(&server->repeatedJobs, matchingTw, pointers);
+        rj->heap = NULL;
+    }
+#else
+    if(server->repeatedJobsSize >= server->repeatedJobsCapacity) {
+        size_t capacity = server->repeatedJobsCapacity * 2;
+        if(capacity == 0)
+            capacity = 16;
+        UA_RepeatedJob **heap = UA_realloc(server->repeatedJobs, capacity * sizeof(UA_RepeatedJob*));
+        if(!heap)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        server->repeatedJobs = heap;
+        server->repeatedJobsCapacity = capacity;
     }
-    matchingTw->jobs[matchingTw->jobsSize] = arw->job;
-    matchingTw->jobsSize++;
+#endif
+    server->repeatedJobs[server->repeatedJobsSize] = rj;
+    server->repeatedJobsSize++;
+    heapSiftUp(server, server->repeatedJobsSize - 1);
+    return UA_STATUSCODE_GOOD;
+}
+
+static void heapRemove(UA_Server *server, UA_RepeatedJob *rj) {
+    size_t index = rj->heapIndex;
+    rj->heapIndex = REPEATEDJOB_DETACHED;
+    server->repeatedJobsSize--;
+    if(index == server->repeatedJobsSize)
+        return;
+    /* move the last element into the gap and restore the heap property */
+    UA_RepeatedJob *last = server->repeatedJobs[server->repeatedJobsSize];
+    heapSet(server, index, last);
+    if(index > 0 && server->repeatedJobs[(index - 1) / 2]->nextTime > last->nextTime)
+        heapSiftUp(server, index);
+    else
+        heapSiftDown(server, index);
+}
 
- cleanup:
+/* Free a job that is not in the heap (anymore) */
+static void freeRepeatedJob(UA_Server *server, UA_RepeatedJob *rj) {
 #ifdef UA_ENABLE_MULTITHREADING
-    UA_free(arw);
+    UA_free(rj->heap);
+    uatomic_dec(&server->repeatedJobsReserved);
 #endif
+    UA_free(rj);
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+/* Reserve a heap slot for a new job. Can be called from any thread. */
+static UA_StatusCode reserveRepeatedJob(UA_Server *server, UA_RepeatedJob *rj) {
+    rj->heap = NULL;
+    rj->heapCapacity = 0;
+    size_t reserved = uatomic_add_return(&server->repeatedJobsReserved, 1);
+    if(reserved <= uatomic_read(&server->repeatedJobsCapacity))
+        return UA_STATUSCODE_GOOD;
+    size_t capacity = reserved * 2;
+    if(capacity < 16)
+        capacity = 16;
+    rj->heap = UA_malloc(capacity * sizeof(UA_RepeatedJob*));
+    if(!rj->heap) {
+        uatomic_dec(&server->repeatedJobsReserved);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    rj->heapCapacity = capacity;
+    return UA_STATUSCODE_GOOD;
+}
+#endif
+
+/* internal. call only from the main loop. */
+static UA_StatusCode addRepeatedJob(UA_Server *server, UA_RepeatedJob *rj) {
+    /* the job was removed via its handle before it could be added */
+    if(rj->removed) {
+        freeRepeatedJob(server, rj);
+        return UA_STATUSCODE_GOOD;
+    }
+    rj->nextTime = UA_DateTime_nowMonotonic() + rj->interval;
+    UA_StatusCode retval = heapInsert(server, rj); // cannot fail with multithreading
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
+                     "Not enough memory to add a repeated job");
+        freeRepeatedJob(server, rj);
+    }
     return retval;
 }
 
-UA_StatusCode UA_Server_addRepeatedJob(UA_Server *server, UA_Job job, UA_UInt32 interval, UA_Guid *jobId) {
+static UA_StatusCode
+addRepeatedJobEntry(UA_Server *server, UA_Job job, UA_UInt32 interval,
+                    UA_Guid *jobId, UA_RepeatedJob **handle) {
     /* the interval needs to be at least 5ms */
     if(interval < 5)
         return UA_STATUSCODE_BADINTERNALERROR;
-    interval *= (UA_UInt32)UA_MSEC_TO_DATETIME; // from ms to 100ns resolution
 
-#ifdef UA_ENABLE_MULTITHREADING
-    struct AddRepeatedJob *arw = UA_malloc(sizeof(struct AddRepeatedJob));
-    if(!arw)
+    UA_RepeatedJob *rj = UA_malloc(sizeof(UA_RepeatedJob));
+    if(!rj)
         return UA_STATUSCODE_BADOUTOFMEMORY;
-
-    arw->interval = interval;
-    arw->job.job = job;
+    rj->interval = interval * (UA_UInt32)UA_MSEC_TO_DATETIME; // from ms to 100ns resolution
+    rj->heapIndex = REPEATEDJOB_DETACHED;
+    rj->removed = false;
+    rj->job = job;
     if(jobId) {
-        arw->job.id = UA_Guid_random();
-        *jobId = arw->job.id;
+        rj->id = UA_Guid_random();
+        *jobId = rj->id;
     } else
-        UA_Guid_init(&arw->job.id);
+        UA_Guid_init(&rj->id);
 
-    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
-    if(!mlw) {
-        UA_free(arw);
+#ifdef UA_ENABLE_MULTITHREADING
+    if(reserveRepeatedJob(server, rj) != UA_STATUSCODE_GOOD) {
+        UA_free(rj);
         return UA_STATUSCODE_BADOUTOFMEMORY;
     }
-    mlw->job = (UA_Job) {
+    UA_Job mlj = {
         .type = UA_JOBTYPE_METHODCALL,
-        .job.methodCall = {.data = arw, .method = (void (*)(UA_Server*, void*))addRepeatedJob}};
-    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
+        .job.methodCall = {.data = rj, .method = (void (*)(UA_Server*, void*))addRepeatedJob}};
+    if(addMainLoopJob(server, &mlj) != UA_STATUSCODE_GOOD) {
+        freeRepeatedJob(server, rj);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    if(handle)
+        *handle = rj;
+    return UA_STATUSCODE_GOOD;
 #else
-    struct AddRepeatedJob arw;
-    arw.interval = interval;
-    arw.job.job = job;
-    if(jobId) {
-        arw.job.id = UA_Guid_random();
-        *jobId = arw.job.id;
-    } else
-        UA_Guid_init(&arw.job.id);
-    addRepeatedJob(server, &arw);
+    UA_StatusCode retval = addRepeatedJob(server, rj);
+    if(retval == UA_STATUSCODE_GOOD && handle)
+        *handle = rj;
+    return retval;
 #endif
-    return UA_STATUSCODE_GOOD;
+}
+
+UA_StatusCode UA_Server_addRepeatedJob(UA_Server *server, UA_Job job, UA_UInt32 interval, UA_Guid *jobId) {
+    return addRepeatedJobEntry(server, job, interval, jobId, NULL);
+}
+
+UA_StatusCode
+UA_Server_addRepeatedJobHandle(UA_Server *server, UA_Job job, UA_UInt32 interval,
+                               UA_RepeatedJob **handle) {
+    return addRepeatedJobEntry(server, job, interval, NULL, handle);
 }
 
 /* Returns the next datetime when a repeated job is scheduled */
 static UA_DateTime processRepeatedJobs(UA_Server *server, UA_DateTime current) {
-    struct RepeatedJobs *tw = NULL;
-    while((tw = LIST_FIRST(&server->repeatedJobs)) != NULL) {
-        if(tw->nextTime > current)
-            break;
-
 #ifdef UA_ENABLE_MULTITHREADING
-        // copy the entry and insert at the new location
-        UA_Job *jobsCopy = UA_malloc(sizeof(UA_Job) * tw->jobsSize);
-        if(!jobsCopy) {
-            UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
-                         "Not enough memory to dispatch delayed jobs");
-            break;
-        }
-        for(size_t i=0;i<tw->jobsSize;i++)
-            jobsCopy[i] = tw->jobs[i].job;
-        dispatchJobs(server, jobsCopy, tw->jobsSize); // frees the job pointer
-#else
-        for(size_t i=0;i<tw->jobsSize;i++)
-            //processJobs may sort the list but dont delete entries
-            processJobs(server, &tw->jobs[i].job, 1); // does not free the job ptr
+    UA_Job *jobs = NULL;
+    size_t jobsSize = 0, jobsCapacity = 0;
 #endif
+    while(server->repeatedJobsSize > 0) {
+        UA_RepeatedJob *rj = server->repeatedJobs[0];
+        if(rj->nextTime > current)
+            break;
 
-        /* set the time for the next execution */
-        tw->nextTime += tw->interval;
-        if(tw->nextTime < current)
-            tw->nextTime = current;
+        /* set the time for the next execution and move the job down in the
+           heap before it is executed. So the job may remove itself. */
+        UA_Job job = rj->job;
+        rj->nextTime += rj->interval;
+        if(rj->nextTime < current)
+            rj->nextTime = current;
+        heapSiftDown(server, 0);
 
-        //start iterating the list from the beginning
-        struct RepeatedJobs *prevTw = LIST_FIRST(&server->repeatedJobs); // after which tw do we insert?
-        while(true) {
-            struct RepeatedJobs *n = LIST_NEXT(prevTw, pointers);
-            if(!n || n->nextTime > tw->nextTime)
+#ifdef UA_ENABLE_MULTITHREADING
+        /* collect the jobs and dispatch them at once */
+        if(jobsSize >= jobsCapacity) {
+            size_t capacity = jobsCapacity * 2;
+            if(capacity == 0)
+                capacity = BATCHSIZE;
+            UA_Job *newJobs = UA_realloc(jobs, capacity * sizeof(UA_Job));
+            if(!newJobs) {
+                UA_LOG_ERROR(server->config.logger, UA_LOGCATEGORY_SERVER,
+                             "Not enough memory to dispatch repeated jobs");
                 break;
-            prevTw = n;
-        }
-        if(prevTw != tw) {
-            LIST_REMOVE(tw, pointers);
-            LIST_INSERT_AFTER(prevTw, tw, pointers);
+            }
+            jobs = newJobs;
+            jobsCapacity = capacity;
         }
+        jobs[jobsSize] = job;
+        jobsSize++;
+#else
+        processJobs(server, &job, 1);
+#endif
     }
 
-    // check if the next repeated job is sooner than the usual timeout
-    // calc in 32 bit must be ok
-    struct RepeatedJobs *first = LIST_FIRST(&server->repeatedJobs);
+#ifdef UA_ENABLE_MULTITHREADING
+    if(jobsSize > 0)
+        dispatchJobs(server, jobs, jobsSize); // frees the job pointer
+    else
+        UA_free(jobs);
+#endif
+
+    /* check if the next repeated job is sooner than the usual timeout */
     UA_DateTime next = current + (MAXTIMEOUT * UA_MSEC_TO_DATETIME);
-    if(first && first->nextTime < next)
-        next = first->nextTime;
+    if(server->repeatedJobsSize > 0 && server->repeatedJobs[0]->nextTime < next)
+        next = server->repeatedJobs[0]->nextTime;
     return next;
 }
 
 /* Call this function only from the main loop! */
 static void removeRepeatedJob(UA_Server *server, UA_Guid *jobId) {
-    struct RepeatedJobs *tw;
-    LIST_FOREACH(tw, &server->repeatedJobs, pointers) {
-        for(size_t i = 0; i < tw->jobsSize; i++) {
-            if(!UA_Guid_equal(jobId, &tw->jobs[i].id))
-                continue;
-            if(tw->jobsSize == 1) {
-                LIST_REMOVE(tw, pointers);
-                UA_free(tw);
-            } else {
-                tw->jobsSize--;
-                tw->jobs[i] = tw->jobs[tw->jobsSize]; // move the last entry to overwrite
-            }
-            goto finish; // ugly break
-        }
+    for(size_t i = 0; i < server->repeatedJobsSize; i++) {
+        UA_RepeatedJob *rj = server->repeatedJobs[i];
+        if(!UA_Guid_equal(jobId, &rj->id))
+            continue;
+        heapRemove(server, rj);
+        freeRepeatedJob(server, rj);
+        break;
     }
- finish:
 #ifdef UA_ENABLE_MULTITHREADING
     UA_free(jobId);
 #endif
-    return;
+}
+
+/* Call this function only from the main loop! */
+static void removeRepeatedJobHandle(UA_Server *server, UA_RepeatedJob *rj) {
+    if(rj->heapIndex == REPEATEDJOB_DETACHED) {
+        /* not yet added. addRepeatedJob frees the job. */
+        rj->removed = true;
+        return;
+    }
+    heapRemove(server, rj);
+    freeRepeatedJob(server, rj);
 }
 
 UA_StatusCode UA_Server_removeRepeatedJob(UA_Server *server, UA_Guid jobId) {
@@ -372,24 +1197,46 @@ UA_StatusCode UA_Server_removeRepeatedJob(UA_Server *server, UA_Guid jobId) {
     if(!idptr)
         return UA_STATUSCODE_BADOUTOFMEMORY;
     *idptr = jobId;
-    // dispatch to the mainloopjobs stack
-    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
-    mlw->job = (UA_Job) {
+    // dispatch to the mainloop jobs
+    UA_Job mlj = {
         .type = UA_JOBTYPE_METHODCALL,
         .job.methodCall = {.data = idptr, .method = (void (*)(UA_Server*, void*))removeRepeatedJob}};
-    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
+    if(addMainLoopJob(server, &mlj) != UA_STATUSCODE_GOOD) {
+        UA_free(idptr);
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
 #else
     removeRepeatedJob(server, &jobId);
 #endif
     return UA_STATUSCODE_GOOD;
 }
 
+UA_StatusCode UA_Server_removeRepeatedJobHandle(UA_Server *server, UA_RepeatedJob *handle) {
+    if(!handle)
+        return UA_STATUSCODE_BADINTERNALERROR;
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_Job mlj = {
+        .type = UA_JOBTYPE_METHODCALL,
+        .job.methodCall = {.data = handle, .method = (void (*)(UA_Server*, void*))removeRepeatedJobHandle}};
+    UA_StatusCode retval = addMainLoopJob(server, &mlj);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+#else
+    removeRepeatedJobHandle(server, handle);
+#endif
+    return UA_STATUSCODE_GOOD;
+}
+
 void UA_Server_deleteAllRepeatedJobs(UA_Server *server) {
-    struct RepeatedJobs *current, *temp;
-    LIST_FOREACH_SAFE(current, &server->repeatedJobs, pointers, temp) {
-        LIST_REMOVE(current, pointers);
-        UA_free(current);
-    }
+    for(size_t i = 0; i < server->repeatedJobsSize; i++)
+        UA_free(server->repeatedJobs[i]);
+    UA_free(server->repeatedJobs);
+    server->repeatedJobs = NULL;
+    server->repeatedJobsSize = 0;
+    server->repeatedJobsCapacity = 0;
+#ifdef UA_ENABLE_MULTITHREADING
+    server->repeatedJobsReserved = 0;
+#endif
 }
 
 /****************/
@@ -398,7 +1245,18 @@ void UA_Server_deleteAllRepeatedJobs(UA_Server *server) {
 
 #ifdef UA_ENABLE_MULTITHREADING
 
-#define DELAYEDJOBSSIZE 100 // Collect delayed jobs until we have DELAYEDWORKSIZE items
+#define DELAYEDJOBSSIZE 256 // Collect delayed jobs until we have DELAYEDJOBSSIZE items
+
+/**
+ * The delayed jobs are collected in batches. A batch is executed when all
+ * workers have finished the jobs they were running when the batch was closed.
+ * The counters of the workers are recorded once per batch.
+ *
+ * Workers do not send every retired object to the main loop. They collect
+ * them in a thread-local batch. When it is full (or the worker becomes idle),
+ * the worker records the counters and hands the batch to the main loop with a
+ * single mainloop job.
+ */
 
 struct DelayedJobs {
     struct DelayedJobs *next;
@@ -407,12 +1265,49 @@ struct DelayedJobs {
     UA_Job jobs[DELAYEDJOBSSIZE]; // when it runs full, a new delayedJobs entry is created
 };
 
-/* Dispatched as an ordinary job when the DelayedJobs list is full */
-static void getCounters(UA_Server *server, struct DelayedJobs *delayed) {
+static UA_UInt32 * snapshotCounters(UA_Server *server) {
     UA_UInt32 *counters = UA_malloc(server->config.nThreads * sizeof(UA_UInt32));
+    if(!counters)
+        return NULL;
     for(UA_UInt16 i = 0; i < server->config.nThreads; i++)
-        counters[i] = server->workers[i].counter;
-    delayed->workerCounters = counters;
+        counters[i] = uatomic_read(&server->workers[i].counter);
+    return counters;
+}
+
+/* Dispatched as an ordinary job when the DelayedJobs list is full */
+static void getCounters(UA_Server *server, struct DelayedJobs *delayed) {
+    delayed->workerCounters = snapshotCounters(server);
+}
+
+/* All workers have finished the jobs they ran when the counters were recorded.
+   A parked worker is between two jobs and holds no references. */
+static UA_Boolean delayedJobsReady(UA_Server *server, struct DelayedJobs *dj) {
+    if(!dj->workerCounters)
+        return false;
+    for(size_t i = 0; i < server->config.nThreads; i++) {
+        UA_Worker *worker = &server->workers[i];
+        if(dj->workerCounters[i] == uatomic_read(&worker->counter) &&
+           !uatomic_read(&worker->sleeping))
+            return false;
+    }
+    return true;
+}
+
+/* Insert a new DelayedJobs at the head of the list. Call only from the main
+   loop. */
+static void pushDelayedJobs(UA_Server *server, struct DelayedJobs *dj) {
+    dj->next = server->delayedJobs;
+    server->delayedJobs = dj;
+
+    /* dispatch a method that sets the counter for the list that comes afterwards */
+    if(dj->next && !dj->next->workerCounters && server->workers) {
+        UA_Job *setCounter = UA_malloc(sizeof(UA_Job));
+        if(!setCounter)
+            return; // the counters are set in dispatchDelayedJobs
+        *setCounter = (UA_Job) {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
+                                {.method = (void (*)(UA_Server*, void*))getCounters, .data = dj->next}};
+        dispatchJobs(server, setCounter, 1);
+    }
 }
 
 // Call from the main thread only. This is the only function that modifies
@@ -420,7 +1315,7 @@ static void getCounters(UA_Server *server, struct DelayedJobs *delayed) {
 // head).
 static void addDelayedJob(UA_Server *server, UA_Job *job) {
     struct DelayedJobs *dj = server->delayedJobs;
-    if(!dj || dj->jobsCount >= DELAYEDJOBSSIZE) {
+    if(!dj || dj->workerCounters || dj->jobsCount >= DELAYEDJOBSSIZE) {
         /* create a new DelayedJobs and add it to the linked list */
         dj = UA_malloc(sizeof(struct DelayedJobs));
         if(!dj) {
@@ -430,19 +1325,11 @@ static void addDelayedJob(UA_Server *server, UA_Job *job) {
         }
         dj->jobsCount = 0;
         dj->workerCounters = NULL;
-        dj->next = server->delayedJobs;
-        server->delayedJobs = dj;
-
-        /* dispatch a method that sets the counter for the full list that comes afterwards */
-        if(dj->next) {
-            UA_Job *setCounter = UA_malloc(sizeof(UA_Job));
-            *setCounter = (UA_Job) {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
-                                    {.method = (void (*)(UA_Server*, void*))getCounters, .data = dj->next}};
-            dispatchJobs(server, setCounter, 1);
-        }
+        pushDelayedJobs(server, dj);
     }
     dj->jobs[dj->jobsCount] = *job;
     dj->jobsCount++;
+    uatomic_inc(&server->delayedJobsPending);
 }
 
 static void addDelayedJobAsync(UA_Server *server, UA_Job *job) {
@@ -450,85 +1337,127 @@ static void addDelayedJobAsync(UA_Server *server, UA_Job *job) {
     UA_free(job);
 }
 
+/* Called in the main loop with a batch of retired objects from a worker */
+static void addRetiredJobs(UA_Server *server, struct DelayedJobs *dj) {
+    pushDelayedJobs(server, dj);
+}
+
+/* Hand the retired objects of the worker to the main loop */
+static void flushRetired(UA_Worker *worker) {
+    struct DelayedJobs *dj = worker->retired;
+    if(!dj)
+        return;
+    UA_Server *server = worker->server;
+    dj->workerCounters = snapshotCounters(server);
+    if(!dj->workerCounters)
+        return; // try again later
+    UA_Job mlj = {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
+                  {.data = dj, .method = (UA_ServerCallback)addRetiredJobs}};
+    if(addMainLoopJob(server, &mlj) != UA_STATUSCODE_GOOD) {
+        UA_free(dj->workerCounters);
+        dj->workerCounters = NULL;
+        return;
+    }
+    worker->retired = NULL;
+}
+
+/* Add the job to the retire list of the current worker. Returns false if the
+   current thread is not a worker of the server. */
+static UA_Boolean retireLocal(UA_Server *server, const UA_Job *job) {
+    UA_Worker *worker = localWorker;
+    if(!worker || worker->server != server)
+        return false;
+    struct DelayedJobs *dj = worker->retired;
+    if(!dj) {
+        dj = UA_malloc(sizeof(struct DelayedJobs));
+        if(!dj)
+            return false;
+        dj->next = NULL;
+        dj->workerCounters = NULL;
+        dj->jobsCount = 0;
+        worker->retired = dj;
+    }
+    if(dj->jobsCount >= DELAYEDJOBSSIZE)
+        return false; // the last flush failed
+    dj->jobs[dj->jobsCount] = *job;
+    dj->jobsCount++;
+    uatomic_inc(&server->delayedJobsPending);
+    if(dj->jobsCount >= DELAYEDJOBSSIZE)
+        flushRetired(worker);
+    return true;
+}
+
 static void server_free(UA_Server *server, void *data) {
     UA_free(data);
 }
 
 UA_StatusCode UA_Server_delayedFree(UA_Server *server, void *data) {
-    UA_Job *j = UA_malloc(sizeof(UA_Job));
-    if(!j)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-    j->type = UA_JOBTYPE_METHODCALL;
-    j->job.methodCall.data = data;
-    j->job.methodCall.method = server_free;
-    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
-    mlw->job = (UA_Job) {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
-                         {.data = j, .method = (UA_ServerCallback)addDelayedJobAsync}};
-    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
-    return UA_STATUSCODE_GOOD;
+    return UA_Server_delayedCallback(server, server_free, data);
 }
 
 UA_StatusCode
 UA_Server_delayedCallback(UA_Server *server, UA_ServerCallback callback, void *data) {
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL,
+                  .job.methodCall = {.data = data, .method = callback}};
+    if(retireLocal(server, &job))
+        return UA_STATUSCODE_GOOD;
     UA_Job *j = UA_malloc(sizeof(UA_Job));
     if(!j)
         return UA_STATUSCODE_BADOUTOFMEMORY;
-    j->type = UA_JOBTYPE_METHODCALL;
-    j->job.methodCall.data = data;
-    j->job.methodCall.method = callback;
-    struct MainLoopJob *mlw = UA_malloc(sizeof(struct MainLoopJob));
-    mlw->job = (UA_Job) {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
-                         {.data = j, .method = (UA_ServerCallback)addDelayedJobAsync}};
-    cds_lfs_push(&server->mainLoopJobs, &mlw->node);
-    return UA_STATUSCODE_GOOD;
+    *j = job;
+    UA_Job mlj = {.type = UA_JOBTYPE_METHODCALL, .job.methodCall =
+                  {.data = j, .method = (UA_ServerCallback)addDelayedJobAsync}};
+    UA_StatusCode retval = addMainLoopJob(server, &mlj);
+    if(retval != UA_STATUSCODE_GOOD)
+        UA_free(j);
+    return retval;
+}
+
+static void processDelayedJobs(UA_Server *server, struct DelayedJobs *dj) {
+    processJobs(server, dj->jobs, dj->jobsCount);
+    uatomic_sub(&server->delayedJobsPending, dj->jobsCount);
+    UA_free(dj->workerCounters);
+    UA_free(dj);
 }
 
 /* Find out which delayed jobs can be executed now */
 static void
 dispatchDelayedJobs(UA_Server *server, void *_) {
-    /* start at the second */
-    struct DelayedJobs *dw = server->delayedJobs, *beforedw = dw;
-    if(dw)
-        dw = dw->next;
-
-    /* find the first delayedwork where the counters have been set and have moved */
-    while(dw) {
-        if(!dw->workerCounters) {
-            beforedw = dw;
-            dw = dw->next;
+    /* start at the second. the first is still filled by the main loop. */
+    struct DelayedJobs *prev = server->delayedJobs;
+    if(!prev)
+        return;
+    struct DelayedJobs *dj = prev->next;
+    while(dj) {
+        if(!dj->workerCounters) {
+            /* the job to record the counters could not be dispatched */
+            dj->workerCounters = snapshotCounters(server);
+            prev = dj;
+            dj = dj->next;
             continue;
         }
-        UA_Boolean allMoved = true;
-        for(size_t i = 0; i < server->config.nThreads; i++) {
-            if(dw->workerCounters[i] == server->workers[i].counter) {
-                allMoved = false;
-                break;
-            }
+        if(!delayedJobsReady(server, dj)) {
+            prev = dj;
+            dj = dj->next;
+            continue;
         }
-        if(allMoved)
-            break;
-        beforedw = dw;
-        dw = dw->next;
+        /* unlink and process. the main loop only changes the head of the
+           list. */
+        prev->next = dj->next;
+        processDelayedJobs(server, dj);
+        dj = prev->next;
     }
+}
 
-#if (__GNUC__ <= 4 && __GNUC_MINOR__ <= 6)
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wextra"
-#pragma GCC diagnostic ignored "-Wcast-qual"
-#pragma GCC diagnostic ignored "-Wunused-value"
-#endif
-    /* process and free all delayed jobs from here on */
-    while(dw) {
-        processJobs(server, dw->jobs, dw->jobsCount);
-        struct DelayedJobs *next = uatomic_xchg(&beforedw->next, NULL);
-        UA_free(dw);
-        UA_free(dw->workerCounters);
-        dw = next;
-    }
-#if (__GNUC__ <= 4 && __GNUC_MINOR__ <= 6)
-#pragma GCC diagnostic pop
-#endif
-
+/* Process all delayed jobs. Call only when the workers are stopped. */
+static void emptyDelayedJobs(UA_Server *server) {
+    struct DelayedJobs *dj = server->delayedJobs;
+    server->delayedJobs = NULL;
+    while(dj) {
+        struct DelayedJobs *next = dj->next;
+        processDelayedJobs(server, dj);
+        dj = next;
+    }
 }
 
 #endif
@@ -539,35 +1468,94 @@ dispatchDelayedJobs(UA_Server *server, void *_) {
 
 #ifdef UA_ENABLE_MULTITHREADING
 static void processMainLoopJobs(UA_Server *server) {
+    /* Take only the jobs that are in the ring now. Jobs that are added during
+       the processing wait for the next iteration. */
+    UA_UInt32 pending = uatomic_read(&server->mainLoopRingHead) - server->mainLoopRingTail;
+    UA_Job job;
+    for(UA_UInt32 i = 0; i < pending && ringPop(server, &job); i++)
+        processJobs(server, &job, 1);
+
     /* no synchronization required if we only use push and pop_all */
     struct cds_lfs_head *head = __cds_lfs_pop_all(&server->mainLoopJobs);
     if(!head)
         return;
-    struct MainLoopJob *mlw = (struct MainLoopJob*)&head->node;
+
+    /* Reverse the stack to process the overflow in fifo order */
+    struct cds_lfs_node *node = &head->node;
+    struct cds_lfs_node *reversed = NULL;
+    while(node) {
+        struct cds_lfs_node *next = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = next;
+    }
+
+    struct MainLoopJob *mlw = (struct MainLoopJob*)reversed;
     struct MainLoopJob *next;
     do {
         processJobs(server, &mlw->job, 1);
         next = (struct MainLoopJob*)mlw->node.next;
         UA_free(mlw);
     } while((mlw = next));
-    //UA_free(head);
 }
 #endif
 
+/* Milliseconds until the deadline. Rounded up so that we don't wake up just
+   before the next repeated job is due and spin. */
+static UA_UInt16 timeoutUntil(UA_DateTime deadline, UA_DateTime now) {
+    if(deadline <= now)
+        return 0;
+    return (UA_UInt16)((deadline - now + UA_MSEC_TO_DATETIME - 1) / UA_MSEC_TO_DATETIME);
+}
+
 UA_StatusCode UA_Server_run_startup(UA_Server *server) {
 #ifdef UA_ENABLE_MULTITHREADING
     /* Spin up the worker threads */
     UA_LOG_INFO(server->config.logger, UA_LOGCATEGORY_SERVER,
                 "Spinning up %u worker thread(s)", server->config.nThreads);
-    pthread_cond_init(&server->dispatchQueue_condition, 0);
+    if(initBatchPool(server) != UA_STATUSCODE_GOOD)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
     server->workers = UA_malloc(server->config.nThreads * sizeof(UA_Worker));
-    if(!server->workers)
+    if(!server->workers) {
+        deleteBatchPool(server);
         return UA_STATUSCODE_BADOUTOFMEMORY;
+    }
+    /* One open batch per worker (and one for jobs without affinity) and priority */
+    server->affineBatches = NULL;
+    if(server->config.connectionAffinity && server->config.nThreads > 0) {
+        server->affineBatches = UA_calloc((server->config.nThreads + 1u) * UA_JOBPRIORITYCOUNT,
+                                          sizeof(struct DispatchJobsList*));
+        if(!server->affineBatches) {
+            UA_free(server->workers);
+            deleteBatchPool(server);
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+    }
+    server->dispatchNext = 0;
+    server->idleWorkers = 0;
+    server->dispatchQueueSize = 0;
+    server->lastBatchSize = 0;
+    memset(server->jobCost, 0, sizeof(server->jobCost));
+    /* Initialize all workers before the first thread starts. Workers access the
+       queues of their peers for work stealing. */
     for(size_t i = 0; i < server->config.nThreads; i++) {
         UA_Worker *worker = &server->workers[i];
         worker->server = server;
         worker->counter = 0;
         worker->running = true;
+        worker->queued = 0;
+        worker->sleeping = 0;
+        worker->retired = NULL;
+#ifndef __linux__
+        pthread_mutex_init(&worker->wakeupMutex, 0);
+        pthread_cond_init(&worker->wakeupCondition, 0);
+#endif
+        for(size_t j = 0; j < UA_JOBPRIORITYCOUNT; j++)
+            cds_wfcq_init(&worker->lanes[j].head, &worker->lanes[j].tail);
+    }
+    placeMainLoop(server);
+    for(size_t i = 0; i < server->config.nThreads; i++) {
+        UA_Worker *worker = &server->workers[i];
         pthread_create(&worker->thr, NULL, (void* (*)(void*))workerLoop, worker);
     }
 
@@ -601,7 +1589,7 @@ UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
 
     UA_UInt16 timeout = 0;
     if(waitInternal)
-        timeout = (UA_UInt16)((nextRepeated - now) / UA_MSEC_TO_DATETIME);
+        timeout = timeoutUntil(nextRepeated, now);
 
     /* Get work from the networklayer */
     for(size_t i = 0; i < server->config.networkLayersSize; i++) {
@@ -615,18 +1603,27 @@ UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
             jobsSize = nl->getJobs(nl, &jobs, 0);
 
 #ifdef UA_ENABLE_MULTITHREADING
-        /* Filter out delayed work */
+        /* Filter out delayed work and select the lane for the messages. With
+           connection affinity, the messages keep the order of the connection
+           and are not sorted into lanes. */
         for(size_t k = 0; k < jobsSize; k++) {
+            jobs[k].priority = UA_JOBPRIORITY_NORMAL;
+            if(jobs[k].type == UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER ||
+               jobs[k].type == UA_JOBTYPE_BINARYMESSAGE_ALLOCATED) {
+                if(!server->affineBatches)
+                    jobs[k].priority =
+                        UA_Server_classifyBinaryMessage(server, jobs[k].job.binaryMessage.connection,
+                                                        &jobs[k].job.binaryMessage.message);
+                continue;
+            }
             if(jobs[k].type != UA_JOBTYPE_METHODCALL_DELAYED)
                 continue;
             addDelayedJob(server, &jobs[k]);
             jobs[k].type = UA_JOBTYPE_NOTHING;
         }
 
+        /* The workers are woken up for every dispatched batch */
         dispatchJobs(server, jobs, jobsSize);
-        /* Wake up worker threads */
-        if(jobsSize > 0)
-            pthread_cond_broadcast(&server->dispatchQueue_condition);
 #else
         processJobs(server, jobs, jobsSize);
         if(jobsSize > 0)
@@ -635,10 +1632,7 @@ UA_UInt16 UA_Server_run_iterate(UA_Server *server, UA_Boolean waitInternal) {
     }
 
     now = UA_DateTime_nowMonotonic();
-    timeout = 0;
-    if(nextRepeated > now)
-        timeout = (UA_UInt16)((nextRepeated - now) / UA_MSEC_TO_DATETIME);
-    return timeout;
+    return timeoutUntil(nextRepeated, now);
 }
 
 UA_StatusCode UA_Server_run_shutdown(UA_Server *server) {
@@ -656,14 +1650,32 @@ UA_StatusCode UA_Server_run_shutdown(UA_Server *server) {
     /* Wait for all worker threads to finish */
     for(size_t i = 0; i < server->config.nThreads; i++)
         server->workers[i].running = false;
-    pthread_cond_broadcast(&server->dispatchQueue_condition);
+    cmm_smp_mb();
+    for(size_t i = 0; i < server->config.nThreads; i++)
+        wakeWorker(server, &server->workers[i]);
     for(size_t i = 0; i < server->config.nThreads; i++)
         pthread_join(server->workers[i].thr, NULL);
+
+    /* Finish the work left in the per-worker queues */
+    for(size_t i = 0; i < server->config.nThreads; i++) {
+        UA_Worker *worker = &server->workers[i];
+        emptyQueue(server, worker->lanes);
+#ifndef __linux__
+        pthread_cond_destroy(&worker->wakeupCondition);
+        pthread_mutex_destroy(&worker->wakeupMutex);
+#endif
+    }
     UA_free(server->workers);
+    server->workers = NULL;
+    UA_free(server->affineBatches);
+    server->affineBatches = NULL;
 
     /* Manually finish the work still enqueued.
        This especially contains delayed frees */
     emptyDispatchQueue(server);
+    processMainLoopJobs(server);
+    emptyDelayedJobs(server);
+    deleteBatchPool(server);
     UA_ASSERT_RCU_UNLOCKED();
     rcu_barrier(); // wait for all scheduled call_rcu work to complete
 #endif
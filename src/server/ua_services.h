@@ -111,7 +111,9 @@ void Service_CloseSession(UA_Server *server, UA_Session *session,
  * @{
  */
 
-/** Used to add one or more Nodes into the AddressSpace hierarchy. */
+/** Used to add one or more Nodes into the AddressSpace hierarchy. The nodes are
+    inserted first. Then the references from the parents are added with one edit
+    per parent and the type definitions are instantiated. */
 void Service_AddNodes(UA_Server *server, UA_Session *session,
                       const UA_AddNodesRequest *request,
                       UA_AddNodesResponse *response);
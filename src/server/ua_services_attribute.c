@@ -9,6 +9,9 @@
 /* Read Attribute */
 /******************/
 
+#define UA_READ_BATCH 64 // nodes that are looked up together
+#define UA_READ_BATCH_MINSIZE 8 // smaller reads look up one node at a time
+
 static size_t
 readNumber(UA_Byte *buf, size_t buflen, UA_UInt32 *number) {
     UA_UInt32 n = 0;
@@ -131,11 +134,12 @@ static UA_StatusCode getVariableNodeValue(const UA_VariableNode *vn, const UA_Ti
         if(vn->value.variant.callback.onRead)
             vn->value.variant.callback.onRead(vn->value.variant.callback.handle, vn->nodeId,
                                               &v->value, rangeptr);
+        const UA_Variant *value = UA_VariableNode_getValue(vn);
         if(!rangeptr) {
-            v->value = vn->value.variant.value;
+            v->value = *value;
             v->value.storageType = UA_VARIANT_DATA_NODELETE;
         } else
-            retval = UA_Variant_copyRange(&vn->value.variant.value, &v->value, range);
+            retval = UA_Variant_copyRange(value, &v->value, range);
         if(retval == UA_STATUSCODE_GOOD)
             handleSourceTimestamps(timestamps, v);
     } else {
@@ -157,7 +161,7 @@ static UA_StatusCode getVariableNodeValue(const UA_VariableNode *vn, const UA_Ti
 static UA_StatusCode getVariableNodeDataType(const UA_VariableNode *vn, UA_DataValue *v) {
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     if(vn->valueSource == UA_VALUESOURCE_VARIANT) {
-        forceVariantSetScalar(&v->value, &vn->value.variant.value.type->typeId,
+        forceVariantSetScalar(&v->value, &UA_VariableNode_getValue(vn)->type->typeId,
                               &UA_TYPES[UA_TYPES_NODEID]);
     } else {
         if(vn->value.dataSource.read == NULL)
@@ -179,8 +183,9 @@ static UA_StatusCode getVariableNodeDataType(const UA_VariableNode *vn, UA_DataV
 static UA_StatusCode getVariableNodeArrayDimensions(const UA_VariableNode *vn, UA_DataValue *v) {
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
     if(vn->valueSource == UA_VALUESOURCE_VARIANT) {
-        UA_Variant_setArray(&v->value, vn->value.variant.value.arrayDimensions,
-                            vn->value.variant.value.arrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32]);
+        const UA_Variant *value = UA_VariableNode_getValue(vn);
+        UA_Variant_setArray(&v->value, value->arrayDimensions,
+                            value->arrayDimensionsSize, &UA_TYPES[UA_TYPES_INT32]);
         v->value.storageType = UA_VARIANT_DATA_NODELETE;
     } else {
         if(vn->value.dataSource.read == NULL)
@@ -202,9 +207,11 @@ static const UA_String binEncoding = {sizeof("DefaultBinary")-1, (UA_Byte*)"Defa
 /* clang complains about unused variables */
 // static const UA_String xmlEncoding = {sizeof("DefaultXml")-1, (UA_Byte*)"DefaultXml"};
 
-/** Reads a single attribute from a node in the nodestore. */
-void Service_Read_single(UA_Server *server, UA_Session *session, const UA_TimestampsToReturn timestamps,
-                         const UA_ReadValueId *id, UA_DataValue *v) {
+/* Reads a single attribute from a node that was looked up by the caller (or
+   NULL if the nodeid is unknown) */
+static void
+readNode(UA_Server *server, UA_Session *session, const UA_TimestampsToReturn timestamps,
+         const UA_ReadValueId *id, const UA_Node *node, UA_DataValue *v) {
 	if(id->dataEncoding.name.length > 0 && !UA_String_equal(&binEncoding, &id->dataEncoding.name)) {
            v->hasStatus = true;
            v->status = UA_STATUSCODE_BADDATAENCODINGINVALID;
@@ -218,7 +225,6 @@ void Service_Read_single(UA_Server *server, UA_Session *session, const UA_Timest
 		return;
 	}
 
-    UA_Node const *node = UA_NodeStore_get(server->nodestore, &id->nodeId);
     if(!node) {
         v->hasStatus = true;
         v->status = UA_STATUSCODE_BADNODEIDUNKNOWN;
@@ -338,6 +344,38 @@ void Service_Read_single(UA_Server *server, UA_Session *session, const UA_Timest
     handleServerTimestamps(timestamps, v);
 }
 
+/** Reads a single attribute from a node in the nodestore. */
+void Service_Read_single(UA_Server *server, UA_Session *session, const UA_TimestampsToReturn timestamps,
+                         const UA_ReadValueId *id, UA_DataValue *v) {
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, &id->nodeId);
+    readNode(server, session, timestamps, id, node, v);
+}
+
+/* Reads with many nodes look up the nodes of a chunk together. The node
+   pointers stay valid while the chunk is read, as the nodes are not replaced
+   during the service (the results point into the nodes as well). */
+static void
+readBatch(UA_Server *server, UA_Session *session, const UA_ReadRequest *request,
+          UA_ReadResponse *response, const UA_Boolean *isExternal) {
+    UA_NodeId ids[UA_READ_BATCH];
+    const UA_Node *nodes[UA_READ_BATCH];
+    size_t size = request->nodesToReadSize;
+    for(size_t start = 0; start < size; start += UA_READ_BATCH) {
+        size_t chunk = size - start;
+        if(chunk > UA_READ_BATCH)
+            chunk = UA_READ_BATCH;
+        for(size_t i = 0; i < chunk; i++)
+            ids[i] = request->nodesToRead[start + i].nodeId; // shallow copy
+        UA_NodeStore_getBatch(server->nodestore, ids, chunk, nodes);
+        for(size_t i = 0; i < chunk; i++) {
+            if(isExternal && isExternal[start + i])
+                continue;
+            readNode(server, session, request->timestampsToReturn,
+                     &request->nodesToRead[start + i], nodes[i], &response->results[start + i]);
+        }
+    }
+}
+
 void Service_Read(UA_Server *server, UA_Session *session, const UA_ReadRequest *request,
                   UA_ReadResponse *response) {
     UA_LOG_DEBUG(server->config.logger, UA_LOGCATEGORY_SESSION,
@@ -387,12 +425,20 @@ void Service_Read(UA_Server *server, UA_Session *session, const UA_ReadRequest *
     }
 #endif
 
-    for(size_t i = 0;i < size;i++) {
+    if(size >= UA_READ_BATCH_MINSIZE) {
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
+        readBatch(server, session, request, response, isExternal);
+#else
+        readBatch(server, session, request, response, NULL);
+#endif
+    } else {
+        for(size_t i = 0;i < size;i++) {
+#ifdef UA_ENABLE_EXTERNAL_NAMESPACES
+            if(!isExternal[i])
 #endif
-            Service_Read_single(server, session, request->timestampsToReturn,
-                                &request->nodesToRead[i], &response->results[i]);
+                Service_Read_single(server, session, request->timestampsToReturn,
+                                    &request->nodesToRead[i], &response->results[i]);
+        }
     }
 
 #ifdef UA_ENABLE_NONSTANDARD_STATELESS
@@ -439,10 +485,10 @@ UA_StatusCode UA_Server_editNode(UA_Server *server, UA_Session *session, const U
     UA_StatusCode retval;
     do {
 #ifndef UA_ENABLE_MULTITHREADING
-        const UA_Node *node = UA_NodeStore_get(server->nodestore, nodeId);
-        if(!node)
-            return UA_STATUSCODE_BADNODEIDUNKNOWN;
-        UA_Node *editNode = (UA_Node*)(uintptr_t)node; // dirty cast. use only here.
+        UA_Node *editNode;
+        retval = UA_NodeStore_getEditable(server->nodestore, nodeId, &editNode);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
         retval = callback(server, session, editNode, data);
         return retval;
 #else
@@ -451,7 +497,7 @@ UA_StatusCode UA_Server_editNode(UA_Server *server, UA_Session *session, const U
             return UA_STATUSCODE_BADOUTOFMEMORY;
         retval = callback(server, session, copy, data);
         if(retval != UA_STATUSCODE_GOOD) {
-            UA_NodeStore_deleteNode(copy);
+            UA_NodeStore_deleteNode(server->nodestore, copy);
             return retval;
         }
         retval = UA_NodeStore_replace(server->nodestore, copy);
@@ -516,12 +562,96 @@ static enum type_equivalence typeEquivalence(const UA_DataType *t) {
     return TYPE_EQUIVALENCE_NONE;
 }
 
+/* The nodeid on the wire may be != the nodeid in the node: opaque types, enums
+ * and bytestrings. The old value contains the correct type definition. cast_v
+ * is set to the (cast) new value without copying the content. */
+static UA_StatusCode
+castWrittenValue(const UA_Variant *oldV, const UA_Variant *newV, UA_Variant *cast_v) {
+    *cast_v = *newV;
+    if(oldV->type == NULL) // Don't run NodeId_equal on a NULL pointer (happens if the variable never held a variant)
+        return UA_STATUSCODE_GOOD;
+    if(UA_NodeId_equal(&oldV->type->typeId, &newV->type->typeId))
+        return UA_STATUSCODE_GOOD;
+    enum type_equivalence te1 = typeEquivalence(oldV->type);
+    enum type_equivalence te2 = typeEquivalence(newV->type);
+    if(te1 != TYPE_EQUIVALENCE_NONE && te1 == te2) {
+        /* An enum was sent as an int32, or an opaque type as a bytestring. This is
+           detected with the typeIndex indicated the "true" datatype. */
+        cast_v->type = oldV->type;
+    } else if(oldV->type == &UA_TYPES[UA_TYPES_BYTE] && !UA_Variant_isScalar(oldV) &&
+              newV->type == &UA_TYPES[UA_TYPES_BYTESTRING] && UA_Variant_isScalar(newV)) {
+        /* a string is written to a byte array */
+        UA_ByteString *str = (UA_ByteString*) newV->data;
+        cast_v->arrayLength = str->length;
+        cast_v->data = str->data;
+        cast_v->type = &UA_TYPES[UA_TYPES_BYTE];
+    } else {
+        return UA_STATUSCODE_BADTYPEMISMATCH;
+    }
+    return UA_STATUSCODE_GOOD;
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+
+typedef struct {
+    const UA_Variant *value;
+    const UA_NumericRange *range;
+} ValueUpdate;
+
+static UA_StatusCode
+updateValue(const UA_Variant *oldV, UA_Variant *newV, const ValueUpdate *update) {
+    UA_Variant cast_v;
+    UA_StatusCode retval = castWrittenValue(oldV, update->value, &cast_v);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    if(!update->range)
+        return UA_Variant_copy(&cast_v, newV);
+    retval = UA_Variant_copy(oldV, newV);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    return UA_Variant_setRangeCopy(newV, cast_v.data, cast_v.arrayLength, *update->range);
+}
+
+/* Writes into the value slot. The node itself is not copied and replaced. */
+static UA_StatusCode
+WriteValueSlot(const UA_VariableNode *node, const UA_WriteValue *wvalue) {
+    UA_NumericRange range;
+    UA_NumericRange *rangeptr = NULL;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    if(wvalue->indexRange.length > 0) {
+        retval = parse_numericrange(&wvalue->indexRange, &range);
+        if(retval != UA_STATUSCODE_GOOD)
+            return retval;
+        rangeptr = &range;
+    }
+
+    ValueUpdate update = {&wvalue->value.value, rangeptr};
+    retval = UA_VariableNode_updateValue(node, (UA_VariableNodeValueUpdate)updateValue, &update);
+    if(retval == UA_STATUSCODE_GOOD && node->value.variant.callback.onWrite)
+        node->value.variant.callback.onWrite(node->value.variant.callback.handle, node->nodeId,
+                                             UA_VariableNode_getValue(node), rangeptr);
+    if(rangeptr)
+        UA_free(range.dimensions);
+    return retval;
+}
+
+#endif
+
 static UA_StatusCode
 CopyValueIntoNode(UA_VariableNode *node, const UA_WriteValue *wvalue) {
     UA_assert(wvalue->attributeId == UA_ATTRIBUTEID_VALUE);
     UA_assert(node->nodeClass == UA_NODECLASS_VARIABLE || node->nodeClass == UA_NODECLASS_VARIABLETYPE);
     UA_assert(node->valueSource == UA_VALUESOURCE_VARIANT);
 
+#ifdef UA_ENABLE_MULTITHREADING
+    /* The copy shares the value slot with the node in the nodestore. Writing
+       into the slot publishes the value right away, also if the replacement of
+       the node fails and the edit is retried. So the edit is aborted and the
+       value is written into the slot without editing the node. */
+    if(node->nodeClass == UA_NODECLASS_VARIABLE && node->valueSlot)
+        return UA_STATUSCODE_GOODCALLAGAIN;
+#endif
+
     /* Parse the range */
     UA_NumericRange range;
     UA_NumericRange *rangeptr = NULL;
@@ -533,44 +663,27 @@ CopyValueIntoNode(UA_VariableNode *node, const UA_WriteValue *wvalue) {
         rangeptr = &range;
     }
 
-    /* The nodeid on the wire may be != the nodeid in the node: opaque types, enums and bytestrings.
-       nodeV contains the correct type definition. */
-    const UA_Variant *newV = &wvalue->value.value;
-    UA_Variant *oldV = &node->value.variant.value;
     UA_Variant cast_v;
-    if (oldV->type != NULL) { // Don't run NodeId_equal on a NULL pointer (happens if the variable never held a variant)
-      if(!UA_NodeId_equal(&oldV->type->typeId, &newV->type->typeId)) {
-          cast_v = wvalue->value.value;
-          newV = &cast_v;
-          enum type_equivalence te1 = typeEquivalence(oldV->type);
-          enum type_equivalence te2 = typeEquivalence(newV->type);
-          if(te1 != TYPE_EQUIVALENCE_NONE && te1 == te2) {
-              /* An enum was sent as an int32, or an opaque type as a bytestring. This is
-                detected with the typeIndex indicated the "true" datatype. */
-              cast_v.type = oldV->type;
-          } else if(oldV->type == &UA_TYPES[UA_TYPES_BYTE] && !UA_Variant_isScalar(oldV) &&
-                    newV->type == &UA_TYPES[UA_TYPES_BYTESTRING] && UA_Variant_isScalar(newV)) {
-              /* a string is written to a byte array */
-              UA_ByteString *str = (UA_ByteString*) newV->data;
-              cast_v.arrayLength = str->length;
-              cast_v.data = str->data;
-              cast_v.type = &UA_TYPES[UA_TYPES_BYTE];
-          } else {
-              if(rangeptr)
-                  UA_free(range.dimensions);
-              return UA_STATUSCODE_BADTYPEMISMATCH;
-          }
-      }
+    retval = castWrittenValue(&node->value.variant.value, &wvalue->value.value, &cast_v);
+    if(retval != UA_STATUSCODE_GOOD) {
+        if(rangeptr)
+            UA_free(range.dimensions);
+        return retval;
     }
-    
+
     if(!rangeptr) {
         UA_Variant_deleteMembers(&node->value.variant.value);
-        UA_Variant_copy(newV, &node->value.variant.value);
+        retval = UA_Variant_copy(&cast_v, &node->value.variant.value);
     } else
-        retval = UA_Variant_setRangeCopy(&node->value.variant.value, newV->data, newV->arrayLength, range);
+        retval = UA_Variant_setRangeCopy(&node->value.variant.value, cast_v.data, cast_v.arrayLength, range);
+#ifdef UA_ENABLE_MULTITHREADING
+    /* Subsequent writes go to the value slot */
+    if(retval == UA_STATUSCODE_GOOD && node->nodeClass == UA_NODECLASS_VARIABLE)
+        retval = UA_VariableNode_initValueSlot(node);
+#endif
     if(node->value.variant.callback.onWrite)
         node->value.variant.callback.onWrite(node->value.variant.callback.handle, node->nodeId,
-                                             &node->value.variant.value, rangeptr);
+                                             UA_VariableNode_getValue(node), rangeptr);
     if(rangeptr)
         UA_free(range.dimensions);
     return retval;
@@ -692,7 +805,30 @@ CopyAttributeIntoNode(UA_Server *server, UA_Session *session,
 }
 
 UA_StatusCode Service_Write_single(UA_Server *server, UA_Session *session, const UA_WriteValue *wvalue) {
+#ifdef UA_ENABLE_MULTITHREADING
+    UA_StatusCode retval;
+    do {
+        /* Values that are already in a value slot are written without copying
+           the node */
+        if(wvalue->attributeId == UA_ATTRIBUTEID_VALUE) {
+            const UA_VariableNode *node =
+                (const UA_VariableNode*)UA_NodeStore_get(server->nodestore, &wvalue->nodeId);
+            if(node && node->nodeClass == UA_NODECLASS_VARIABLE &&
+               node->valueSource == UA_VALUESOURCE_VARIANT && node->valueSlot) {
+                if(!wvalue->value.hasValue)
+                    return UA_STATUSCODE_BADNODATA;
+                return WriteValueSlot(node, wvalue);
+            }
+        }
+        /* The value slot was created concurrently. Then the edit is aborted
+           with GoodCallAgain and the value is written into the slot. */
+        retval = UA_Server_editNode(server, session, &wvalue->nodeId,
+                                    (UA_EditNodeCallback)CopyAttributeIntoNode, wvalue);
+    } while(retval == UA_STATUSCODE_GOODCALLAGAIN);
+    return retval;
+#else
     return UA_Server_editNode(server, session, &wvalue->nodeId, (UA_EditNodeCallback)CopyAttributeIntoNode, wvalue);
+#endif
 }
 
 void Service_Write(UA_Server *server, UA_Session *session, const UA_WriteRequest *request,
@@ -86,13 +86,14 @@ satisfySignature(const UA_Variant *var, const UA_Argument *arg) {
 
 static UA_StatusCode
 argConformsToDefinition(const UA_VariableNode *argRequirements, size_t argsSize, const UA_Variant *args) {
-    if(argRequirements->value.variant.value.type != &UA_TYPES[UA_TYPES_ARGUMENT])
-        return UA_STATUSCODE_BADINTERNALERROR;
-    UA_Argument *argReqs = (UA_Argument*)argRequirements->value.variant.value.data;
-    size_t argReqsSize = argRequirements->value.variant.value.arrayLength;
     if(argRequirements->valueSource != UA_VALUESOURCE_VARIANT)
         return UA_STATUSCODE_BADINTERNALERROR;
-    if(UA_Variant_isScalar(&argRequirements->value.variant.value))
+    const UA_Variant *argValue = UA_VariableNode_getValue(argRequirements);
+    if(argValue->type != &UA_TYPES[UA_TYPES_ARGUMENT])
+        return UA_STATUSCODE_BADINTERNALERROR;
+    UA_Argument *argReqs = (UA_Argument*)argValue->data;
+    size_t argReqsSize = argValue->arrayLength;
+    if(UA_Variant_isScalar(argValue))
         argReqsSize = 1;
     if(argReqsSize > argsSize)
         return UA_STATUSCODE_BADARGUMENTSMISSING;
@@ -177,9 +178,9 @@ Service_Call_single(UA_Server *server, UA_Session *session, const UA_CallMethodR
     
     /* Call method if available */
     if(methodCalled->attachedMethod) {
-        result->outputArguments = UA_Array_new(outputArguments->value.variant.value.arrayLength,
-                                               &UA_TYPES[UA_TYPES_VARIANT]);
-        result->outputArgumentsSize = outputArguments->value.variant.value.arrayLength;
+        size_t outputArgumentsSize = UA_VariableNode_getValue(outputArguments)->arrayLength;
+        result->outputArguments = UA_Array_new(outputArgumentsSize, &UA_TYPES[UA_TYPES_VARIANT]);
+        result->outputArgumentsSize = outputArgumentsSize;
         result->statusCode = methodCalled->attachedMethod(methodCalled->methodHandle, withObject->nodeId,
                                                           request->inputArgumentsSize, request->inputArguments,
                                                           result->outputArgumentsSize, result->outputArguments);
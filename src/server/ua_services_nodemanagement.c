@@ -10,50 +10,54 @@
 /* Add Node */
 /************/
 
+/* Check the parent and the reference type under which a node is added */
+static UA_StatusCode
+checkParentReference(UA_Server *server, const UA_NodeId *parentNodeId,
+                     const UA_NodeId *referenceTypeId) {
+    const UA_Node *parent = UA_NodeStore_get(server->nodestore, parentNodeId);
+    if(!parent)
+        return UA_STATUSCODE_BADPARENTNODEIDINVALID;
+
+    const UA_ReferenceTypeNode *referenceType =
+        (const UA_ReferenceTypeNode *)UA_NodeStore_get(server->nodestore, referenceTypeId);
+    if(!referenceType)
+        return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
+
+    if(referenceType->nodeClass != UA_NODECLASS_REFERENCETYPE)
+        return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
+
+    if(referenceType->isAbstract == true)
+        return UA_STATUSCODE_BADREFERENCENOTALLOWED;
+
+    // todo: test if the referencetype is hierarchical
+    return UA_STATUSCODE_GOOD;
+}
+
 void
 UA_Server_addExistingNode(UA_Server *server, UA_Session *session, UA_Node *node,
                           const UA_NodeId *parentNodeId, const UA_NodeId *referenceTypeId,
                           UA_AddNodesResult *result) {
     if(node->nodeId.namespaceIndex >= server->namespacesSize) {
         result->statusCode = UA_STATUSCODE_BADNODEIDINVALID;
-        UA_NodeStore_deleteNode(node);
-        return;
-    }
-
-    const UA_Node *parent = UA_NodeStore_get(server->nodestore, parentNodeId);
-    if(!parent) {
-        result->statusCode = UA_STATUSCODE_BADPARENTNODEIDINVALID;
-        UA_NodeStore_deleteNode(node);
-        return;
-    }
-
-    const UA_ReferenceTypeNode *referenceType =
-        (const UA_ReferenceTypeNode *)UA_NodeStore_get(server->nodestore, referenceTypeId);
-    if(!referenceType) {
-        result->statusCode = UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
-        UA_NodeStore_deleteNode(node);
+        UA_NodeStore_deleteNode(server->nodestore, node);
         return;
     }
 
-    if(referenceType->nodeClass != UA_NODECLASS_REFERENCETYPE) {
-        result->statusCode = UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
-        UA_NodeStore_deleteNode(node);
+    result->statusCode = checkParentReference(server, parentNodeId, referenceTypeId);
+    if(result->statusCode != UA_STATUSCODE_GOOD) {
+        UA_NodeStore_deleteNode(server->nodestore, node);
         return;
     }
 
-    if(referenceType->isAbstract == true) {
-        result->statusCode = UA_STATUSCODE_BADREFERENCENOTALLOWED;
-        UA_NodeStore_deleteNode(node);
-        return;
-    }
-
-    // todo: test if the referencetype is hierarchical
     // todo: namespace index is assumed to be valid
+    UA_Boolean isReferenceType = (node->nodeClass == UA_NODECLASS_REFERENCETYPE);
     result->statusCode = UA_NodeStore_insert(server->nodestore, node);
     if(result->statusCode == UA_STATUSCODE_GOOD)
         result->statusCode = UA_NodeId_copy(&node->nodeId, &result->addedNodeId);
     else
         return;
+    if(isReferenceType)
+        UA_Server_invalidateReferenceTypes(server);
     
     // reference back to the parent
     UA_AddReferencesItem item;
@@ -69,11 +73,78 @@ UA_Server_addExistingNode(UA_Server *server, UA_Session *session, UA_Node *node,
 static UA_StatusCode
 instantiateVariableNode(UA_Server *server, UA_Session *session,
                         const UA_NodeId *nodeId, const UA_NodeId *typeId, 
+                        UA_Boolean addTypeDefinition,
                         UA_InstantiationCallback *instantiationCallback);
 static UA_StatusCode
 instantiateObjectNode(UA_Server *server, UA_Session *session,
                       const UA_NodeId *nodeId, const UA_NodeId *typeId, 
+                      UA_Boolean addTypeDefinition,
                       UA_InstantiationCallback *instantiationCallback);
+static UA_StatusCode
+addOneWayReference(UA_Server *server, UA_Session *session, UA_Node *node,
+                   const UA_AddReferencesItem *item);
+static UA_Boolean isHasSubtype(const UA_NodeId *referenceTypeId);
+
+static UA_Boolean isHasTypeDefinition(const UA_ReferenceNode *rn) {
+    return !rn->isInverse && rn->referenceTypeId.namespaceIndex == 0 &&
+        rn->referenceTypeId.identifierType == UA_NODEIDTYPE_NUMERIC &&
+        rn->referenceTypeId.identifier.numeric == UA_NS0ID_HASTYPEDEFINITION;
+}
+
+/* The references of an instance are set before it is inserted: to the parent
+   and to the type definitions of the prototype. So the instance is not edited
+   (and copied) when the references are added. */
+static UA_StatusCode
+setInstanceReferences(UA_Node *node, const UA_Node *prototype,
+                      const UA_NodeId *referenceType, const UA_NodeId *parent) {
+    size_t size = 1;
+    for(size_t i = 0; i < prototype->referencesSize; i++) {
+        if(isHasTypeDefinition(&prototype->references[i]))
+            size++;
+    }
+    node->references = UA_Array_new(size, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+    if(!node->references)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    node->referencesSize = size;
+    UA_StatusCode retval = UA_NodeId_copy(referenceType, &node->references[0].referenceTypeId);
+    retval |= UA_NodeId_copy(parent, &node->references[0].targetId.nodeId);
+    node->references[0].isInverse = true;
+    for(size_t i = 0, j = 1; i < prototype->referencesSize; i++) {
+        if(isHasTypeDefinition(&prototype->references[i]))
+            retval |= UA_ReferenceNode_copy(&prototype->references[i], &node->references[j++]);
+    }
+    return retval;
+}
+
+/* Insert an instance whose references are already set. Then add the
+   references back to the instance to the targets. */
+static void
+addInstanceNode(UA_Server *server, UA_Session *session, UA_Node *node,
+                const UA_NodeId *parentNodeId, const UA_NodeId *referenceTypeId,
+                UA_AddNodesResult *result) {
+    result->statusCode = checkParentReference(server, parentNodeId, referenceTypeId);
+    if(result->statusCode != UA_STATUSCODE_GOOD) {
+        UA_NodeStore_deleteNode(server->nodestore, node);
+        return;
+    }
+    result->statusCode = UA_NodeStore_insert(server->nodestore, node);
+    if(result->statusCode == UA_STATUSCODE_GOOD)
+        result->statusCode = UA_NodeId_copy(&node->nodeId, &result->addedNodeId);
+    if(result->statusCode != UA_STATUSCODE_GOOD)
+        return;
+
+    for(size_t i = 0; i < node->referencesSize; i++) {
+        const UA_ReferenceNode *rn = &node->references[i];
+        UA_AddReferencesItem item;
+        UA_AddReferencesItem_init(&item);
+        item.sourceNodeId = rn->targetId.nodeId;
+        item.referenceTypeId = rn->referenceTypeId;
+        item.isForward = rn->isInverse;
+        item.targetNodeId.nodeId = result->addedNodeId;
+        UA_Server_editNode(server, session, &item.sourceNodeId,
+                           (UA_EditNodeCallback)addOneWayReference, &item);
+    }
+}
 
 /* copy an existing variable under the given parent. then instantiate the
    variable for all hastypedefinitions of the original version. */
@@ -87,50 +158,42 @@ copyExistingVariable(UA_Server *server, UA_Session *session, const UA_NodeId *va
     if(node->nodeClass != UA_NODECLASS_VARIABLE)
         return UA_STATUSCODE_BADNODECLASSINVALID;
     
-    // copy the variable attributes
-    UA_VariableAttributes attr;
-    UA_VariableAttributes_init(&attr);
-    UA_LocalizedText_copy(&node->displayName, &attr.displayName);
-    UA_LocalizedText_copy(&node->description, &attr.description);
-    attr.writeMask = node->writeMask;
-    attr.userWriteMask = node->userWriteMask;
+    // the browsename, displayname and description are shared with the original
+    UA_VariableNode *copy =
+        (UA_VariableNode*)UA_NodeStore_newInstance(server->nodestore, (const UA_Node*)node);
+    if(!copy)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    copy->writeMask = node->writeMask;
+    copy->userWriteMask = node->userWriteMask;
     // todo: handle data sources!!!!
-    UA_Variant_copy(&node->value.variant.value, &attr.value);
+    UA_StatusCode retval = UA_Variant_copy(UA_VariableNode_getValue(node), &copy->value.variant.value);
     // datatype is taken from the value
     // valuerank is taken from the value
     // array dimensions are taken from the value
-    attr.accessLevel = node->accessLevel;
-    attr.userAccessLevel = node->userAccessLevel;
-    attr.minimumSamplingInterval = node->minimumSamplingInterval;
-    attr.historizing = node->historizing;
-
-    UA_AddNodesItem item;
-    UA_AddNodesItem_init(&item);
-    UA_NodeId_copy(parent, &item.parentNodeId.nodeId);
-    UA_NodeId_copy(referenceType, &item.referenceTypeId);
-    UA_QualifiedName_copy(&node->browseName, &item.browseName);
-    item.nodeClass = UA_NODECLASS_VARIABLE;
-    item.nodeAttributes.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
-    item.nodeAttributes.content.decoded.type = &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES];
-    item.nodeAttributes.content.decoded.data = &attr;
-    // don't add a typedefinition here.
+    copy->accessLevel = node->accessLevel;
+    copy->userAccessLevel = node->userAccessLevel;
+    copy->minimumSamplingInterval = node->minimumSamplingInterval;
+    copy->historizing = node->historizing;
+    retval |= setInstanceReferences((UA_Node*)copy, (const UA_Node*)node, referenceType, parent);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)copy);
+        return retval;
+    }
 
     // add the new variable
     UA_AddNodesResult res;
     UA_AddNodesResult_init(&res);
-    Service_AddNodes_single(server, session, &item, &res, instantiationCallback);
-    UA_VariableAttributes_deleteMembers(&attr);
-    UA_AddNodesItem_deleteMembers(&item);
+    addInstanceNode(server, session, (UA_Node*)copy, parent, referenceType, &res);
+    if(res.statusCode != UA_STATUSCODE_GOOD)
+        return res.statusCode;
 
     // now instantiate the variable for all hastypedefinition references
     for(size_t i = 0; i < node->referencesSize; i++) {
         UA_ReferenceNode *rn = &node->references[i];
-        if(rn->isInverse)
-            continue;
-        const UA_NodeId hasTypeDef = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
-        if(!UA_NodeId_equal(&rn->referenceTypeId, &hasTypeDef))
+        if(!isHasTypeDefinition(rn))
             continue;
-        instantiateVariableNode(server, session, &res.addedNodeId, &rn->targetId.nodeId, instantiationCallback);
+        instantiateVariableNode(server, session, &res.addedNodeId, &rn->targetId.nodeId,
+                                false, instantiationCallback);
     }
     
     if (instantiationCallback != NULL)
@@ -152,42 +215,35 @@ copyExistingObject(UA_Server *server, UA_Session *session, const UA_NodeId *vari
     if(node->nodeClass != UA_NODECLASS_OBJECT)
         return UA_STATUSCODE_BADNODECLASSINVALID;
     
-    // copy the variable attributes
-    UA_ObjectAttributes attr;
-    UA_ObjectAttributes_init(&attr);
-    UA_LocalizedText_copy(&node->displayName, &attr.displayName);
-    UA_LocalizedText_copy(&node->description, &attr.description);
-    attr.writeMask = node->writeMask;
-    attr.userWriteMask = node->userWriteMask;
-    attr.eventNotifier = node->eventNotifier;
-
-    UA_AddNodesItem item;
-    UA_AddNodesItem_init(&item);
-    UA_NodeId_copy(parent, &item.parentNodeId.nodeId);
-    UA_NodeId_copy(referenceType, &item.referenceTypeId);
-    UA_QualifiedName_copy(&node->browseName, &item.browseName);
-    item.nodeClass = UA_NODECLASS_OBJECT;
-    item.nodeAttributes.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
-    item.nodeAttributes.content.decoded.type = &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES];
-    item.nodeAttributes.content.decoded.data = &attr;
-    // don't add a typedefinition here.
+    // the browsename, displayname and description are shared with the original
+    UA_ObjectNode *copy =
+        (UA_ObjectNode*)UA_NodeStore_newInstance(server->nodestore, (const UA_Node*)node);
+    if(!copy)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    copy->writeMask = node->writeMask;
+    copy->userWriteMask = node->userWriteMask;
+    copy->eventNotifier = node->eventNotifier;
+    UA_StatusCode retval =
+        setInstanceReferences((UA_Node*)copy, (const UA_Node*)node, referenceType, parent);
+    if(retval != UA_STATUSCODE_GOOD) {
+        UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)copy);
+        return retval;
+    }
 
     // add the new object
     UA_AddNodesResult res;
     UA_AddNodesResult_init(&res);
-    Service_AddNodes_single(server, session, &item, &res, instantiationCallback);
-    UA_ObjectAttributes_deleteMembers(&attr);
-    UA_AddNodesItem_deleteMembers(&item);
+    addInstanceNode(server, session, (UA_Node*)copy, parent, referenceType, &res);
+    if(res.statusCode != UA_STATUSCODE_GOOD)
+        return res.statusCode;
 
     // now instantiate the object for all hastypedefinition references
     for(size_t i = 0; i < node->referencesSize; i++) {
         UA_ReferenceNode *rn = &node->references[i];
-        if(rn->isInverse)
+        if(!isHasTypeDefinition(rn))
             continue;
-        const UA_NodeId hasTypeDef = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
-        if(!UA_NodeId_equal(&rn->referenceTypeId, &hasTypeDef))
-            continue;
-        instantiateObjectNode(server, session, &res.addedNodeId, &rn->targetId.nodeId, instantiationCallback);
+        instantiateObjectNode(server, session, &res.addedNodeId, &rn->targetId.nodeId,
+                              false, instantiationCallback);
     }
     
     if (instantiationCallback != NULL)
@@ -208,6 +264,7 @@ setObjectInstanceHandle(UA_Server *server, UA_Session *session, UA_ObjectNode* n
 static UA_StatusCode
 instantiateObjectNode(UA_Server *server, UA_Session *session,
                       const UA_NodeId *nodeId, const UA_NodeId *typeId, 
+                      UA_Boolean addTypeDefinition,
                       UA_InstantiationCallback *instantiationCallback) {   
     const UA_ObjectTypeNode *typenode = (const UA_ObjectTypeNode*)UA_NodeStore_get(server->nodestore, typeId);
     if(!typenode)
@@ -247,16 +304,19 @@ instantiateObjectNode(UA_Server *server, UA_Session *session,
         else if(rd->nodeClass == UA_NODECLASS_OBJECT)
           copyExistingObject(server, session, &rd->nodeId.nodeId, &rd->referenceTypeId, nodeId, instantiationCallback);
     }
-
-    /* add a hastypedefinition reference */
-    UA_AddReferencesItem addref;
-    UA_AddReferencesItem_init(&addref);
-    addref.sourceNodeId = *nodeId;
-    addref.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
-    addref.isForward = true;
-    addref.targetNodeId.nodeId = *typeId;
-    addref.targetNodeClass = UA_NODECLASS_OBJECTTYPE;
-    Service_AddReferences_single(server, session, &addref);
+    UA_BrowseResult_deleteMembers(&browseResult);
+
+    /* add a hastypedefinition reference (unless the copied instance has it) */
+    if(addTypeDefinition) {
+        UA_AddReferencesItem addref;
+        UA_AddReferencesItem_init(&addref);
+        addref.sourceNodeId = *nodeId;
+        addref.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+        addref.isForward = true;
+        addref.targetNodeId.nodeId = *typeId;
+        addref.targetNodeClass = UA_NODECLASS_OBJECTTYPE;
+        Service_AddReferences_single(server, session, &addref);
+    }
 
     /* call the constructor */
     const UA_ObjectLifecycleManagement *olm = &typenode->lifecycleManagement;
@@ -268,7 +328,8 @@ instantiateObjectNode(UA_Server *server, UA_Session *session,
 
 static UA_StatusCode
 instantiateVariableNode(UA_Server *server, UA_Session *session, const UA_NodeId *nodeId,
-    const UA_NodeId *typeId, UA_InstantiationCallback *instantiationCallback) {
+    const UA_NodeId *typeId, UA_Boolean addTypeDefinition,
+    UA_InstantiationCallback *instantiationCallback) {
     const UA_ObjectTypeNode *typenode = (const UA_ObjectTypeNode*)UA_NodeStore_get(server->nodestore, typeId);
     if(!typenode)
         return UA_STATUSCODE_BADNODEIDINVALID;
@@ -295,16 +356,19 @@ instantiateVariableNode(UA_Server *server, UA_Session *session, const UA_NodeId
         UA_ReferenceDescription *rd = &browseResult.references[i];
         copyExistingVariable(server, session, &rd->nodeId.nodeId, &rd->referenceTypeId, nodeId, instantiationCallback);
     }
-
-    /* add a hastypedefinition reference */
-    UA_AddReferencesItem addref;
-    UA_AddReferencesItem_init(&addref);
-    addref.sourceNodeId = *nodeId;
-    addref.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
-    addref.isForward = true;
-    addref.targetNodeId.nodeId = *typeId;
-    addref.targetNodeClass = UA_NODECLASS_OBJECTTYPE;
-    Service_AddReferences_single(server, session, &addref);
+    UA_BrowseResult_deleteMembers(&browseResult);
+
+    /* add a hastypedefinition reference (unless the copied instance has it) */
+    if(addTypeDefinition) {
+        UA_AddReferencesItem addref;
+        UA_AddReferencesItem_init(&addref);
+        addref.sourceNodeId = *nodeId;
+        addref.referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+        addref.isForward = true;
+        addref.targetNodeId.nodeId = *typeId;
+        addref.targetNodeClass = UA_NODECLASS_OBJECTTYPE;
+        Service_AddReferences_single(server, session, &addref);
+    }
 
     return UA_STATUSCODE_GOOD;
 }
@@ -322,8 +386,8 @@ copyStandardAttributes(UA_Node *node, const UA_AddNodesItem *item, const UA_Node
 }
 
 static UA_Node *
-variableNodeFromAttributes(const UA_AddNodesItem *item, const UA_VariableAttributes *attr) {
-    UA_VariableNode *vnode = UA_NodeStore_newVariableNode();
+variableNodeFromAttributes(UA_NodeStore *ns, const UA_AddNodesItem *item, const UA_VariableAttributes *attr) {
+    UA_VariableNode *vnode = UA_NodeStore_newVariableNode(ns);
     if(!vnode)
         return NULL;
     UA_StatusCode retval = copyStandardAttributes((UA_Node*)vnode, item, (const UA_NodeAttributes*)attr);
@@ -335,29 +399,29 @@ variableNodeFromAttributes(const UA_AddNodesItem *item, const UA_VariableAttribu
     vnode->valueRank = attr->valueRank;
     retval |= UA_Variant_copy(&attr->value, &vnode->value.variant.value);
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeStore_deleteNode((UA_Node*)vnode);
+        UA_NodeStore_deleteNode(ns, (UA_Node*)vnode);
         return NULL;
     }
     return (UA_Node*)vnode;
 }
 
 static UA_Node *
-objectNodeFromAttributes(const UA_AddNodesItem *item, const UA_ObjectAttributes *attr) {
-    UA_ObjectNode *onode = UA_NodeStore_newObjectNode();
+objectNodeFromAttributes(UA_NodeStore *ns, const UA_AddNodesItem *item, const UA_ObjectAttributes *attr) {
+    UA_ObjectNode *onode = UA_NodeStore_newObjectNode(ns);
     if(!onode)
         return NULL;
     UA_StatusCode retval = copyStandardAttributes((UA_Node*)onode, item, (const UA_NodeAttributes*)attr);
     onode->eventNotifier = attr->eventNotifier;
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeStore_deleteNode((UA_Node*)onode);
+        UA_NodeStore_deleteNode(ns, (UA_Node*)onode);
         return NULL;
     }
     return (UA_Node*)onode;
 }
 
 static UA_Node *
-referenceTypeNodeFromAttributes(const UA_AddNodesItem *item, const UA_ReferenceTypeAttributes *attr) {
-    UA_ReferenceTypeNode *rtnode = UA_NodeStore_newReferenceTypeNode();
+referenceTypeNodeFromAttributes(UA_NodeStore *ns, const UA_AddNodesItem *item, const UA_ReferenceTypeAttributes *attr) {
+    UA_ReferenceTypeNode *rtnode = UA_NodeStore_newReferenceTypeNode(ns);
     if(!rtnode)
         return NULL;
     UA_StatusCode retval = copyStandardAttributes((UA_Node*)rtnode, item, (const UA_NodeAttributes*)attr);
@@ -365,29 +429,29 @@ referenceTypeNodeFromAttributes(const UA_AddNodesItem *item, const UA_ReferenceT
     rtnode->symmetric = attr->symmetric;
     retval |= UA_LocalizedText_copy(&attr->inverseName, &rtnode->inverseName);
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeStore_deleteNode((UA_Node*)rtnode);
+        UA_NodeStore_deleteNode(ns, (UA_Node*)rtnode);
         return NULL;
     }
     return (UA_Node*)rtnode;
 }
 
 static UA_Node *
-objectTypeNodeFromAttributes(const UA_AddNodesItem *item, const UA_ObjectTypeAttributes *attr) {
-    UA_ObjectTypeNode *otnode = UA_NodeStore_newObjectTypeNode();
+objectTypeNodeFromAttributes(UA_NodeStore *ns, const UA_AddNodesItem *item, const UA_ObjectTypeAttributes *attr) {
+    UA_ObjectTypeNode *otnode = UA_NodeStore_newObjectTypeNode(ns);
     if(!otnode)
         return NULL;
     UA_StatusCode retval = copyStandardAttributes((UA_Node*)otnode, item, (const UA_NodeAttributes*)attr);
     otnode->isAbstract = attr->isAbstract;
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeStore_deleteNode((UA_Node*)otnode);
+        UA_NodeStore_deleteNode(ns, (UA_Node*)otnode);
         return NULL;
     }
     return (UA_Node*)otnode;
 }
 
 static UA_Node *
-variableTypeNodeFromAttributes(const UA_AddNodesItem *item, const UA_VariableTypeAttributes *attr) {
-    UA_VariableTypeNode *vtnode = UA_NodeStore_newVariableTypeNode();
+variableTypeNodeFromAttributes(UA_NodeStore *ns, const UA_AddNodesItem *item, const UA_VariableTypeAttributes *attr) {
+    UA_VariableTypeNode *vtnode = UA_NodeStore_newVariableTypeNode(ns);
     if(!vtnode)
         return NULL;
     UA_StatusCode retval = copyStandardAttributes((UA_Node*)vtnode, item, (const UA_NodeAttributes*)attr);
@@ -397,112 +461,130 @@ variableTypeNodeFromAttributes(const UA_AddNodesItem *item, const UA_VariableTyp
     // array dimensions are taken from the value
     vtnode->isAbstract = attr->isAbstract;
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeStore_deleteNode((UA_Node*)vtnode);
+        UA_NodeStore_deleteNode(ns, (UA_Node*)vtnode);
         return NULL;
     }
     return (UA_Node*)vtnode;
 }
 
 static UA_Node *
-viewNodeFromAttributes(const UA_AddNodesItem *item, const UA_ViewAttributes *attr) {
-    UA_ViewNode *vnode = UA_NodeStore_newViewNode();
+viewNodeFromAttributes(UA_NodeStore *ns, const UA_AddNodesItem *item, const UA_ViewAttributes *attr) {
+    UA_ViewNode *vnode = UA_NodeStore_newViewNode(ns);
     if(!vnode)
         return NULL;
     UA_StatusCode retval = copyStandardAttributes((UA_Node*)vnode, item, (const UA_NodeAttributes*)attr);
     vnode->containsNoLoops = attr->containsNoLoops;
     vnode->eventNotifier = attr->eventNotifier;
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeStore_deleteNode((UA_Node*)vnode);
+        UA_NodeStore_deleteNode(ns, (UA_Node*)vnode);
         return NULL;
     }
     return (UA_Node*)vnode;
 }
 
 static UA_Node *
-dataTypeNodeFromAttributes(const UA_AddNodesItem *item, const UA_DataTypeAttributes *attr) {
-    UA_DataTypeNode *dtnode = UA_NodeStore_newDataTypeNode();
+dataTypeNodeFromAttributes(UA_NodeStore *ns, const UA_AddNodesItem *item, const UA_DataTypeAttributes *attr) {
+    UA_DataTypeNode *dtnode = UA_NodeStore_newDataTypeNode(ns);
     if(!dtnode)
         return NULL;
     UA_StatusCode retval = copyStandardAttributes((UA_Node*)dtnode, item, (const UA_NodeAttributes*)attr);
     dtnode->isAbstract = attr->isAbstract;
     if(retval != UA_STATUSCODE_GOOD) {
-        UA_NodeStore_deleteNode((UA_Node*)dtnode);
+        UA_NodeStore_deleteNode(ns, (UA_Node*)dtnode);
         return NULL;
     }
     return (UA_Node*)dtnode;
 }
 
-void Service_AddNodes_single(UA_Server *server, UA_Session *session, const UA_AddNodesItem *item,
-                             UA_AddNodesResult *result, UA_InstantiationCallback *instantiationCallback) {
+/* Create the node of an AddNodes item */
+static UA_StatusCode
+nodeFromAddNodesItem(UA_NodeStore *ns, const UA_AddNodesItem *item, UA_Node **node) {
     if(item->nodeAttributes.encoding < UA_EXTENSIONOBJECT_DECODED ||
-       !item->nodeAttributes.content.decoded.type) {
-        result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-        return;
-    }
-    
-    /* create the node */
-    UA_Node *node;
+       !item->nodeAttributes.content.decoded.type)
+        return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+
+    const UA_DataType *attributesType = item->nodeAttributes.content.decoded.type;
+    const void *attributes = item->nodeAttributes.content.decoded.data;
     switch(item->nodeClass) {
     case UA_NODECLASS_OBJECT:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = objectNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(attributesType != &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = objectNodeFromAttributes(ns, item, attributes);
         break;
     case UA_NODECLASS_VARIABLE:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = variableNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(attributesType != &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = variableNodeFromAttributes(ns, item, attributes);
         break;
     case UA_NODECLASS_OBJECTTYPE:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = objectTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(attributesType != &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = objectTypeNodeFromAttributes(ns, item, attributes);
         break;
     case UA_NODECLASS_VARIABLETYPE:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = variableTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(attributesType != &UA_TYPES[UA_TYPES_VARIABLETYPEATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = variableTypeNodeFromAttributes(ns, item, attributes);
         break;
     case UA_NODECLASS_REFERENCETYPE:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_REFERENCETYPEATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = referenceTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(attributesType != &UA_TYPES[UA_TYPES_REFERENCETYPEATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = referenceTypeNodeFromAttributes(ns, item, attributes);
         break;
     case UA_NODECLASS_DATATYPE:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_DATATYPEATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = dataTypeNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(attributesType != &UA_TYPES[UA_TYPES_DATATYPEATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = dataTypeNodeFromAttributes(ns, item, attributes);
         break;
     case UA_NODECLASS_VIEW:
-        if(item->nodeAttributes.content.decoded.type != &UA_TYPES[UA_TYPES_VIEWATTRIBUTES]) {
-            result->statusCode = UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
-            return;
-        }
-        node = viewNodeFromAttributes(item, item->nodeAttributes.content.decoded.data);
+        if(attributesType != &UA_TYPES[UA_TYPES_VIEWATTRIBUTES])
+            return UA_STATUSCODE_BADNODEATTRIBUTESINVALID;
+        *node = viewNodeFromAttributes(ns, item, attributes);
         break;
     case UA_NODECLASS_METHOD:
     case UA_NODECLASS_UNSPECIFIED:
     default:
-        result->statusCode = UA_STATUSCODE_BADNODECLASSINVALID;
-        return;
+        return UA_STATUSCODE_BADNODECLASSINVALID;
     }
 
-    if(!node) {
-        result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+    if(!*node)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    return UA_STATUSCODE_GOOD;
+}
+
+/* Instantiate the type definition of a new node. If this fails, the node is
+   removed. */
+static void
+instantiateAddedNode(UA_Server *server, UA_Session *session, const UA_AddNodesItem *item,
+                     UA_AddNodesResult *result, UA_InstantiationCallback *instantiationCallback) {
+    if(UA_NodeId_isNull(&item->typeDefinition.nodeId))
+        return;
+
+    if(instantiationCallback != NULL)
+        instantiationCallback->method(result->addedNodeId, item->typeDefinition.nodeId,
+                                      instantiationCallback->handle);
+
+    if(item->nodeClass == UA_NODECLASS_OBJECT)
+        result->statusCode = instantiateObjectNode(server, session, &result->addedNodeId,
+                                                   &item->typeDefinition.nodeId, true,
+                                                   instantiationCallback);
+    else if(item->nodeClass == UA_NODECLASS_VARIABLE)
+        result->statusCode = instantiateVariableNode(server, session, &result->addedNodeId,
+                                                     &item->typeDefinition.nodeId, true,
+                                                     instantiationCallback);
+
+    /* if instantiation failed, remove the node */
+    if(result->statusCode != UA_STATUSCODE_GOOD)
+        Service_DeleteNodes_single(server, session, &result->addedNodeId, true);
+}
+
+void Service_AddNodes_single(UA_Server *server, UA_Session *session, const UA_AddNodesItem *item,
+                             UA_AddNodesResult *result, UA_InstantiationCallback *instantiationCallback) {
+    /* create the node */
+    UA_Node *node = NULL;
+    result->statusCode = nodeFromAddNodesItem(server->nodestore, item, &node);
+    if(result->statusCode != UA_STATUSCODE_GOOD)
         return;
-    }
 
     /* add it to the server */
     UA_Server_addExistingNode(server, session, node, &item->parentNodeId.nodeId,
@@ -511,22 +593,223 @@ void Service_AddNodes_single(UA_Server *server, UA_Session *session, const UA_Ad
         return;
     
     /* instantiate if it has a type */
-    if(!UA_NodeId_isNull(&item->typeDefinition.nodeId)) {
-        if (instantiationCallback != NULL)
-          instantiationCallback->method(result->addedNodeId, item->typeDefinition.nodeId,
-                                        instantiationCallback->handle); 
-        
-        if(item->nodeClass == UA_NODECLASS_OBJECT)
-            result->statusCode = instantiateObjectNode(server, session, &result->addedNodeId,
-                                                       &item->typeDefinition.nodeId, instantiationCallback);
-        else if(item->nodeClass == UA_NODECLASS_VARIABLE)
-            result->statusCode = instantiateVariableNode(server, session, &result->addedNodeId,
-                                                         &item->typeDefinition.nodeId, instantiationCallback);
+    instantiateAddedNode(server, session, item, result, instantiationCallback);
+}
+
+/* Batch mode of the AddNodes service. First, the nodes of all items are
+ * validated and inserted with the inverse reference to their parent already
+ * set. The items are processed in order, so a node can be the parent of the
+ * following items. The references from the parents to the new nodes are
+ * collected, sorted by parent and added with a single edit per parent. Then the
+ * type definitions are instantiated when all nodes of the request (including
+ * new types and their children) are complete. */
+
+/* A reference from a parent to a new node that is added after the nodes of the
+   request were inserted */
+typedef struct {
+    const UA_NodeId *parent;
+    const UA_NodeId *referenceTypeId;
+    const UA_NodeId *nodeId;
+    size_t index; // of the item in the request
+} UA_ParentReference;
+
+typedef struct {
+    const UA_ParentReference *refs;
+    size_t refsSize;
+} UA_ParentReferences;
+
+static int compareNodeId(const UA_NodeId *a, const UA_NodeId *b) {
+    if(a->namespaceIndex != b->namespaceIndex)
+        return a->namespaceIndex < b->namespaceIndex ? -1 : 1;
+    if(a->identifierType != b->identifierType)
+        return a->identifierType < b->identifierType ? -1 : 1;
+    switch(a->identifierType) {
+    case UA_NODEIDTYPE_NUMERIC:
+        if(a->identifier.numeric == b->identifier.numeric)
+            return 0;
+        return a->identifier.numeric < b->identifier.numeric ? -1 : 1;
+    case UA_NODEIDTYPE_GUID:
+        return memcmp(&a->identifier.guid, &b->identifier.guid, sizeof(UA_Guid));
+    default: // string and bytestring
+        if(a->identifier.string.length != b->identifier.string.length)
+            return a->identifier.string.length < b->identifier.string.length ? -1 : 1;
+        if(a->identifier.string.length == 0)
+            return 0;
+        return memcmp(a->identifier.string.data, b->identifier.string.data,
+                      a->identifier.string.length);
     }
+}
 
-    /* if instantiation failed, remove the node */
+/* Order by parent. The references of a parent are added in request order. */
+static int compareParentReferences(const void *a, const void *b) {
+    const UA_ParentReference *ra = a;
+    const UA_ParentReference *rb = b;
+    int order = compareNodeId(ra->parent, rb->parent);
+    if(order != 0)
+        return order;
+    return ra->index < rb->index ? -1 : (ra->index > rb->index);
+}
+
+/* Adds the references of a parent with a single realloc. On failure, the
+   parent is unchanged. */
+static UA_StatusCode
+addParentReferences(UA_Server *server, UA_Session *session, UA_Node *node,
+                    const UA_ParentReferences *parentRefs) {
+    size_t size = node->referencesSize;
+    UA_ReferenceNode *new_refs =
+        UA_realloc(node->references, sizeof(UA_ReferenceNode) * (size + parentRefs->refsSize));
+    if(!new_refs)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    node->references = new_refs;
+    UA_StatusCode retval = UA_STATUSCODE_GOOD;
+    for(size_t i = 0; i < parentRefs->refsSize; i++) {
+        UA_ReferenceNode *rn = &new_refs[size + i];
+        UA_ReferenceNode_init(rn);
+        retval |= UA_NodeId_copy(parentRefs->refs[i].referenceTypeId, &rn->referenceTypeId);
+        retval |= UA_NodeId_copy(parentRefs->refs[i].nodeId, &rn->targetId.nodeId);
+        node->referencesSize++;
+    }
+    if(retval != UA_STATUSCODE_GOOD) {
+        for(size_t i = size; i < node->referencesSize; i++)
+            UA_ReferenceNode_deleteMembers(&new_refs[i]);
+        node->referencesSize = size;
+    }
+    return retval;
+}
+
+/* Create and insert the node of an item. The parent is not edited. */
+static void
+insertBatchNode(UA_Server *server, const UA_AddNodesItem *item, UA_AddNodesResult *result) {
+    UA_Node *node = NULL;
+    result->statusCode = nodeFromAddNodesItem(server->nodestore, item, &node);
     if(result->statusCode != UA_STATUSCODE_GOOD)
+        return;
+
+    if(node->nodeId.namespaceIndex >= server->namespacesSize)
+        result->statusCode = UA_STATUSCODE_BADNODEIDINVALID;
+    else
+        result->statusCode = checkParentReference(server, &item->parentNodeId.nodeId,
+                                                  &item->referenceTypeId);
+
+    /* The type definition is checked before the node is inserted. The
+       instantiation itself follows once all nodes are wired up. */
+    UA_NodeClass typeClass = UA_NODECLASS_UNSPECIFIED;
+    if(item->nodeClass == UA_NODECLASS_OBJECT)
+        typeClass = UA_NODECLASS_OBJECTTYPE;
+    else if(item->nodeClass == UA_NODECLASS_VARIABLE)
+        typeClass = UA_NODECLASS_VARIABLETYPE;
+    if(result->statusCode == UA_STATUSCODE_GOOD && typeClass != UA_NODECLASS_UNSPECIFIED &&
+       !UA_NodeId_isNull(&item->typeDefinition.nodeId)) {
+        const UA_Node *typenode = UA_NodeStore_get(server->nodestore, &item->typeDefinition.nodeId);
+        if(!typenode)
+            result->statusCode = UA_STATUSCODE_BADNODEIDINVALID;
+        else if(typenode->nodeClass != typeClass)
+            result->statusCode = UA_STATUSCODE_BADNODECLASSINVALID;
+    }
+
+    /* the reference back to the parent */
+    if(result->statusCode == UA_STATUSCODE_GOOD) {
+        node->references = UA_Array_new(1, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+        if(node->references) {
+            node->referencesSize = 1;
+            node->references[0].isInverse = true;
+            result->statusCode =
+                UA_NodeId_copy(&item->referenceTypeId, &node->references[0].referenceTypeId);
+            result->statusCode |=
+                UA_NodeId_copy(&item->parentNodeId.nodeId, &node->references[0].targetId.nodeId);
+        } else {
+            result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+        }
+    }
+    if(result->statusCode != UA_STATUSCODE_GOOD) {
+        UA_NodeStore_deleteNode(server->nodestore, node);
+        return;
+    }
+
+    UA_Boolean isReferenceType = (node->nodeClass == UA_NODECLASS_REFERENCETYPE);
+    result->statusCode = UA_NodeStore_insert(server->nodestore, node);
+    if(result->statusCode == UA_STATUSCODE_GOOD)
+        result->statusCode = UA_NodeId_copy(&node->nodeId, &result->addedNodeId);
+    if(isReferenceType)
+        UA_Server_invalidateReferenceTypes(server);
+}
+
+/* Items with skip[i] set are not processed (skip can be NULL) */
+static void
+addNodesBatch(UA_Server *server, UA_Session *session, const UA_AddNodesRequest *request,
+              UA_AddNodesResponse *response, const UA_Boolean *skip) {
+    size_t size = request->nodesToAddSize;
+    UA_ParentReference *refs = UA_malloc(sizeof(UA_ParentReference) * size);
+    if(!refs) {
+        response->responseHeader.serviceResult = UA_STATUSCODE_BADOUTOFMEMORY;
+        return;
+    }
+
+    /* Insert the nodes */
+    size_t refsSize = 0;
+    for(size_t i = 0; i < size; i++) {
+        if(skip && skip[i])
+            continue;
+        const UA_AddNodesItem *item = &request->nodesToAdd[i];
+        insertBatchNode(server, item, &response->results[i]);
+        if(response->results[i].statusCode != UA_STATUSCODE_GOOD)
+            continue;
+        refs[refsSize].parent = &item->parentNodeId.nodeId;
+        refs[refsSize].referenceTypeId = &item->referenceTypeId;
+        refs[refsSize].nodeId = &response->results[i].addedNodeId;
+        refs[refsSize].index = i;
+        refsSize++;
+    }
+
+    /* Add the references of every parent at once */
+    qsort(refs, refsSize, sizeof(UA_ParentReference), compareParentReferences);
+    UA_Boolean subtypesChanged = false;
+    UA_Boolean removed = false;
+    for(size_t i = 0, j; i < refsSize; i = j) {
+        for(j = i + 1; j < refsSize && UA_NodeId_equal(refs[i].parent, refs[j].parent); j++) {}
+        UA_ParentReferences parentRefs = {&refs[i], j - i};
+        UA_StatusCode retval =
+            UA_Server_editNode(server, session, refs[i].parent,
+                               (UA_EditNodeCallback)addParentReferences, &parentRefs);
+        for(size_t k = i; k < j; k++) {
+            if(isHasSubtype(refs[k].referenceTypeId))
+                subtypesChanged = true;
+            if(retval == UA_STATUSCODE_GOOD)
+                continue;
+            /* the node cannot be reached from its parent */
+            UA_AddNodesResult *result = &response->results[refs[k].index];
+            result->statusCode = retval;
+            Service_DeleteNodes_single(server, session, &result->addedNodeId, true);
+            UA_NodeId_deleteMembers(&result->addedNodeId);
+            removed = true;
+        }
+    }
+    if(subtypesChanged)
+        UA_Server_invalidateReferenceTypes(server);
+    UA_free(refs);
+
+    /* A removed node may be the parent of other nodes of the request. They
+       cannot be reached anymore and are removed as well. The parent of every
+       inserted node existed at insertion time. So parents precede their
+       children in the request and a single pass in request order removes all
+       descendants of the removed nodes. */
+    for(size_t i = 0; removed && i < size; i++) {
+        if((skip && skip[i]) || response->results[i].statusCode != UA_STATUSCODE_GOOD)
+            continue;
+        if(UA_NodeStore_get(server->nodestore, &request->nodesToAdd[i].parentNodeId.nodeId))
+            continue;
+        UA_AddNodesResult *result = &response->results[i];
+        result->statusCode = UA_STATUSCODE_BADPARENTNODEIDINVALID;
         Service_DeleteNodes_single(server, session, &result->addedNodeId, true);
+        UA_NodeId_deleteMembers(&result->addedNodeId);
+    }
+
+    /* Instantiate the type definitions */
+    for(size_t i = 0; i < size; i++) {
+        if((skip && skip[i]) || response->results[i].statusCode != UA_STATUSCODE_GOOD)
+            continue;
+        instantiateAddedNode(server, session, &request->nodesToAdd[i], &response->results[i], NULL);
+    }
 }
 
 void Service_AddNodes(UA_Server *server, UA_Session *session, const UA_AddNodesRequest *request,
@@ -571,12 +854,11 @@ void Service_AddNodes(UA_Server *server, UA_Session *session, const UA_AddNodesR
 #endif
     
     response->resultsSize = size;
-    for(size_t i = 0; i < size; i++) {
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
-        if(!isExternal[i])
+    addNodesBatch(server, session, request, response, isExternal);
+#else
+    addNodesBatch(server, session, request, response, NULL);
 #endif
-            Service_AddNodes_single(server, session, &request->nodesToAdd[i], &response->results[i], NULL);
-    }
 }
 
 /**************************************************/
@@ -609,7 +891,7 @@ UA_Server_addDataSourceVariableNode(UA_Server *server, const UA_NodeId requested
         return result.statusCode;
     }
 
-    UA_VariableNode *node = UA_NodeStore_newVariableNode();
+    UA_VariableNode *node = UA_NodeStore_newVariableNode(server->nodestore);
     if(!node) {
         UA_AddNodesItem_deleteMembers(&item);
         UA_VariableAttributes_deleteMembers(&attrCopy);
@@ -666,7 +948,7 @@ UA_Server_addMethodNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
         return result.statusCode;
     }
 
-    UA_MethodNode *node = UA_NodeStore_newMethodNode();
+    UA_MethodNode *node = UA_NodeStore_newMethodNode(server->nodestore);
     if(!node) {
         result.statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
         UA_AddNodesItem_deleteMembers(&item);
@@ -694,7 +976,7 @@ UA_Server_addMethodNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
     parent.nodeId = result.addedNodeId;
     
     const UA_NodeId hasproperty = UA_NODEID_NUMERIC(0, UA_NS0ID_HASPROPERTY);
-    UA_VariableNode *inputArgumentsVariableNode = UA_NodeStore_newVariableNode();
+    UA_VariableNode *inputArgumentsVariableNode = UA_NodeStore_newVariableNode(server->nodestore);
     inputArgumentsVariableNode->nodeId.namespaceIndex = result.addedNodeId.namespaceIndex;
     inputArgumentsVariableNode->browseName = UA_QUALIFIEDNAME_ALLOC(0,"InputArguments");
     inputArgumentsVariableNode->displayName = UA_LOCALIZEDTEXT_ALLOC("en_US", "InputArguments");
@@ -712,7 +994,7 @@ UA_Server_addMethodNode(UA_Server *server, const UA_NodeId requestedNewNodeId,
     
     /* create OutputArguments */
     /* FIXME:   See comment in inputArguments */
-    UA_VariableNode *outputArgumentsVariableNode  = UA_NodeStore_newVariableNode();
+    UA_VariableNode *outputArgumentsVariableNode  = UA_NodeStore_newVariableNode(server->nodestore);
     outputArgumentsVariableNode->nodeId.namespaceIndex = result.addedNodeId.namespaceIndex;
     outputArgumentsVariableNode->browseName  = UA_QUALIFIEDNAME_ALLOC(0,"OutputArguments");
     outputArgumentsVariableNode->displayName = UA_LOCALIZEDTEXT_ALLOC("en_US", "OutputArguments");
@@ -776,6 +1058,13 @@ UA_Server_methodNode_attachCallback(UA_Server *server, const UA_NodeId methodNod
 /* Add References */
 /******************/
 
+/* The subtypes of the reference types change with HasSubtype references */
+static UA_Boolean isHasSubtype(const UA_NodeId *referenceTypeId) {
+    return referenceTypeId->namespaceIndex == 0 &&
+        referenceTypeId->identifierType == UA_NODEIDTYPE_NUMERIC &&
+        referenceTypeId->identifier.numeric == UA_NS0ID_HASSUBTYPE;
+}
+
 /* Adds a one-way reference to the local nodestore */
 static UA_StatusCode
 addOneWayReference(UA_Server *server, UA_Session *session, UA_Node *node, const UA_AddReferencesItem *item) {
@@ -815,6 +1104,8 @@ Service_AddReferences_single(UA_Server *server, UA_Session *session, const UA_Ad
     secondItem.isForward = !item->isForward;
     retval = UA_Server_editNode(server, session, &secondItem.sourceNodeId,
                                 (UA_EditNodeCallback)addOneWayReference, &secondItem);
+    if(isHasSubtype(&item->referenceTypeId))
+        UA_Server_invalidateReferenceTypes(server);
 
     // todo: remove reference if the second direction failed
     return retval;
@@ -925,7 +1216,11 @@ Service_DeleteNodes_single(UA_Server *server, UA_Session *session, const UA_Node
         UA_BrowseResult_deleteMembers(&result);
     }
     
-    return UA_NodeStore_remove(server->nodestore, nodeId);
+    UA_Boolean isReferenceType = (node->nodeClass == UA_NODECLASS_REFERENCETYPE);
+    UA_StatusCode retval = UA_NodeStore_remove(server->nodestore, nodeId);
+    if(isReferenceType)
+        UA_Server_invalidateReferenceTypes(server);
+    return retval;
 }
 
 void Service_DeleteNodes(UA_Server *server, UA_Session *session, const UA_DeleteNodesRequest *request,
@@ -984,15 +1279,18 @@ Service_DeleteReferences_single(UA_Server *server, UA_Session *session,
                                 const UA_DeleteReferencesItem *item) {
     UA_StatusCode retval = UA_Server_editNode(server, session, &item->sourceNodeId,
                                               (UA_EditNodeCallback)deleteOneWayReference, item);
-    if(!item->deleteBidirectional || item->targetNodeId.serverIndex != 0)
-        return retval;
-    UA_DeleteReferencesItem secondItem;
-    UA_DeleteReferencesItem_init(&secondItem);
-    secondItem.isForward = !item->isForward;
-    secondItem.sourceNodeId = item->targetNodeId.nodeId;
-    secondItem.targetNodeId.nodeId = item->sourceNodeId;
-    return UA_Server_editNode(server, session, &secondItem.sourceNodeId,
-                              (UA_EditNodeCallback)deleteOneWayReference, &secondItem);
+    if(item->deleteBidirectional && item->targetNodeId.serverIndex == 0) {
+        UA_DeleteReferencesItem secondItem;
+        UA_DeleteReferencesItem_init(&secondItem);
+        secondItem.isForward = !item->isForward;
+        secondItem.sourceNodeId = item->targetNodeId.nodeId;
+        secondItem.targetNodeId.nodeId = item->sourceNodeId;
+        retval = UA_Server_editNode(server, session, &secondItem.sourceNodeId,
+                                    (UA_EditNodeCallback)deleteOneWayReference, &secondItem);
+    }
+    if(isHasSubtype(&item->referenceTypeId))
+        UA_Server_invalidateReferenceTypes(server);
+    return retval;
 }
 
 void
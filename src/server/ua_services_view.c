@@ -21,22 +21,271 @@ fillReferenceDescription(UA_NodeStore *ns, const UA_Node *curr, UA_ReferenceNode
         retval |= UA_LocalizedText_copy(&curr->displayName, &descr->displayName);
     if(mask & UA_BROWSERESULTMASK_TYPEDEFINITION){
         if(curr->nodeClass == UA_NODECLASS_OBJECT || curr->nodeClass == UA_NODECLASS_VARIABLE) {
-            for(size_t i = 0; i < curr->referencesSize; i++) {
-                UA_ReferenceNode *refnode = &curr->references[i];
-                if(refnode->referenceTypeId.identifier.numeric != UA_NS0ID_HASTYPEDEFINITION)
+            const UA_NodeId hasTypeDefinition = UA_NODEID_NUMERIC(0, UA_NS0ID_HASTYPEDEFINITION);
+            size_t i = UA_NodeStore_findReference(ns, curr, &hasTypeDefinition, false, 0, NULL);
+            if(i < curr->referencesSize)
+                retval |= UA_ExpandedNodeId_copy(&curr->references[i].targetId,
+                                                 &descr->typeDefinition);
+        }
+    }
+    return retval;
+}
+
+/**
+ * The reference types below References are numbered densely in the order of a
+ * breadth-first walk over the HasSubtype references. For every reference type,
+ * the closure of its subtypes (including itself) is a bitset over the numbers.
+ * So the test if a reference is relevant for includeSubtypes is a lookup of the
+ * number of its type and a bit test.
+ *
+ * The closures are computed once for the server and dropped when a reference
+ * type or a HasSubtype reference is added or removed. With multithreading,
+ * readers keep the old closures until the end of their read-side critical
+ * section.
+ */
+
+/* The ns0 reference types with a smaller numeric id are found in a table */
+#define UA_REFERENCETYPES_NS0 256
+
+struct UA_ReferenceTypeClosures {
+    size_t typesSize;
+    UA_NodeId *types; // by number
+    UA_UInt32 ns0[UA_REFERENCETYPES_NS0]; // number + 1 of the ns0 reference types
+    size_t words; // of every bitset
+    UA_UInt32 *bits; // the closures of all types one after the other
+#ifdef UA_ENABLE_MULTITHREADING
+    struct rcu_head rcu_head;
+#endif
+};
+typedef struct UA_ReferenceTypeClosures UA_ReferenceTypeClosures;
+
+static void deleteReferenceTypeClosures(UA_ReferenceTypeClosures *c) {
+    UA_Array_delete(c->types, c->typesSize, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_free(c->bits);
+    UA_free(c);
+}
+
+#ifdef UA_ENABLE_MULTITHREADING
+static void deleteReferenceTypeClosuresRcu(struct rcu_head *head) {
+    UA_ReferenceTypeClosures *c = container_of(head, UA_ReferenceTypeClosures, rcu_head);
+    deleteReferenceTypeClosures(c);
+}
+#endif
+
+/* Returns the number of the reference type or typesSize if it is unknown */
+static size_t
+referenceTypeNumber(const UA_ReferenceTypeClosures *c, const UA_NodeId *referenceTypeId) {
+    if(referenceTypeId->namespaceIndex == 0 &&
+       referenceTypeId->identifierType == UA_NODEIDTYPE_NUMERIC &&
+       referenceTypeId->identifier.numeric < UA_REFERENCETYPES_NS0) {
+        UA_UInt32 n = c->ns0[referenceTypeId->identifier.numeric];
+        return n > 0 ? n - 1 : c->typesSize;
+    }
+    for(size_t i = 0; i < c->typesSize; i++) {
+        if(UA_NodeId_equal(&c->types[i], referenceTypeId))
+            return i;
+    }
+    return c->typesSize;
+}
+
+static UA_StatusCode
+addReferenceType(UA_ReferenceTypeClosures *c, size_t *capacity,
+                 const UA_NodeId *referenceTypeId, size_t *number) {
+    *number = referenceTypeNumber(c, referenceTypeId);
+    if(*number < c->typesSize)
+        return UA_STATUSCODE_GOOD;
+    if(c->typesSize >= *capacity) {
+        UA_NodeId *types = UA_realloc(c->types, sizeof(UA_NodeId) * *capacity * 2);
+        if(!types)
+            return UA_STATUSCODE_BADOUTOFMEMORY;
+        c->types = types;
+        *capacity *= 2;
+    }
+    UA_StatusCode retval = UA_NodeId_copy(referenceTypeId, &c->types[c->typesSize]);
+    if(retval != UA_STATUSCODE_GOOD)
+        return retval;
+    if(referenceTypeId->namespaceIndex == 0 &&
+       referenceTypeId->identifierType == UA_NODEIDTYPE_NUMERIC &&
+       referenceTypeId->identifier.numeric < UA_REFERENCETYPES_NS0)
+        c->ns0[referenceTypeId->identifier.numeric] = (UA_UInt32)c->typesSize + 1;
+    *number = c->typesSize++;
+    return UA_STATUSCODE_GOOD;
+}
+
+static UA_ReferenceTypeClosures * buildReferenceTypeClosures(UA_NodeStore *ns) {
+    UA_ReferenceTypeClosures *c = UA_calloc(1, sizeof(UA_ReferenceTypeClosures));
+    if(!c)
+        return NULL;
+    size_t capacity = 32;
+    size_t edgesSize = 0;
+    size_t edgesCapacity = 32;
+    size_t *edges = UA_malloc(sizeof(size_t) * 2 * edgesCapacity); // pairs of supertype and subtype
+    c->types = UA_malloc(sizeof(UA_NodeId) * capacity);
+    if(!edges || !c->types)
+        goto error;
+
+    /* Number the reference types breadth-first */
+    const UA_NodeId references = UA_NODEID_NUMERIC(0, UA_NS0ID_REFERENCES);
+    const UA_NodeId hasSubtype = UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE);
+    const UA_Node *node = UA_NodeStore_get(ns, &references);
+    size_t number;
+    if(node && node->nodeClass == UA_NODECLASS_REFERENCETYPE &&
+       addReferenceType(c, &capacity, &references, &number) != UA_STATUSCODE_GOOD)
+        goto error;
+    for(size_t i = 0; i < c->typesSize; i++) {
+        node = UA_NodeStore_get(ns, &c->types[i]);
+        if(!node)
+            continue;
+        UA_NodeId target;
+        for(size_t j = UA_NodeStore_findReference(ns, node, &hasSubtype, false, 0, &target);
+            j < node->referencesSize;
+            j = UA_NodeStore_findReference(ns, node, &hasSubtype, false, j + 1, &target)) {
+            const UA_Node *subtype = UA_NodeStore_get(ns, &target);
+            if(!subtype || subtype->nodeClass != UA_NODECLASS_REFERENCETYPE)
+                continue;
+            if(addReferenceType(c, &capacity, &target, &number) != UA_STATUSCODE_GOOD)
+                goto error;
+            if(edgesSize >= edgesCapacity) {
+                size_t *newEdges = UA_realloc(edges, sizeof(size_t) * 4 * edgesCapacity);
+                if(!newEdges)
+                    goto error;
+                edges = newEdges;
+                edgesCapacity *= 2;
+            }
+            edges[edgesSize * 2] = i;
+            edges[edgesSize * 2 + 1] = number;
+            edgesSize++;
+        }
+    }
+
+    /* Every type is in its own closure. The closures of the subtypes are added
+       to the supertypes until nothing changes. */
+    c->words = (c->typesSize + 31) / 32;
+    if(c->typesSize > 0) {
+        c->bits = UA_calloc(c->typesSize * c->words, sizeof(UA_UInt32));
+        if(!c->bits)
+            goto error;
+    }
+    for(size_t i = 0; i < c->typesSize; i++)
+        c->bits[i * c->words + i / 32] |= (UA_UInt32)1 << (i % 32);
+    UA_Boolean changed;
+    do {
+        changed = false;
+        for(size_t e = 0; e < edgesSize; e++) {
+            UA_UInt32 *super = &c->bits[edges[e * 2] * c->words];
+            const UA_UInt32 *sub = &c->bits[edges[e * 2 + 1] * c->words];
+            for(size_t w = 0; w < c->words; w++) {
+                if((super[w] | sub[w]) == super[w])
                     continue;
-                retval |= UA_ExpandedNodeId_copy(&refnode->targetId, &descr->typeDefinition);
-                break;
+                super[w] |= sub[w];
+                changed = true;
             }
         }
+    } while(changed);
+    UA_free(edges);
+    return c;
+
+ error:
+    UA_free(edges);
+    deleteReferenceTypeClosures(c);
+    return NULL;
+}
+
+/* Returns the closures of the server. They are built on the first use. */
+static const UA_ReferenceTypeClosures * getReferenceTypeClosures(UA_Server *server) {
+#ifndef UA_ENABLE_MULTITHREADING
+    if(!server->referenceTypes)
+        server->referenceTypes = buildReferenceTypeClosures(server->nodestore);
+    return server->referenceTypes;
+#else
+    UA_ReferenceTypeClosures *c = rcu_dereference(server->referenceTypes);
+    if(c)
+        return c;
+    UA_UInt32 version = uatomic_read(&server->referenceTypesVersion);
+    cmm_smp_mb();
+    c = buildReferenceTypeClosures(server->nodestore);
+    if(!c)
+        return NULL;
+    UA_ReferenceTypeClosures *other = rcu_cmpxchg_pointer(&server->referenceTypes, NULL, c);
+    if(other) {
+        /* another thread was faster */
+        deleteReferenceTypeClosures(c);
+        return other;
+    }
+    /* The reference types were changed during the build. The closures are
+       used for this request only. */
+    cmm_smp_mb();
+    if(uatomic_read(&server->referenceTypesVersion) != version)
+        UA_Server_invalidateReferenceTypes(server);
+    return c;
+#endif
+}
+
+void UA_Server_invalidateReferenceTypes(UA_Server *server) {
+#ifndef UA_ENABLE_MULTITHREADING
+    if(server->referenceTypes)
+        deleteReferenceTypeClosures(server->referenceTypes);
+    server->referenceTypes = NULL;
+#else
+    uatomic_inc(&server->referenceTypesVersion);
+    cmm_smp_mb();
+    UA_ReferenceTypeClosures *c = rcu_xchg_pointer(&server->referenceTypes, NULL);
+    if(c)
+        call_rcu(&c->rcu_head, deleteReferenceTypeClosuresRcu);
+#endif
+}
+
+/* The reference types that match a browse description or a path element */
+typedef struct {
+    const UA_ReferenceTypeClosures *closures;
+    const UA_UInt32 *bits; // the closure or NULL if only the type itself matches
+    const UA_NodeId *referenceTypeId;
+} ReferenceTypeSet;
+
+static UA_StatusCode
+findSubTypes(UA_Server *server, const UA_NodeId *root, ReferenceTypeSet *set) {
+    set->closures = getReferenceTypeClosures(server);
+    if(!set->closures)
+        return UA_STATUSCODE_BADOUTOFMEMORY;
+    set->referenceTypeId = root;
+    size_t number = referenceTypeNumber(set->closures, root);
+    if(number < set->closures->typesSize) {
+        set->bits = &set->closures->bits[number * set->closures->words];
+        return UA_STATUSCODE_GOOD;
     }
-    return retval;
+
+    /* The type is not below References. Only the type itself matches. */
+    set->bits = NULL;
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, root);
+    if(!node)
+        return UA_STATUSCODE_BADNOMATCH;
+    if(node->nodeClass != UA_NODECLASS_REFERENCETYPE)
+        return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
+    return UA_STATUSCODE_GOOD;
+}
+
+static void singleReferenceType(const UA_NodeId *referenceTypeId, ReferenceTypeSet *set) {
+    set->closures = NULL;
+    set->bits = NULL;
+    set->referenceTypeId = referenceTypeId;
+}
+
+static UA_Boolean inReferenceTypeSet(const ReferenceTypeSet *set, size_t number) {
+    return (set->bits[number / 32] & ((UA_UInt32)1 << (number % 32))) != 0;
+}
+
+static UA_Boolean
+isRelevantReferenceType(const ReferenceTypeSet *set, const UA_NodeId *referenceTypeId) {
+    if(!set->bits)
+        return UA_NodeId_equal(referenceTypeId, set->referenceTypeId);
+    size_t number = referenceTypeNumber(set->closures, referenceTypeId);
+    return number < set->closures->typesSize && inReferenceTypeSet(set, number);
 }
 
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
 static const UA_Node *
-returnRelevantNodeExternal(UA_ExternalNodeStore *ens, const UA_BrowseDescription *descr,
-                           const UA_ReferenceNode *reference) {
+returnRelevantNodeExternal(UA_Server *server, UA_ExternalNodeStore *ens,
+                           const UA_BrowseDescription *descr, const UA_ReferenceNode *reference) {
     /*	prepare a read request in the external nodestore	*/
     UA_ReadValueId *readValueIds = UA_Array_new(6,&UA_TYPES[UA_TYPES_READVALUEID]);
     UA_UInt32 *indices = UA_Array_new(6,&UA_TYPES[UA_TYPES_UINT32]);
@@ -58,7 +307,7 @@ returnRelevantNodeExternal(UA_ExternalNodeStore *ens, const UA_BrowseDescription
                    indicesSize, readNodesResults, false, diagnosticInfos);
 
     /* create and fill a dummy nodeStructure */
-    UA_Node *node = (UA_Node*) UA_NodeStore_newObjectNode();
+    UA_Node *node = (UA_Node*) UA_NodeStore_newObjectNode(server->nodestore);
     UA_NodeId_copy(&(reference->targetId.nodeId), &(node->nodeId));
     if(readNodesResults[0].status == UA_STATUSCODE_GOOD)
         UA_NodeClass_copy((UA_NodeClass*)readNodesResults[0].value.data, &(node->nodeClass));
@@ -77,7 +326,7 @@ returnRelevantNodeExternal(UA_ExternalNodeStore *ens, const UA_BrowseDescription
     UA_Array_delete(readNodesResults,6, &UA_TYPES[UA_TYPES_DATAVALUE]);
     UA_Array_delete(diagnosticInfos,6, &UA_TYPES[UA_TYPES_DIAGNOSTICINFO]);
     if(node && descr->nodeClassMask != 0 && (node->nodeClass & descr->nodeClassMask) == 0) {
-        UA_NodeStore_deleteNode(node);
+        UA_NodeStore_deleteNode(server->nodestore, node);
         return NULL;
     }
     return node;
@@ -85,10 +334,12 @@ returnRelevantNodeExternal(UA_ExternalNodeStore *ens, const UA_BrowseDescription
 #endif
 
 /* Tests if the node is relevant to the browse request and shall be returned. If
-   so, it is retrieved from the Nodestore. If not, null is returned. */
+   so, it is retrieved from the Nodestore. If not, null is returned. Without the
+   reference types (all references or checked by the caller), only the
+   direction is tested. */
 static const UA_Node *
-returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr, UA_Boolean return_all,
-                   const UA_ReferenceNode *reference, const UA_NodeId *relevant, size_t relevant_count,
+returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr,
+                   const ReferenceTypeSet *relevant, const UA_ReferenceNode *reference,
                    UA_Boolean *isExternal) {
     /* reference in the right direction? */
     if(reference->isInverse && descr->browseDirection == UA_BROWSEDIRECTION_FORWARD)
@@ -97,17 +348,8 @@ returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr, UA_Bool
         return NULL;
 
     /* is the reference part of the hierarchy of references we look for? */
-    if(!return_all) {
-        UA_Boolean is_relevant = false;
-        for(size_t i = 0; i < relevant_count; i++) {
-            if(UA_NodeId_equal(&reference->referenceTypeId, &relevant[i])) {
-                is_relevant = true;
-                break;
-            }
-        }
-        if(!is_relevant)
-            return NULL;
-    }
+    if(relevant && !isRelevantReferenceType(relevant, &reference->referenceTypeId))
+        return NULL;
 
 #ifdef UA_ENABLE_EXTERNAL_NAMESPACES
     /* return the node from an external namespace*/
@@ -115,7 +357,7 @@ returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr, UA_Bool
 		if(reference->targetId.nodeId.namespaceIndex != server->externalNamespaces[nsIndex].index)
 			continue;
         *isExternal = true;
-        return returnRelevantNodeExternal(&server->externalNamespaces[nsIndex].externalNodeStore,
+        return returnRelevantNodeExternal(server, &server->externalNamespaces[nsIndex].externalNodeStore,
                                           descr, reference);
     }
 #endif
@@ -128,68 +370,34 @@ returnRelevantNode(UA_Server *server, const UA_BrowseDescription *descr, UA_Bool
     return node;
 }
 
-/**
- * We find all subtypes by a single iteration over the array. We start with an array with a single
- * root nodeid at the beginning. When we find relevant references, we add the nodeids to the back of
- * the array and increase the size. Since the hierarchy is not cyclic, we can safely progress in the
- * array to process the newly found referencetype nodeids (emulated recursion).
- */
-static UA_StatusCode
-findSubTypes(UA_NodeStore *ns, const UA_NodeId *root, UA_NodeId **reftypes, size_t *reftypes_count) {
-    const UA_Node *node = UA_NodeStore_get(ns, root);
-    if(!node)
-        return UA_STATUSCODE_BADNOMATCH;
-    if(node->nodeClass != UA_NODECLASS_REFERENCETYPE)
-        return UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
-
-    size_t results_size = 20; // probably too big, but saves mallocs
-    UA_NodeId *results = UA_malloc(sizeof(UA_NodeId) * results_size);
-    if(!results)
-        return UA_STATUSCODE_BADOUTOFMEMORY;
-
-    UA_StatusCode retval = UA_NodeId_copy(root, &results[0]);
-    if(retval != UA_STATUSCODE_GOOD) {
-        UA_free(results);
-        return retval;
-    }
-        
-    size_t idx = 0; // where are we currently in the array?
-    size_t last = 0; // where is the last element in the array?
-    do {
-        node = UA_NodeStore_get(ns, &results[idx]);
-        if(!node || node->nodeClass != UA_NODECLASS_REFERENCETYPE)
-            continue;
-        for(size_t i = 0; i < node->referencesSize; i++) {
-            if(node->references[i].referenceTypeId.identifier.numeric != UA_NS0ID_HASSUBTYPE ||
-               node->references[i].isInverse == true)
-                continue;
-
-            if(++last >= results_size) { // is the array big enough?
-                UA_NodeId *new_results = UA_realloc(results, sizeof(UA_NodeId) * results_size * 2);
-                if(!new_results) {
-                    retval = UA_STATUSCODE_BADOUTOFMEMORY;
-                    break;
-                }
-                results = new_results;
-                results_size *= 2;
-            }
-
-            retval = UA_NodeId_copy(&node->references[i].targetId.nodeId, &results[last]);
-            if(retval != UA_STATUSCODE_GOOD) {
-                last--; // for array_delete
-                break;
-            }
-        }
-    } while(++idx <= last && retval == UA_STATUSCODE_GOOD);
-
-    if(retval != UA_STATUSCODE_GOOD) {
-        UA_Array_delete(results, last, &UA_TYPES[UA_TYPES_NODEID]);
-        return retval;
-    }
-
-    *reftypes = results;
-    *reftypes_count = last + 1;
-    return UA_STATUSCODE_GOOD;
+/* The relevant references of a node are looked up per reference type and
+   direction. The next reference is kept for every lookup. The smallest of them
+   is the next relevant reference in the order of the node. Nodes with less than
+   UA_BROWSE_MINREFSPERGROUP references per lookup are searched linearly. */
+#define UA_BROWSE_MINREFSPERGROUP 4
+
+typedef struct {
+    const UA_NodeId *referenceTypeId;
+    UA_Boolean isInverse;
+    size_t next;
+} RelevantReferences;
+
+/* Returns the next reference from the index on that may be relevant. Without
+   the reference types (rrSize == 0), all references are candidates. */
+static size_t
+nextRelevantReference(UA_NodeStore *ns, const UA_Node *node, RelevantReferences *rr,
+                      size_t rrSize, size_t from) {
+    if(rrSize == 0)
+        return from;
+    size_t min = node->referencesSize;
+    for(size_t i = 0; i < rrSize; i++) {
+        if(rr[i].next < from)
+            rr[i].next = UA_NodeStore_findReference(ns, node, rr[i].referenceTypeId,
+                                                    rr[i].isInverse, from, NULL);
+        if(rr[i].next < min)
+            min = rr[i].next;
+    }
+    return min;
 }
 
 static void removeCp(struct ContinuationPointEntry *cp, UA_Session* session) {
@@ -215,6 +423,8 @@ Service_Browse_single(UA_Server *server, UA_Session *session, struct Continuatio
                       const UA_BrowseDescription *descr, UA_UInt32 maxrefs, UA_BrowseResult *result) { 
     size_t referencesCount = 0;
     size_t referencesIndex = 0;
+    RelevantReferences *rr = NULL;
+    size_t rrSize = 0;
     /* set the browsedescription if a cp is given */
     UA_UInt32 continuationIndex = 0;
     if(cp) {
@@ -231,14 +441,12 @@ Service_Browse_single(UA_Server *server, UA_Session *session, struct Continuatio
         return;
     }
     
-    /* get the references that match the browsedescription */
-    size_t relevant_refs_size = 0;
-    UA_NodeId *relevant_refs = NULL;
+    /* get the reference types that match the browsedescription */
+    ReferenceTypeSet relevant;
     UA_Boolean all_refs = UA_NodeId_isNull(&descr->referenceTypeId);
     if(!all_refs) {
         if(descr->includeSubtypes) {
-            result->statusCode = findSubTypes(server->nodestore, &descr->referenceTypeId,
-                                              &relevant_refs, &relevant_refs_size);
+            result->statusCode = findSubTypes(server, &descr->referenceTypeId, &relevant);
             if(result->statusCode != UA_STATUSCODE_GOOD)
                 return;
         } else {
@@ -247,8 +455,7 @@ Service_Browse_single(UA_Server *server, UA_Session *session, struct Continuatio
                 result->statusCode = UA_STATUSCODE_BADREFERENCETYPEIDINVALID;
                 return;
             }
-            relevant_refs = (UA_NodeId*)(uintptr_t)&descr->referenceTypeId;
-            relevant_refs_size = 1;
+            singleReferenceType(&descr->referenceTypeId, &relevant);
         }
     }
 
@@ -256,16 +463,12 @@ Service_Browse_single(UA_Server *server, UA_Session *session, struct Continuatio
     const UA_Node *node = UA_NodeStore_get(server->nodestore, &descr->nodeId);
     if(!node) {
         result->statusCode = UA_STATUSCODE_BADNODEIDUNKNOWN;
-        if(!all_refs && descr->includeSubtypes)
-            UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
         return;
     }
 
     /* if the node has no references, just return */
     if(node->referencesSize <= 0) {
         result->referencesSize = 0;
-        if(!all_refs && descr->includeSubtypes)
-            UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
         return;
     }
 
@@ -283,15 +486,61 @@ Service_Browse_single(UA_Server *server, UA_Session *session, struct Continuatio
         goto cleanup;
     }
 
-    /* loop over the node's references */
+    /* look up the references of the relevant types in the browsed directions if
+       the node has enough references. otherwise test the type of every
+       reference. */
+    const ReferenceTypeSet *filter = NULL;
+    if(!all_refs) {
+        size_t directions = (descr->browseDirection == UA_BROWSEDIRECTION_BOTH) ? 2 : 1;
+        size_t types = relevant.bits ? relevant.closures->typesSize : 1;
+        size_t relevantTypes = 0;
+        for(size_t i = 0; i < types; i++) {
+            if(!relevant.bits || inReferenceTypeSet(&relevant, i))
+                relevantTypes++;
+        }
+        if(relevantTypes * directions * UA_BROWSE_MINREFSPERGROUP > node->referencesSize) {
+            filter = &relevant;
+        } else {
+            rr = UA_malloc(sizeof(RelevantReferences) * relevantTypes * directions);
+            if(!rr) {
+                UA_free(result->references);
+                result->references = NULL;
+                result->statusCode = UA_STATUSCODE_BADOUTOFMEMORY;
+                goto cleanup;
+            }
+        }
+        for(size_t i = 0; rr && i < types; i++) {
+            const UA_NodeId *referenceTypeId = relevant.referenceTypeId;
+            if(relevant.bits) {
+                if(!inReferenceTypeSet(&relevant, i))
+                    continue;
+                referenceTypeId = &relevant.closures->types[i];
+            }
+            for(size_t j = 0; j < 2; j++) {
+                UA_Boolean isInverse = (j == 1);
+                if((isInverse && descr->browseDirection == UA_BROWSEDIRECTION_FORWARD) ||
+                   (!isInverse && descr->browseDirection == UA_BROWSEDIRECTION_INVERSE))
+                    continue;
+                rr[rrSize].referenceTypeId = referenceTypeId;
+                rr[rrSize].isInverse = isInverse;
+                rr[rrSize].next = UA_NodeStore_findReference(server->nodestore, node, referenceTypeId,
+                                                             isInverse, 0, NULL);
+                rrSize++;
+            }
+        }
+    }
+
+    /* loop over the node's relevant references */
     size_t skipped = 0;
     UA_Boolean isExternal = false;
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    for(; referencesIndex < node->referencesSize && referencesCount < real_maxrefs; referencesIndex++) {
+    for(referencesIndex = nextRelevantReference(server->nodestore, node, rr, rrSize, 0);
+        referencesIndex < node->referencesSize && referencesCount < real_maxrefs;
+        referencesIndex = nextRelevantReference(server->nodestore, node, rr, rrSize,
+                                                referencesIndex + 1)) {
     	isExternal = false;
     	const UA_Node *current =
-            returnRelevantNode(server, descr, all_refs, &node->references[referencesIndex],
-                               relevant_refs, relevant_refs_size, &isExternal);
+            returnRelevantNode(server, descr, filter, &node->references[referencesIndex], &isExternal);
         if(!current)
             continue;
 
@@ -325,8 +574,7 @@ Service_Browse_single(UA_Server *server, UA_Session *session, struct Continuatio
     }
 
     cleanup:
-    if(!all_refs && descr->includeSubtypes)
-        UA_Array_delete(relevant_refs, relevant_refs_size, &UA_TYPES[UA_TYPES_NODEID]);
+    UA_free(rr);
     if(result->statusCode != UA_STATUSCODE_GOOD)
         return;
 
@@ -469,40 +717,27 @@ walkBrowsePath(UA_Server *server, UA_Session *session, const UA_Node *node, cons
                size_t *target_count) {
     const UA_RelativePathElement *elem = &path->elements[pathindex];
     UA_StatusCode retval = UA_STATUSCODE_GOOD;
-    UA_NodeId *reftypes = NULL;
-    size_t reftypes_count = 1; // all_refs or no subtypes => 1
+    ReferenceTypeSet reftypes;
     UA_Boolean all_refs = false;
     if(UA_NodeId_isNull(&elem->referenceTypeId))
         all_refs = true;
     else if(!elem->includeSubtypes)
-        reftypes = (UA_NodeId*)(uintptr_t)&elem->referenceTypeId; // ptr magic due to const cast
+        singleReferenceType(&elem->referenceTypeId, &reftypes);
     else {
-        retval = findSubTypes(server->nodestore, &elem->referenceTypeId, &reftypes, &reftypes_count);
+        retval = findSubTypes(server, &elem->referenceTypeId, &reftypes);
         if(retval != UA_STATUSCODE_GOOD)
             return retval;
     }
 
-    for(size_t i = 0; i < node->referencesSize && retval == UA_STATUSCODE_GOOD; i++) {
-        UA_Boolean match = all_refs;
-        for(size_t j = 0; j < reftypes_count && !match; j++) {
-            if(node->references[i].isInverse == elem->isInverse &&
-               UA_NodeId_equal(&node->references[i].referenceTypeId, &reftypes[j]))
-                match = true;
-        }
-        if(!match)
-            continue;
-
-        // get the node, todo: expandednodeid
-        const UA_Node *next = UA_NodeStore_get(server->nodestore, &node->references[i].targetId.nodeId);
-        if(!next)
+    // the nodestore finds the references with the browsename, todo: expandednodeid
+    const UA_Node *next;
+    for(size_t i = UA_NodeStore_findChild(server->nodestore, node, &elem->targetName, 0, &next);
+        i < node->referencesSize && retval == UA_STATUSCODE_GOOD;
+        i = UA_NodeStore_findChild(server->nodestore, node, &elem->targetName, i + 1, &next)) {
+        if(!all_refs && (node->references[i].isInverse != elem->isInverse ||
+                         !isRelevantReferenceType(&reftypes, &node->references[i].referenceTypeId)))
             continue;
 
-        // test the browsename
-        if(elem->targetName.namespaceIndex != next->browseName.namespaceIndex ||
-           !UA_String_equal(&elem->targetName.name, &next->browseName.name)) {
-            continue;
-        }
-
         if(pathindex + 1 < path->elementsSize) {
             // recursion if the path is longer
             retval = walkBrowsePath(server, session, next, path, pathindex + 1,
@@ -530,8 +765,6 @@ walkBrowsePath(UA_Server *server, UA_Session *session, const UA_Node *node, cons
         }
     }
 
-    if(!all_refs && elem->includeSubtypes)
-        UA_Array_delete(reftypes, reftypes_count, &UA_TYPES[UA_TYPES_NODEID]);
     return retval;
 }
 
@@ -13,7 +13,7 @@ UA_Subscription *UA_Subscription_new(UA_UInt32 subscriptionID) {
     new->subscriptionID = subscriptionID;
     new->lastPublished  = 0;
     new->sequenceNumber = 1;
-    memset(&new->timedUpdateJobGuid, 0, sizeof(UA_Guid));
+    new->timedUpdateJobHandle    = NULL;
     new->timedUpdateJob          = NULL;
     new->timedUpdateIsRegistered = false;
     LIST_INIT(&new->MonitoredItems);
@@ -215,7 +215,7 @@ static void Subscription_timedUpdateNotificationsJob(UA_Server *server, void *da
     Subscription_updateNotifications(sub);
 }
 
-UA_StatusCode Subscription_createdUpdateJob(UA_Server *server, UA_Guid jobId, UA_Subscription *sub) {
+UA_StatusCode Subscription_createdUpdateJob(UA_Server *server, UA_Subscription *sub) {
     if(server == NULL || sub == NULL)
         return UA_STATUSCODE_BADSERVERINDEXINVALID;
         
@@ -224,11 +224,10 @@ UA_StatusCode Subscription_createdUpdateJob(UA_Server *server, UA_Guid jobId, UA
     if(!theWork)
         return UA_STATUSCODE_BADOUTOFMEMORY;
     
-   *theWork = (UA_Job) {.type = UA_JOBTYPE_METHODCALL,
+   *theWork = (UA_Job) {.type = UA_JOBTYPE_METHODCALL, .priority = UA_JOBPRIORITY_REALTIME,
                         .job.methodCall = {.method = Subscription_timedUpdateNotificationsJob, .data = sub} };
    
-   sub->timedUpdateJobGuid = jobId;
-   sub->timedUpdateJob     = theWork;
+   sub->timedUpdateJob = theWork;
    
    return UA_STATUSCODE_GOOD;
 }
@@ -239,17 +238,21 @@ UA_StatusCode Subscription_registerUpdateJob(UA_Server *server, UA_Subscription
     
     /* Practically enough, the client sends a uint32 in ms, which we store as
        datetime, which here is required in as uint32 in ms as the interval */
-    UA_StatusCode retval = UA_Server_addRepeatedJob(server, *sub->timedUpdateJob,
-                                                    (UA_UInt32)sub->publishingInterval,
-                                                    &sub->timedUpdateJobGuid);
+    UA_StatusCode retval = UA_Server_addRepeatedJobHandle(server, *sub->timedUpdateJob,
+                                                          (UA_UInt32)sub->publishingInterval,
+                                                          &sub->timedUpdateJobHandle);
     if(retval == UA_STATUSCODE_GOOD)
         sub->timedUpdateIsRegistered = true;
     return retval;
 }
 
 UA_StatusCode Subscription_unregisterUpdateJob(UA_Server *server, UA_Subscription *sub) {
+    if(!sub->timedUpdateIsRegistered)
+        return UA_STATUSCODE_GOOD;
     sub->timedUpdateIsRegistered = false;
-    return UA_Server_removeRepeatedJob(server, sub->timedUpdateJobGuid);
+    UA_RepeatedJob *handle = sub->timedUpdateJobHandle;
+    sub->timedUpdateJobHandle = NULL;
+    return UA_Server_removeRepeatedJobHandle(server, handle);
 }
 
 /*****************/
@@ -373,7 +376,7 @@ UA_Boolean MonitoredItem_CopyMonitoredValueToVariant(UA_UInt32 attributeID, cons
                 if(vsrc->value.variant.callback.onRead)
                     vsrc->value.variant.callback.onRead(vsrc->value.variant.callback.handle, vsrc->nodeId,
                                                         &dst->value, NULL);
-                UA_Variant_copy(&vsrc->value.variant.value, &dst->value);
+                UA_Variant_copy(UA_VariableNode_getValue(vsrc), &dst->value);
                 dst->hasValue = true;
                 samplingError = false;
             } else {
@@ -17,6 +17,7 @@ void UA_Connection_init(UA_Connection *connection) {
     connection->sockfd = 0;
     connection->handle = NULL;
     UA_ByteString_init(&connection->incompleteMessage);
+    connection->chunkedRequestsSize = 0;
     connection->send = NULL;
     connection->close = NULL;
     connection->recv = NULL;
@@ -49,6 +49,8 @@ UA_String UA_String_fromChars(char const src[]) {
 UA_Boolean UA_String_equal(const UA_String *string1, const UA_String *string2) {
     if(string1->length != string2->length)
         return false;
+    if(string1->data == string2->data)
+        return true; // e.g. interned strings in the nodestore
     UA_Int32 is = memcmp((char const*)string1->data, (char const*)string2->data, string1->length);
     return (is == 0) ? true : false;
 }
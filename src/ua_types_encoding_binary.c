@@ -515,14 +515,15 @@ NodeId_encodeBinary(UA_NodeId const *src, bufpos pos, bufend end) {
     return retval;
 }
 
+/* The flags of expandednodeids in the encoding byte are masked out */
 static UA_StatusCode
-NodeId_decodeBinary(bufpos pos, bufend end, UA_NodeId *dst) {
+NodeId_decodeBinaryMasked(bufpos pos, bufend end, UA_NodeId *dst, UA_Byte mask) {
     UA_Byte dstByte = 0, encodingByte = 0;
     UA_UInt16 dstUInt16 = 0;
     UA_StatusCode retval = Byte_decodeBinary(pos, end, &encodingByte);
     if(retval != UA_STATUSCODE_GOOD)
         return retval;
-    switch (encodingByte) {
+    switch (encodingByte & (UA_Byte)~mask) {
     case UA_NODEIDTYPE_NUMERIC_TWOBYTE:
         dst->identifierType = UA_NODEIDTYPE_NUMERIC;
         retval = Byte_decodeBinary(pos, end, &dstByte);
@@ -565,6 +566,11 @@ NodeId_decodeBinary(bufpos pos, bufend end, UA_NodeId *dst) {
     return retval;
 }
 
+static UA_StatusCode
+NodeId_decodeBinary(bufpos pos, bufend end, UA_NodeId *dst) {
+    return NodeId_decodeBinaryMasked(pos, end, dst, 0);
+}
+
 /* ExpandedNodeId */
 #define UA_EXPANDEDNODEID_NAMESPACEURI_FLAG 0x80
 #define UA_EXPANDEDNODEID_SERVERINDEX_FLAG 0x40
@@ -589,8 +595,9 @@ ExpandedNodeId_decodeBinary(bufpos pos, bufend end, UA_ExpandedNodeId *dst) {
     if(*pos >= end)
         return UA_STATUSCODE_BADDECODINGERROR;
     UA_Byte encodingByte = **pos;
-    **pos = encodingByte & (UA_Byte)~(UA_EXPANDEDNODEID_NAMESPACEURI_FLAG | UA_EXPANDEDNODEID_SERVERINDEX_FLAG);
-    UA_StatusCode retval = NodeId_decodeBinary(pos, end, &dst->nodeId);
+    UA_StatusCode retval = NodeId_decodeBinaryMasked(pos, end, &dst->nodeId,
+                                                     UA_EXPANDEDNODEID_NAMESPACEURI_FLAG |
+                                                     UA_EXPANDEDNODEID_SERVERINDEX_FLAG);
     if(encodingByte & UA_EXPANDEDNODEID_NAMESPACEURI_FLAG) {
         dst->nodeId.namespaceIndex = 0;
         retval |= String_decodeBinary(pos, end, &dst->namespaceUri);
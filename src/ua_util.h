@@ -47,6 +47,14 @@
 #define container_of(ptr, type, member) \
     (type *)((uintptr_t)ptr - offsetof(type,member))
 
+/* Hint to load the cache line of addr for reading. Does nothing on compilers
+   without a prefetch builtin. */
+#ifdef __GNUC__
+# define UA_prefetch(addr) __builtin_prefetch(addr)
+#else
+# define UA_prefetch(addr)
+#endif
+
 /************************/
 /* Thread Local Storage */
 /************************/
@@ -114,7 +122,7 @@ int gettimeofday(struct timeval *tp, struct timezone *tzp);
 #   define UA_RCU_UNLOCK() do {                   \
         UA_ASSERT_RCU_LOCKED();                   \
         rcu_locked = false;                       \
-        rcu_read_lock(); } while(0)
+        rcu_read_unlock(); } while(0)
 # endif
 #else
 # define UA_RCU_LOCK()
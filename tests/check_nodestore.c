@@ -23,8 +23,8 @@ static void printVisitor(const UA_Node* node) {
 	printf("%d\n", node->nodeId.identifier.numeric);
 }
 
-static UA_Node* createNode(UA_Int16 nsid, UA_Int32 id) {
-	UA_Node *p = (UA_Node *)UA_NodeStore_newVariableNode();
+static UA_Node* createNode(UA_NodeStore *ns, UA_Int16 nsid, UA_Int32 id) {
+	UA_Node *p = (UA_Node *)UA_NodeStore_newVariableNode(ns);
 	p->nodeId.identifierType = UA_NODEIDTYPE_NUMERIC;
 	p->nodeId.namespaceIndex = nsid;
 	p->nodeId.identifier.numeric = id;
@@ -33,8 +33,12 @@ static UA_Node* createNode(UA_Int16 nsid, UA_Int32 id) {
 }
 
 START_TEST(replaceExistingNode) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+	UA_RCU_LOCK();
+#endif
 	UA_NodeStore *ns = UA_NodeStore_new();
-	UA_Node* n1 = createNode(0,2253);
+	UA_Node* n1 = createNode(ns, 0,2253);
 	UA_NodeStore_insert(ns, n1);
     UA_NodeId in1 = UA_NODEID_NUMERIC(0, 2253);
 	UA_Node* n2 = UA_NodeStore_getCopy(ns, &in1);
@@ -43,12 +47,20 @@ START_TEST(replaceExistingNode) {
 	ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
     
 	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
+	rcu_unregister_thread();
+#endif
 }
 END_TEST
 
 START_TEST(replaceOldNode) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+	UA_RCU_LOCK();
+#endif
 	UA_NodeStore *ns = UA_NodeStore_new();
-	UA_Node* n1 = createNode(0,2253);
+	UA_Node* n1 = createNode(ns, 0,2253);
 	UA_NodeStore_insert(ns, n1);
     UA_NodeId in1 = UA_NODEID_NUMERIC(0,2253);
 	UA_Node* n2 = UA_NodeStore_getCopy(ns, &in1);
@@ -63,16 +75,21 @@ START_TEST(replaceOldNode) {
 	ck_assert_int_ne(retval, UA_STATUSCODE_GOOD);
     
 	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
+	rcu_unregister_thread();
+#endif
 }
 END_TEST
 
 START_TEST(findNodeInUA_NodeStoreWithSingleEntry) {
 #ifdef UA_ENABLE_MULTITHREADING
    	rcu_register_thread();
+	UA_RCU_LOCK();
 #endif
 	// given
 	UA_NodeStore *ns = UA_NodeStore_new();
-	UA_Node* n1 = createNode(0,2253);
+	UA_Node* n1 = createNode(ns, 0,2253);
 	UA_NodeStore_insert(ns, n1);
     UA_NodeId in1 = UA_NODEID_NUMERIC(0,2253);
 	const UA_Node* nr = UA_NodeStore_get(ns, &in1);
@@ -81,6 +98,7 @@ START_TEST(findNodeInUA_NodeStoreWithSingleEntry) {
 	// finally
 	UA_NodeStore_delete(ns);
 #ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
 	rcu_unregister_thread();
 #endif
 }
@@ -89,11 +107,12 @@ END_TEST
 START_TEST(failToFindNodeInOtherUA_NodeStore) {
 #ifdef UA_ENABLE_MULTITHREADING
    	rcu_register_thread();
+	UA_RCU_LOCK();
 #endif
 	// given
 	UA_NodeStore *ns = UA_NodeStore_new();
 
-	UA_Node* n1 = createNode(0,2255);
+	UA_Node* n1 = createNode(ns, 0,2255);
     UA_NodeStore_insert(ns, n1);
 
 	// when
@@ -104,6 +123,7 @@ START_TEST(failToFindNodeInOtherUA_NodeStore) {
 	// finally
 	UA_NodeStore_delete(ns);
 #ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
 	rcu_unregister_thread();
 #endif
 }
@@ -112,20 +132,21 @@ END_TEST
 START_TEST(findNodeInUA_NodeStoreWithSeveralEntries) {
 #ifdef UA_ENABLE_MULTITHREADING
    	rcu_register_thread();
+	UA_RCU_LOCK();
 #endif
 	// given
 	UA_NodeStore *ns = UA_NodeStore_new();
-	UA_Node* n1 = createNode(0,2253);
+	UA_Node* n1 = createNode(ns, 0,2253);
     UA_NodeStore_insert(ns, n1);
-	UA_Node* n2 = createNode(0,2255);
+	UA_Node* n2 = createNode(ns, 0,2255);
     UA_NodeStore_insert(ns, n2);
-	UA_Node* n3 = createNode(0,2257);
+	UA_Node* n3 = createNode(ns, 0,2257);
     UA_NodeStore_insert(ns, n3);
-	UA_Node* n4 = createNode(0,2200);
+	UA_Node* n4 = createNode(ns, 0,2200);
     UA_NodeStore_insert(ns, n4);
-	UA_Node* n5 = createNode(0,1);
+	UA_Node* n5 = createNode(ns, 0,1);
     UA_NodeStore_insert(ns, n5);
-	UA_Node* n6 = createNode(0,12);
+	UA_Node* n6 = createNode(ns, 0,12);
     UA_NodeStore_insert(ns, n6);
 
 	// when
@@ -136,6 +157,7 @@ START_TEST(findNodeInUA_NodeStoreWithSeveralEntries) {
 	// finally
 	UA_NodeStore_delete(ns);
 #ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
 	rcu_unregister_thread();
 #endif
 }
@@ -144,20 +166,21 @@ END_TEST
 START_TEST(iterateOverUA_NodeStoreShallNotVisitEmptyNodes) {
 #ifdef UA_ENABLE_MULTITHREADING
    	rcu_register_thread();
+	UA_RCU_LOCK();
 #endif
 	// given
 	UA_NodeStore *ns = UA_NodeStore_new();
-	UA_Node* n1 = createNode(0,2253);
+	UA_Node* n1 = createNode(ns, 0,2253);
     UA_NodeStore_insert(ns, n1);
-	UA_Node* n2 = createNode(0,2255);
+	UA_Node* n2 = createNode(ns, 0,2255);
     UA_NodeStore_insert(ns, n2);
-	UA_Node* n3 = createNode(0,2257);
+	UA_Node* n3 = createNode(ns, 0,2257);
     UA_NodeStore_insert(ns, n3);
-	UA_Node* n4 = createNode(0,2200);
+	UA_Node* n4 = createNode(ns, 0,2200);
     UA_NodeStore_insert(ns, n4);
-	UA_Node* n5 = createNode(0,1);
+	UA_Node* n5 = createNode(ns, 0,1);
     UA_NodeStore_insert(ns, n5);
-	UA_Node* n6 = createNode(0,12);
+	UA_Node* n6 = createNode(ns, 0,12);
     UA_NodeStore_insert(ns, n6);
 
 	// when
@@ -170,6 +193,7 @@ START_TEST(iterateOverUA_NodeStoreShallNotVisitEmptyNodes) {
 	// finally
 	UA_NodeStore_delete(ns);
 #ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
 	rcu_unregister_thread();
 #endif
 }
@@ -178,24 +202,26 @@ END_TEST
 START_TEST(findNodeInExpandedNamespace) {
 #ifdef UA_ENABLE_MULTITHREADING
    	rcu_register_thread();
+	UA_RCU_LOCK();
 #endif
 	// given
 	UA_NodeStore *ns = UA_NodeStore_new();
 	UA_Node* n;
 	UA_Int32 i=0;
 	for (; i<200; i++) {
-		n = createNode(0,i);
+		n = createNode(ns, 0,i);
         UA_NodeStore_insert(ns, n);
 	}
 	// when
-	UA_Node *n2 = createNode(0,25);
+	UA_Node *n2 = createNode(ns, 0,25);
 	const UA_Node* nr = UA_NodeStore_get(ns,&n2->nodeId);
 	// then
 	ck_assert_int_eq(nr->nodeId.identifier.numeric,n2->nodeId.identifier.numeric);
 	// finally
-    UA_NodeStore_deleteNode(n2);
+    UA_NodeStore_deleteNode(ns, n2);
 	UA_NodeStore_delete(ns);
 #ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
 	rcu_unregister_thread();
 #endif
 }
@@ -204,13 +230,14 @@ END_TEST
 START_TEST(iterateOverExpandedNamespaceShallNotVisitEmptyNodes) {
 #ifdef UA_ENABLE_MULTITHREADING
    	rcu_register_thread();
+	UA_RCU_LOCK();
 #endif
 	// given
 	UA_NodeStore *ns = UA_NodeStore_new();
     UA_Node* n;
 	UA_Int32 i=0;
 	for (; i<200; i++) {
-		n = createNode(0,i);
+		n = createNode(ns, 0,i);
         UA_NodeStore_insert(ns, n);
 	}
 	// when
@@ -223,6 +250,110 @@ START_TEST(iterateOverExpandedNamespaceShallNotVisitEmptyNodes) {
 	// finally
 	UA_NodeStore_delete(ns);
 #ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
+/* 200 nodes in the dense range of namespace 0 and 100 sparse nodes in the
+   hash-map. Every node is counted at its position in the array. */
+typedef struct {
+	int visits[300];
+	int visited;
+	UA_UInt32 stopAt;
+} CursorVisits;
+
+static UA_StatusCode countCursorVisit(const UA_Node *node, void *handle) {
+	CursorVisits *v = (CursorVisits*)handle;
+	UA_UInt32 id = node->nodeId.identifier.numeric;
+	size_t i = node->nodeId.namespaceIndex == 0 ? id - 1 : 200 + (id - 100000) / 1000;
+	if (i >= 300)
+		return UA_STATUSCODE_BADINTERNALERROR;
+	v->visits[i]++;
+	v->visited++;
+	if (id == v->stopAt)
+		return UA_STATUSCODE_BADNOMATCH;
+	return UA_STATUSCODE_GOOD;
+}
+
+static UA_NodeStore * createCursorNodeStore(void) {
+	UA_NodeStore *ns = UA_NodeStore_new();
+	for (UA_Int32 i = 1; i <= 200; i++)
+		UA_NodeStore_insert(ns, createNode(ns, 0, i));
+	for (UA_Int32 i = 0; i < 100; i++)
+		UA_NodeStore_insert(ns, createNode(ns, 1, 100000 + i * 1000));
+	return ns;
+}
+
+START_TEST(iterateInStepsWithCursor) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+	UA_RCU_LOCK();
+#endif
+	// given
+	UA_NodeStore *ns = createCursorNodeStore();
+	CursorVisits v;
+	memset(&v, 0, sizeof(CursorVisits));
+	v.stopAt = UA_UINT32_MAX;
+	// when
+	UA_NodeStoreCursor cursor;
+	UA_NodeStoreCursor_init(&cursor);
+	int steps = 0;
+	while (!cursor.done) {
+		int before = v.visited;
+		ck_assert_int_eq(UA_NodeStore_iterateCursor(ns, &cursor, 7, countCursorVisit, &v),
+		                 UA_STATUSCODE_GOOD);
+		ck_assert_int_le(v.visited - before, 7);
+		steps++;
+	}
+	UA_NodeStoreCursor_deleteMembers(&cursor);
+	// then
+	ck_assert_int_eq(v.visited, 300);
+	ck_assert_int_ge(steps, 300 / 7);
+	for (int i = 0; i < 300; i++)
+		ck_assert_int_eq(v.visits[i], 1);
+	// finally
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
+START_TEST(stopAndResumeCursor) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+	UA_RCU_LOCK();
+#endif
+	// given
+	UA_NodeStore *ns = createCursorNodeStore();
+	CursorVisits v;
+	memset(&v, 0, sizeof(CursorVisits));
+	v.stopAt = 150000;
+	// when
+	UA_NodeStoreCursor cursor;
+	UA_NodeStoreCursor_init(&cursor);
+	UA_StatusCode retval = UA_NodeStore_iterateCursor(ns, &cursor, 0, countCursorVisit, &v);
+	// then
+	ck_assert_int_eq(retval, UA_STATUSCODE_BADNOMATCH);
+	ck_assert_int_eq(v.visits[250], 1);
+	ck_assert_int_lt(v.visited, 300);
+	ck_assert(!cursor.done);
+	// when
+	retval = UA_NodeStore_iterateCursor(ns, &cursor, 0, countCursorVisit, &v);
+	// then
+	ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+	ck_assert(cursor.done);
+	ck_assert_int_eq(v.visited, 300);
+	for (int i = 0; i < 300; i++)
+		ck_assert_int_eq(v.visits[i], 1);
+	// finally
+	UA_NodeStoreCursor_deleteMembers(&cursor);
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
 	rcu_unregister_thread();
 #endif
 }
@@ -231,18 +362,19 @@ END_TEST
 START_TEST(failToFindNonExistantNodeInUA_NodeStoreWithSeveralEntries) {
 #ifdef UA_ENABLE_MULTITHREADING
    	rcu_register_thread();
+	UA_RCU_LOCK();
 #endif
 	// given
 	UA_NodeStore *ns = UA_NodeStore_new();
-	UA_Node* n1 = createNode(0,2253);
+	UA_Node* n1 = createNode(ns, 0,2253);
     UA_NodeStore_insert(ns, n1);
-	UA_Node* n2 = createNode(0,2255);
+	UA_Node* n2 = createNode(ns, 0,2255);
     UA_NodeStore_insert(ns, n2);
-	UA_Node* n3 = createNode(0,2257);
+	UA_Node* n3 = createNode(ns, 0,2257);
     UA_NodeStore_insert(ns, n3);
-	UA_Node* n4 = createNode(0,2200);
+	UA_Node* n4 = createNode(ns, 0,2200);
     UA_NodeStore_insert(ns, n4);
-	UA_Node* n5 = createNode(0,1);
+	UA_Node* n5 = createNode(ns, 0,1);
     UA_NodeStore_insert(ns, n5);
 
     UA_NodeId id = UA_NODEID_NUMERIC(0, 12);
@@ -254,11 +386,750 @@ START_TEST(failToFindNonExistantNodeInUA_NodeStoreWithSeveralEntries) {
 	// finally
 	UA_NodeStore_delete(ns);
 #ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
 	rcu_unregister_thread();
 #endif
 }
 END_TEST
 
+START_TEST(removeFromExpandedNamespace) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+	UA_RCU_LOCK();
+#endif
+	// given
+	UA_NodeStore *ns = UA_NodeStore_new();
+	for (UA_Int32 i = 1; i <= 2000; i++)
+		UA_NodeStore_insert(ns, createNode(ns, 1,i));
+	// when
+	for (UA_Int32 i = 1; i <= 2000; i += 2) {
+		UA_NodeId id = UA_NODEID_NUMERIC(1, i);
+		ck_assert_int_eq(UA_NodeStore_remove(ns, &id), UA_STATUSCODE_GOOD);
+	}
+	// then
+	for (UA_Int32 i = 1; i <= 2000; i++) {
+		UA_NodeId id = UA_NODEID_NUMERIC(1, i);
+		const UA_Node *nr = UA_NodeStore_get(ns, &id);
+		if (i % 2 == 0)
+			ck_assert_int_eq(nr->nodeId.identifier.numeric, i);
+		else
+			ck_assert_int_eq((uintptr_t)nr, 0);
+	}
+	zeroCnt = 0;
+	visitCnt = 0;
+	UA_NodeStore_iterate(ns,checkZeroVisitor);
+	ck_assert_int_eq(visitCnt, 1000);
+	// shrink to the minimum size and refill
+	for (UA_Int32 i = 2; i <= 2000; i += 2) {
+		UA_NodeId id = UA_NODEID_NUMERIC(1, i);
+		ck_assert_int_eq(UA_NodeStore_remove(ns, &id), UA_STATUSCODE_GOOD);
+	}
+	visitCnt = 0;
+	UA_NodeStore_iterate(ns,checkZeroVisitor);
+	ck_assert_int_eq(visitCnt, 0);
+	for (UA_Int32 i = 1; i <= 100; i++)
+		ck_assert_int_eq(UA_NodeStore_insert(ns, createNode(ns, 1,i)), UA_STATUSCODE_GOOD);
+	UA_NodeId in1 = UA_NODEID_NUMERIC(1, 99);
+	ck_assert_int_eq(UA_NodeStore_get(ns, &in1)->nodeId.identifier.numeric, 99);
+	// finally
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
+START_TEST(findNodesInDenseAndSparseRanges) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+	UA_RCU_LOCK();
+#endif
+	// given: sparse identifiers first, the dense range grows later
+	UA_NodeStore *ns = UA_NodeStore_new();
+	for (UA_Int32 i = 5000; i > 0; i--)
+		ck_assert_int_eq(UA_NodeStore_insert(ns, createNode(ns, 1,i)), UA_STATUSCODE_GOOD);
+	for (UA_Int32 i = 1; i <= 100; i++)
+		ck_assert_int_eq(UA_NodeStore_insert(ns, createNode(ns, 2,i * 100000)), UA_STATUSCODE_GOOD);
+	ck_assert_int_eq(UA_NodeStore_insert(ns, createNode(ns, 1,4000)), UA_STATUSCODE_BADNODEIDEXISTS);
+	// when
+	for (UA_Int32 i = 1; i <= 5000; i += 3) {
+		UA_NodeId id = UA_NODEID_NUMERIC(1, i);
+		ck_assert_int_eq(UA_NodeStore_remove(ns, &id), UA_STATUSCODE_GOOD);
+	}
+	// then
+	for (UA_Int32 i = 1; i <= 5000; i++) {
+		UA_NodeId id = UA_NODEID_NUMERIC(1, i);
+		const UA_Node *nr = UA_NodeStore_get(ns, &id);
+		if (i % 3 == 1)
+			ck_assert_int_eq((uintptr_t)nr, 0);
+		else
+			ck_assert_int_eq(nr->nodeId.identifier.numeric, i);
+	}
+	UA_NodeId in1 = UA_NODEID_NUMERIC(2, 4200000);
+	ck_assert_int_eq(UA_NodeStore_get(ns, &in1)->nodeId.namespaceIndex, 2);
+	UA_NodeId in2 = UA_NODEID_NUMERIC(0, 4200000);
+	ck_assert_int_eq((uintptr_t)UA_NodeStore_get(ns, &in2), 0);
+	zeroCnt = 0;
+	visitCnt = 0;
+	UA_NodeStore_iterate(ns,checkZeroVisitor);
+	ck_assert_int_eq(visitCnt, 3333 + 100);
+	// finally
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
+START_TEST(getBatchOfNodes) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+	UA_RCU_LOCK();
+#endif
+	// given: dense, sparse and string nodeids
+	UA_NodeStore *ns = UA_NodeStore_new();
+	char name[32];
+	for (UA_Int32 i = 1; i <= 500; i++) {
+		UA_Node *n = createNode(ns, 1,i);
+		if (i % 5 == 0)
+			n->nodeId.identifier.numeric = (UA_UInt32)i * 100000;
+		if (i % 7 == 0) {
+			snprintf(name, sizeof(name), "Node%d", i);
+			n->nodeId = UA_NODEID_STRING_ALLOC(2, name);
+		}
+		ck_assert_int_eq(UA_NodeStore_insert(ns, n), UA_STATUSCODE_GOOD);
+	}
+	// when: a batch that is not a multiple of the chunk size, every third id misses
+	UA_NodeId ids[601];
+	const UA_Node *nodes[601];
+	for (UA_Int32 i = 0; i < 601; i++) {
+		UA_Int32 j = i % 500 + 1;
+		UA_UInt16 nsIndex = (UA_UInt16)(i % 3 == 2 ? 3 : 1);
+		if (j % 7 == 0) {
+			snprintf(name, sizeof(name), "Node%d", j);
+			ids[i] = UA_NODEID_STRING_ALLOC((UA_UInt16)(nsIndex + 1), name);
+		} else if (j % 5 == 0)
+			ids[i] = UA_NODEID_NUMERIC(nsIndex, (UA_UInt32)j * 100000);
+		else
+			ids[i] = UA_NODEID_NUMERIC(nsIndex, (UA_UInt32)j);
+	}
+	UA_NodeStore_getBatch(ns, ids, 601, nodes);
+	// then
+	for (UA_Int32 i = 0; i < 601; i++) {
+		ck_assert_int_eq((uintptr_t)nodes[i], (uintptr_t)UA_NodeStore_get(ns, &ids[i]));
+		if (i % 3 == 2)
+			ck_assert_int_eq((uintptr_t)nodes[i], 0);
+		else
+			ck_assert(UA_NodeId_equal(&nodes[i]->nodeId, &ids[i]));
+	}
+	// finally
+	for (UA_Int32 i = 0; i < 601; i++)
+		UA_NodeId_deleteMembers(&ids[i]);
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
+#ifndef UA_ENABLE_MULTITHREADING
+
+#ifdef __GLIBC__
+#include <malloc.h>
+static size_t heapInUse(void) {
+# if __GLIBC_PREREQ(2, 33)
+	return mallinfo2().uordblks;
+# else
+	return (size_t)mallinfo().uordblks;
+# endif
+}
+#else
+static size_t heapInUse(void) { return 0; } // not measured
+#endif
+
+#define FOOTPRINT_NODES 10000
+
+static UA_Node* createNamedNode(UA_NodeStore *ns, UA_Int32 i) {
+	UA_Node *n = createNode(ns, 1, i + 1);
+	char name[32];
+	if(i % 4 == 0) {
+		sprintf(name, "Device%d.Value", i);
+		n->nodeId = UA_NODEID_STRING_ALLOC(2, name);
+	}
+	sprintf(name, "Node%d", i);
+	n->browseName = UA_QUALIFIEDNAME_ALLOC(1, name);
+	n->displayName = UA_LOCALIZEDTEXT_ALLOC("en", name);
+	n->description = UA_LOCALIZEDTEXT_ALLOC("en", "A node with references");
+	n->referencesSize = 2;
+	n->references = UA_Array_new(2, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+	n->references[0].referenceTypeId = UA_NODEID_NUMERIC(0, 47); // HasComponent
+	n->references[0].isInverse = true;
+	n->references[0].targetId = UA_EXPANDEDNODEID_NUMERIC(1, (UA_UInt32)i / 10 + 1);
+	n->references[1].referenceTypeId = UA_NODEID_NUMERIC(0, 40); // HasTypeDefinition
+	n->references[1].targetId = UA_EXPANDEDNODEID_STRING_ALLOC(2, "DeviceType");
+	return n;
+}
+
+START_TEST(packNodesIntoArena) {
+	size_t before = heapInUse();
+	UA_NodeStore *ns = UA_NodeStore_new();
+	for(UA_Int32 i = 0; i < FOOTPRINT_NODES; i++)
+		UA_NodeStore_insert(ns, createNamedNode(ns, i));
+	size_t unpacked = heapInUse() - before;
+	ck_assert_int_eq(UA_NodeStore_pack(ns), UA_STATUSCODE_GOOD);
+	size_t packed = heapInUse() - before;
+	printf("Footprint of %d nodes: %lu bytes on the heap, %lu bytes packed\n",
+	       FOOTPRINT_NODES, (unsigned long)unpacked, (unsigned long)packed);
+	if(unpacked > 0)
+		ck_assert(packed < unpacked);
+
+	/* The packed nodes are unchanged */
+	UA_NodeId id = UA_NODEID_STRING(2, "Device40.Value");
+	const UA_Node *n = UA_NodeStore_get(ns, &id);
+	ck_assert_ptr_ne(n, NULL);
+	UA_String name = UA_STRING("Node40");
+	ck_assert(UA_String_equal(&n->browseName.name, &name));
+	ck_assert_int_eq(n->referencesSize, 2);
+	UA_NodeId target = UA_NODEID_STRING(2, "DeviceType");
+	ck_assert(UA_NodeId_equal(&n->references[1].targetId.nodeId, &target));
+
+	/* Unpack a node before it is edited in place */
+	UA_Node *edit = (UA_Node*)(uintptr_t)n;
+	ck_assert_int_eq(UA_NodeStore_unpack(ns, edit), UA_STATUSCODE_GOOD);
+	UA_LocalizedText_deleteMembers(&edit->displayName);
+	edit->displayName = UA_LOCALIZEDTEXT_ALLOC("de", "Knoten");
+	UA_Array_delete(edit->references, edit->referencesSize, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+	edit->references = NULL;
+	edit->referencesSize = 0;
+	ck_assert(UA_String_equal(&UA_NodeStore_get(ns, &id)->browseName.name, &name));
+
+	/* Packed nodes can be replaced and removed */
+	UA_NodeId id2 = UA_NODEID_NUMERIC(1, 42);
+	UA_Node *copy = UA_NodeStore_getCopy(ns, &id2);
+	ck_assert_int_eq(UA_NodeStore_replace(ns, copy), UA_STATUSCODE_GOOD);
+	ck_assert_int_eq(UA_NodeStore_remove(ns, &id2), UA_STATUSCODE_GOOD);
+	UA_NodeId id3 = UA_NODEID_STRING(2, "Device80.Value");
+	ck_assert_int_eq(UA_NodeStore_remove(ns, &id3), UA_STATUSCODE_GOOD);
+
+	/* Nodes inserted later are packed into another block */
+	UA_NodeStore_insert(ns, createNamedNode(ns, FOOTPRINT_NODES));
+	ck_assert_int_eq(UA_NodeStore_pack(ns), UA_STATUSCODE_GOOD);
+	UA_NodeStore_delete(ns);
+}
+END_TEST
+
+/* The variables of an instance of a device type. The browsenames, the texts
+   and the type repeat for every device. */
+static const char *instanceVariables[4] = {"Temperature", "Pressure", "Status", "Serial"};
+
+static UA_Node* createInstanceNode(UA_NodeStore *ns, UA_Int32 i) {
+	UA_Node *n = (UA_Node*)UA_NodeStore_newVariableNode(ns);
+	const char *variable = instanceVariables[i % 4];
+	char name[48];
+	sprintf(name, "Device%d.%s", i / 4, variable);
+	n->nodeId = UA_NODEID_STRING_ALLOC(2, name);
+	n->browseName = UA_QUALIFIEDNAME_ALLOC(2, variable);
+	n->displayName = UA_LOCALIZEDTEXT_ALLOC("en-US", variable);
+	n->description = UA_LOCALIZEDTEXT_ALLOC("en-US", "A variable of the device");
+	n->referencesSize = 2;
+	n->references = UA_Array_new(2, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+	n->references[0].referenceTypeId = UA_NODEID_NUMERIC(0, 47); // HasComponent
+	n->references[0].isInverse = true;
+	sprintf(name, "Device%d", i / 4);
+	n->references[0].targetId = UA_EXPANDEDNODEID_STRING_ALLOC(2, name);
+	n->references[1].referenceTypeId = UA_NODEID_NUMERIC(0, 40); // HasTypeDefinition
+	n->references[1].targetId = UA_EXPANDEDNODEID_STRING_ALLOC(2, "DeviceVariableType");
+	return n;
+}
+
+START_TEST(internSharedStrings) {
+	UA_NodeStore *ns = UA_NodeStore_new();
+	for(UA_Int32 i = 0; i < FOOTPRINT_NODES; i++)
+		UA_NodeStore_insert(ns, createInstanceNode(ns, i));
+	size_t before = heapInUse();
+	UA_NodeStoreCursor c;
+	UA_NodeStoreCursor_init(&c);
+	UA_NodeStore_maintain(ns, &c, 0);
+	ck_assert(c.done);
+	size_t interned = heapInUse();
+	printf("Footprint of the strings of %d nodes: %ld bytes saved by interning\n",
+	       FOOTPRINT_NODES, (long)before - (long)interned);
+	if(before > 0)
+		ck_assert(interned < before);
+
+	/* Equal strings share their data */
+	UA_NodeId id1 = UA_NODEID_STRING(2, "Device1.Pressure");
+	UA_NodeId id2 = UA_NODEID_STRING(2, "Device2.Pressure");
+	const UA_Node *n1 = UA_NodeStore_get(ns, &id1);
+	const UA_Node *n2 = UA_NodeStore_get(ns, &id2);
+	ck_assert_ptr_ne(n1, NULL);
+	ck_assert_ptr_ne(n2, NULL);
+	ck_assert_ptr_eq(n1->browseName.name.data, n2->browseName.name.data);
+	ck_assert_ptr_eq(n1->displayName.locale.data, n2->description.locale.data);
+	ck_assert_ptr_eq(n1->references[1].targetId.nodeId.identifier.string.data,
+	                 n2->references[1].targetId.nodeId.identifier.string.data);
+	UA_String pressure = UA_STRING("Pressure");
+	ck_assert(UA_String_equal(&n1->browseName.name, &pressure));
+	ck_assert(UA_NodeId_equal(&n1->nodeId, &id1));
+
+	/* Editable nodes have their own strings until they are interned again */
+	UA_Node *edit;
+	ck_assert_int_eq(UA_NodeStore_getEditable(ns, &id1, &edit), UA_STATUSCODE_GOOD);
+	ck_assert_ptr_eq(edit, n1);
+	ck_assert_ptr_ne(edit->browseName.name.data, n2->browseName.name.data);
+	ck_assert(UA_String_equal(&edit->browseName.name, &pressure));
+	UA_QualifiedName_deleteMembers(&edit->browseName);
+	edit->browseName = UA_QUALIFIEDNAME_ALLOC(2, "Serial");
+	UA_NodeStoreCursor_init(&c);
+	UA_NodeStore_maintain(ns, &c, 0);
+	ck_assert_ptr_ne(edit->displayName.locale.data, n2->displayName.locale.data);
+	ck_assert_int_eq(UA_NodeStore_getEditable(ns, &id2, &edit), UA_STATUSCODE_GOOD);
+	UA_NodeStoreCursor_init(&c);
+	UA_NodeStore_maintain(ns, &c, 0);
+	UA_NodeId id3 = UA_NODEID_STRING(2, "Device1.Serial");
+	const UA_Node *n3 = UA_NodeStore_get(ns, &id3);
+	ck_assert_ptr_eq(n1->browseName.name.data, n3->browseName.name.data);
+	ck_assert_ptr_eq(n1->displayName.locale.data, n3->displayName.locale.data);
+
+	/* Interned nodes can be packed, replaced and removed */
+	ck_assert_int_eq(UA_NodeStore_pack(ns), UA_STATUSCODE_GOOD);
+	ck_assert(UA_String_equal(&n3->browseName.name, &n1->browseName.name));
+	UA_Node *copy = UA_NodeStore_getCopy(ns, &id3);
+	ck_assert_int_eq(UA_NodeStore_replace(ns, copy), UA_STATUSCODE_GOOD);
+	ck_assert_int_eq(UA_NodeStore_remove(ns, &id1), UA_STATUSCODE_GOOD);
+	ck_assert_int_eq(UA_NodeStore_remove(ns, &id3), UA_STATUSCODE_GOOD);
+	UA_NodeStore_delete(ns);
+}
+END_TEST
+
+/* A small image like the one generated for namespace zero */
+static UA_ReferenceNode imageReferences[1] = {
+	{{0, UA_NODEIDTYPE_NUMERIC, {35}}, false, {{0, UA_NODEIDTYPE_NUMERIC, {85}}, {0, NULL}, 0}}};
+
+static const UA_ObjectNode imageNodes[3] = {
+	{.nodeId = {0, UA_NODEIDTYPE_NUMERIC, {84}}, .nodeClass = UA_NODECLASS_OBJECT,
+	 .browseName = {0, {4, (UA_Byte*)"Root"}}, .referencesSize = 1, .references = imageReferences},
+	{.nodeId = {0, UA_NODEIDTYPE_NUMERIC, {85}}, .nodeClass = UA_NODECLASS_OBJECT,
+	 .browseName = {0, {7, (UA_Byte*)"Objects"}}},
+	{.nodeId = {0, UA_NODEIDTYPE_NUMERIC, {86}}, .nodeClass = UA_NODECLASS_OBJECT,
+	 .browseName = {0, {5, (UA_Byte*)"Types"}}}};
+
+static const UA_Node *imageTable[8];
+
+START_TEST(serveNodesFromImage) {
+	for(size_t i = 0; i < 3; i++) {
+		UA_UInt32 idx = UA_NODESTORE_IMAGEHASH(imageNodes[i].nodeId.identifier.numeric, 3);
+		while(imageTable[idx])
+			idx = (idx + 1) & 7;
+		imageTable[idx] = (const UA_Node*)&imageNodes[i];
+	}
+	UA_NodeStoreImage image = {0, 3, imageTable};
+	UA_NodeStore *ns = UA_NodeStore_new();
+	ck_assert_int_eq(UA_NodeStore_setImage(ns, &image), UA_STATUSCODE_GOOD);
+	ck_assert_int_eq(UA_NodeStore_setImage(ns, &image), UA_STATUSCODE_BADINTERNALERROR);
+
+	/* Image nodes are served without copying */
+	UA_NodeId root = UA_NODEID_NUMERIC(0, 84);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &root), &imageNodes[0]);
+	UA_NodeId other = UA_NODEID_NUMERIC(0, 87);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &other), NULL);
+	visitCnt = 0;
+	UA_NodeStore_iterate(ns, checkZeroVisitor);
+	ck_assert_int_eq(visitCnt, 3);
+
+	/* The nodeids of the image are taken */
+	ck_assert_int_eq(UA_NodeStore_insert(ns, createNode(ns, 0, 85)), UA_STATUSCODE_BADNODEIDEXISTS);
+	ck_assert_int_eq(UA_NodeStore_insert(ns, createNode(ns, 0, 87)), UA_STATUSCODE_GOOD);
+
+	/* Editing copies the node into the nodestore. The image is unchanged. */
+	UA_Node *edit = NULL;
+	ck_assert_int_eq(UA_NodeStore_getEditable(ns, &root, &edit), UA_STATUSCODE_GOOD);
+	ck_assert_ptr_ne(edit, &imageNodes[0]);
+	ck_assert_int_eq(edit->referencesSize, 1);
+	UA_QualifiedName_deleteMembers(&edit->browseName);
+	edit->browseName = UA_QUALIFIEDNAME_ALLOC(0, "Wurzel");
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &root), edit);
+	UA_String rootName = UA_STRING("Root");
+	ck_assert(UA_String_equal(&imageNodes[0].browseName.name, &rootName));
+	visitCnt = 0;
+	UA_NodeStore_iterate(ns, checkZeroVisitor);
+	ck_assert_int_eq(visitCnt, 4);
+
+	/* Image nodes can be replaced */
+	UA_NodeId objects = UA_NODEID_NUMERIC(0, 85);
+	UA_Node *copy = UA_NodeStore_getCopy(ns, &objects);
+	ck_assert_ptr_ne(copy, NULL);
+	ck_assert_int_eq(UA_NodeStore_replace(ns, copy), UA_STATUSCODE_GOOD);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &objects), copy);
+
+	/* Removed image nodes are hidden and the nodeid can be used again */
+	UA_NodeId types = UA_NODEID_NUMERIC(0, 86);
+	ck_assert_int_eq(UA_NodeStore_remove(ns, &types), UA_STATUSCODE_GOOD);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &types), NULL);
+	ck_assert_int_eq(UA_NodeStore_remove(ns, &types), UA_STATUSCODE_BADNODEIDUNKNOWN);
+	ck_assert_int_eq(UA_NodeStore_insert(ns, createNode(ns, 0, 86)), UA_STATUSCODE_GOOD);
+	ck_assert_ptr_ne(UA_NodeStore_get(ns, &types), NULL);
+
+	/* Removing the copy does not bring back the image node */
+	ck_assert_int_eq(UA_NodeStore_remove(ns, &root), UA_STATUSCODE_GOOD);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &root), NULL);
+	UA_NodeStore_delete(ns);
+}
+END_TEST
+
+/* A nodestore with all nodeclasses, references, values and string nodeids */
+static UA_NodeStore * createSnapshotNodeStore(void) {
+	UA_NodeStore *ns = UA_NodeStore_new();
+	const UA_NodeClass classes[8] = {UA_NODECLASS_OBJECT, UA_NODECLASS_OBJECTTYPE,
+	                                 UA_NODECLASS_VARIABLE, UA_NODECLASS_VARIABLETYPE,
+	                                 UA_NODECLASS_REFERENCETYPE, UA_NODECLASS_METHOD,
+	                                 UA_NODECLASS_VIEW, UA_NODECLASS_DATATYPE};
+	char name[32];
+	for (UA_UInt32 i = 0; i < 1000; i++) {
+		UA_Node *n = UA_NodeStore_newNode(ns, classes[i % 8]);
+		snprintf(name, sizeof(name), "Node%u", i);
+		if (i % 3 == 0)
+			n->nodeId = UA_NODEID_STRING_ALLOC(2, name);
+		else
+			n->nodeId = UA_NODEID_NUMERIC(1, i * (i % 2 ? 1 : 1000));
+		n->browseName = UA_QUALIFIEDNAME_ALLOC(1, name);
+		n->displayName = UA_LOCALIZEDTEXT_ALLOC("en", name);
+		n->writeMask = i;
+		n->referencesSize = i % 4;
+		if (n->referencesSize > 0)
+			n->references = UA_Array_new(n->referencesSize, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+		for (size_t j = 0; j < n->referencesSize; j++) {
+			n->references[j].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+			n->references[j].isInverse = (j % 2 == 1);
+			n->references[j].targetId.nodeId = UA_NODEID_NUMERIC(1, (UA_UInt32)j);
+			n->references[j].targetId.serverIndex = (UA_UInt32)j;
+		}
+		if (n->nodeClass == UA_NODECLASS_VARIABLE) {
+			UA_VariableNode *vn = (UA_VariableNode*)n;
+			vn->valueRank = -1;
+			vn->accessLevel = 3;
+			if (i % 16 == 2) {
+				vn->valueSource = UA_VALUESOURCE_DATASOURCE;
+			} else {
+				UA_Double d[3] = {i, 1.5, -2};
+				UA_Variant_setArrayCopy(&vn->value.variant.value, d, 3, &UA_TYPES[UA_TYPES_DOUBLE]);
+			}
+		} else if (n->nodeClass == UA_NODECLASS_REFERENCETYPE) {
+			((UA_ReferenceTypeNode*)n)->symmetric = true;
+			((UA_ReferenceTypeNode*)n)->inverseName = UA_LOCALIZEDTEXT_ALLOC("en", name);
+		} else if (n->nodeClass == UA_NODECLASS_VIEW) {
+			((UA_ViewNode*)n)->containsNoLoops = true;
+		}
+		ck_assert_int_eq(UA_NodeStore_insert(ns, n), UA_STATUSCODE_GOOD);
+	}
+	return ns;
+}
+
+static void compareSnapshotNode(const UA_Node *a, const UA_Node *b) {
+	ck_assert(UA_NodeId_equal(&a->nodeId, &b->nodeId));
+	ck_assert_int_eq(a->nodeClass, b->nodeClass);
+	ck_assert_int_eq(a->browseName.namespaceIndex, b->browseName.namespaceIndex);
+	ck_assert(UA_String_equal(&a->browseName.name, &b->browseName.name));
+	ck_assert(UA_String_equal(&a->displayName.text, &b->displayName.text));
+	ck_assert_int_eq(a->writeMask, b->writeMask);
+	ck_assert_int_eq(a->referencesSize, b->referencesSize);
+	for (size_t i = 0; i < a->referencesSize; i++) {
+		ck_assert(UA_NodeId_equal(&a->references[i].referenceTypeId, &b->references[i].referenceTypeId));
+		ck_assert_int_eq(a->references[i].isInverse, b->references[i].isInverse);
+		ck_assert(UA_NodeId_equal(&a->references[i].targetId.nodeId, &b->references[i].targetId.nodeId));
+		ck_assert_int_eq(a->references[i].targetId.serverIndex, b->references[i].targetId.serverIndex);
+	}
+	if (a->nodeClass == UA_NODECLASS_VARIABLE) {
+		const UA_VariableNode *va = (const UA_VariableNode*)a;
+		const UA_VariableNode *vb = (const UA_VariableNode*)b;
+		ck_assert_int_eq(va->valueRank, vb->valueRank);
+		ck_assert_int_eq(va->accessLevel, vb->accessLevel);
+		ck_assert_int_eq(va->valueSource, vb->valueSource);
+		if (va->valueSource == UA_VALUESOURCE_VARIANT) {
+			ck_assert_ptr_eq(va->value.variant.value.type, vb->value.variant.value.type);
+			ck_assert_int_eq(va->value.variant.value.arrayLength, vb->value.variant.value.arrayLength);
+			ck_assert(memcmp(va->value.variant.value.data, vb->value.variant.value.data,
+			                 sizeof(UA_Double) * va->value.variant.value.arrayLength) == 0);
+		} else {
+			ck_assert_ptr_eq(vb->value.dataSource.read, NULL);
+		}
+	} else if (a->nodeClass == UA_NODECLASS_REFERENCETYPE) {
+		const UA_ReferenceTypeNode *ra = (const UA_ReferenceTypeNode*)a;
+		const UA_ReferenceTypeNode *rb = (const UA_ReferenceTypeNode*)b;
+		ck_assert_int_eq(ra->symmetric, rb->symmetric);
+		ck_assert(UA_String_equal(&ra->inverseName.text, &rb->inverseName.text));
+	} else if (a->nodeClass == UA_NODECLASS_VIEW) {
+		ck_assert_int_eq(((const UA_ViewNode*)a)->containsNoLoops,
+		                 ((const UA_ViewNode*)b)->containsNoLoops);
+	}
+}
+
+static const UA_Node *visited[1024];
+static void collectVisitor(const UA_Node *node) {
+	visited[visitCnt++] = node;
+}
+
+START_TEST(roundTripSnapshot) {
+	// given
+	UA_NodeStore *ns = createSnapshotNodeStore();
+	UA_ByteString snapshot;
+	ck_assert_int_eq(UA_NodeStore_saveSnapshot(ns, &snapshot), UA_STATUSCODE_GOOD);
+	// when
+	UA_NodeStore *loaded = UA_NodeStore_new();
+	ck_assert_int_eq(UA_NodeStore_loadSnapshot(loaded, &snapshot), UA_STATUSCODE_GOOD);
+	// then: every node that is iterated in the original is found in the snapshot
+	visitCnt = 0;
+	UA_NodeStore_iterate(ns, collectVisitor);
+	ck_assert_int_eq(visitCnt, 1000);
+	for (int i = 0; i < visitCnt; i++) {
+		const UA_Node *node = UA_NodeStore_get(loaded, &visited[i]->nodeId);
+		ck_assert_ptr_ne(node, NULL);
+		compareSnapshotNode(visited[i], node);
+	}
+	// and the other way round
+	visitCnt = 0;
+	UA_NodeStore_iterate(loaded, collectVisitor);
+	ck_assert_int_eq(visitCnt, 1000);
+	for (int i = 0; i < visitCnt; i++)
+		compareSnapshotNode(visited[i], UA_NodeStore_get(ns, &visited[i]->nodeId));
+	// finally
+	UA_NodeStore_delete(loaded);
+	UA_NodeStore_delete(ns);
+	UA_ByteString_deleteMembers(&snapshot);
+}
+END_TEST
+
+START_TEST(loadSnapshotLazily) {
+	UA_NodeStore *ns = createSnapshotNodeStore();
+	UA_ByteString snapshot;
+	ck_assert_int_eq(UA_NodeStore_saveSnapshot(ns, &snapshot), UA_STATUSCODE_GOOD);
+
+	/* Only fresh nodestores load snapshots */
+	ck_assert_int_eq(UA_NodeStore_loadSnapshot(ns, &snapshot), UA_STATUSCODE_BADINTERNALERROR);
+	UA_NodeStore_delete(ns);
+	ns = UA_NodeStore_new();
+	snapshot.data[4]++; // version
+	ck_assert_int_eq(UA_NodeStore_loadSnapshot(ns, &snapshot), UA_STATUSCODE_BADDECODINGERROR);
+	snapshot.data[4]--;
+	ck_assert_int_eq(UA_NodeStore_loadSnapshot(ns, &snapshot), UA_STATUSCODE_GOOD);
+
+	/* Nodes are decoded on first access */
+	UA_NodeId id = UA_NODEID_NUMERIC(1, 1);
+	const UA_Node *node = UA_NodeStore_get(ns, &id);
+	ck_assert_ptr_ne(node, NULL);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &id), node);
+	UA_NodeId other = UA_NODEID_NUMERIC(1, 2);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &other), NULL);
+
+	/* The nodeids of the snapshot are taken */
+	ck_assert_int_eq(UA_NodeStore_insert(ns, createNode(ns, 1, 4000)), UA_STATUSCODE_BADNODEIDEXISTS);
+	ck_assert_int_eq(UA_NodeStore_insert(ns, createNode(ns, 1, 4001)), UA_STATUSCODE_GOOD);
+
+	/* Nodes can be removed and replaced before they are decoded */
+	UA_NodeId removed = UA_NODEID_STRING(2, "Node3");
+	ck_assert_int_eq(UA_NodeStore_remove(ns, &removed), UA_STATUSCODE_GOOD);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &removed), NULL);
+	ck_assert_int_eq(UA_NodeStore_remove(ns, &removed), UA_STATUSCODE_BADNODEIDUNKNOWN);
+	UA_Node *replacement = createNode(ns, 1, 5);
+	ck_assert_int_eq(UA_NodeStore_replace(ns, replacement), UA_STATUSCODE_GOOD);
+	UA_NodeId replaced = UA_NODEID_NUMERIC(1, 5);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &replaced), replacement);
+
+	/* Decoded nodes behave like inserted nodes */
+	UA_NodeId copied = UA_NODEID_NUMERIC(1, 7);
+	UA_Node *copy = UA_NodeStore_getCopy(ns, &copied);
+	ck_assert_ptr_ne(copy, NULL);
+	ck_assert_int_eq(UA_NodeStore_replace(ns, copy), UA_STATUSCODE_GOOD);
+	ck_assert_ptr_eq(UA_NodeStore_get(ns, &copied), copy);
+
+	/* Batches decode the nodes they miss */
+	UA_NodeId ids[3] = {UA_NODEID_NUMERIC(1, 9), UA_NODEID_NUMERIC(1, 11), UA_NODEID_NUMERIC(1, 4001)};
+	const UA_Node *nodes[3];
+	UA_NodeStore_getBatch(ns, ids, 3, nodes);
+	for (size_t i = 0; i < 3; i++)
+		ck_assert_ptr_eq(nodes[i], UA_NodeStore_get(ns, &ids[i]));
+
+	visitCnt = 0;
+	UA_NodeStore_iterate(ns, checkZeroVisitor);
+	ck_assert_int_eq(visitCnt, 1000);
+	UA_NodeStore_delete(ns);
+	UA_ByteString_deleteMembers(&snapshot);
+}
+END_TEST
+
+#ifdef UA_ENABLE_NODESTORE_MMAP
+START_TEST(mapSnapshotFile) {
+	UA_NodeStore *ns = createSnapshotNodeStore();
+	const char *path = "check_nodestore_snapshot.bin";
+	ck_assert_int_eq(UA_NodeStore_saveSnapshotFile(ns, path), UA_STATUSCODE_GOOD);
+	UA_NodeStore *loaded = UA_NodeStore_new();
+	ck_assert_int_eq(UA_NodeStore_loadSnapshotFile(loaded, path), UA_STATUSCODE_GOOD);
+	remove(path); // the mapping stays valid
+
+	visitCnt = 0;
+	UA_NodeStore_iterate(ns, collectVisitor);
+	for (int i = 0; i < visitCnt; i++)
+		compareSnapshotNode(visited[i], UA_NodeStore_get(loaded, &visited[i]->nodeId));
+	UA_NodeStore_delete(loaded);
+	UA_NodeStore_delete(ns);
+}
+END_TEST
+#endif
+
+static UA_Node * createChild(UA_NodeStore *ns, UA_UInt32 id, const char *name) {
+	UA_Node *n = createNode(ns, 1, (UA_Int32)id);
+	n->browseName = UA_QUALIFIEDNAME_ALLOC(1, name);
+	return n;
+}
+
+START_TEST(findChildrenByBrowseName) {
+	UA_NodeStore *ns = UA_NodeStore_new();
+	UA_Node *parent = (UA_Node*)UA_NodeStore_newObjectNode(ns);
+	parent->nodeId = UA_NODEID_NUMERIC(1, 1);
+	parent->referencesSize = 101;
+	parent->references = UA_Array_new(parent->referencesSize, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+	char name[32];
+	for (UA_UInt32 i = 0; i < 101; i++) {
+		parent->references[i].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+		parent->references[i].targetId.nodeId = UA_NODEID_NUMERIC(1, 100 + i);
+		if (i == 100)
+			break; // the last target is inserted later
+		snprintf(name, sizeof(name), "Child%u", i == 50 ? 49 : i);
+		UA_NodeStore_insert(ns, createChild(ns, 100 + i, name));
+	}
+	UA_NodeStore_insert(ns, parent);
+	const UA_Node *node = UA_NodeStore_get(ns, &parent->nodeId);
+	const UA_Node *target = NULL;
+
+	UA_QualifiedName child10 = UA_QUALIFIEDNAME(1, "Child10");
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &child10, 0, &target), 10);
+	ck_assert_int_eq(target->nodeId.identifier.numeric, 110);
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &child10, 11, &target), 101);
+	UA_QualifiedName child10ns2 = UA_QUALIFIEDNAME(2, "Child10");
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &child10ns2, 0, &target), 101);
+
+	/* Two targets with the same browsename */
+	UA_QualifiedName child49 = UA_QUALIFIEDNAME(1, "Child49");
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &child49, 0, &target), 49);
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &child49, 50, &target), 50);
+	ck_assert_int_eq(target->nodeId.identifier.numeric, 150);
+
+	/* Renamed in place */
+	UA_Node *edit;
+	UA_NodeId child10Id = UA_NODEID_NUMERIC(1, 110);
+	ck_assert_int_eq(UA_NodeStore_getEditable(ns, &child10Id, &edit), UA_STATUSCODE_GOOD);
+	UA_QualifiedName_deleteMembers(&edit->browseName);
+	edit->browseName = UA_QUALIFIEDNAME_ALLOC(1, "Renamed");
+	UA_QualifiedName renamed = UA_QUALIFIEDNAME(1, "Renamed");
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &child10, 0, &target), 101);
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &renamed, 0, &target), 10);
+
+	/* Renamed by replacing */
+	UA_Node *copy = UA_NodeStore_getCopy(ns, &child10Id);
+	UA_QualifiedName_deleteMembers(&copy->browseName);
+	copy->browseName = UA_QUALIFIEDNAME_ALLOC(1, "Child10");
+	ck_assert_int_eq(UA_NodeStore_replace(ns, copy), UA_STATUSCODE_GOOD);
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &renamed, 0, &target), 101);
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &child10, 0, &target), 10);
+
+	/* The missing target is inserted */
+	UA_QualifiedName late = UA_QUALIFIEDNAME(1, "Late");
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &late, 0, &target), 101);
+	UA_NodeStore_insert(ns, createChild(ns, 200, "Late"));
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &late, 0, &target), 100);
+
+	/* Removed and inserted under another browsename */
+	UA_NodeId child20Id = UA_NODEID_NUMERIC(1, 120);
+	UA_QualifiedName child20 = UA_QUALIFIEDNAME(1, "Child20");
+	UA_QualifiedName again = UA_QUALIFIEDNAME(1, "Again");
+	ck_assert_int_eq(UA_NodeStore_remove(ns, &child20Id), UA_STATUSCODE_GOOD);
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &child20, 0, &target), 101);
+	UA_NodeStore_insert(ns, createChild(ns, 120, "Again"));
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &again, 0, &target), 20);
+
+	/* The references of the parent are edited */
+	ck_assert_int_eq(UA_NodeStore_getEditable(ns, &parent->nodeId, &edit), UA_STATUSCODE_GOOD);
+	edit->references[0].targetId.nodeId = UA_NODEID_NUMERIC(1, 200);
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &late, 0, &target), 0);
+	UA_QualifiedName child0 = UA_QUALIFIEDNAME(1, "Child0");
+	ck_assert_int_eq(UA_NodeStore_findChild(ns, node, &child0, 0, &target), 101);
+
+	UA_NodeStore_delete(ns);
+}
+END_TEST
+
+START_TEST(findReferencesByTypeAndDirection) {
+	UA_NodeStore *ns = UA_NodeStore_new();
+	UA_Node *parent = (UA_Node*)UA_NodeStore_newObjectNode(ns);
+	parent->nodeId = UA_NODEID_NUMERIC(1, 1);
+	parent->referencesSize = 60;
+	parent->references = UA_Array_new(parent->referencesSize, &UA_TYPES[UA_TYPES_REFERENCENODE]);
+	char name[32];
+	for (UA_UInt32 i = 0; i < 60; i++) {
+		UA_ReferenceNode *ref = &parent->references[i];
+		if (i % 3 == 0) {
+			ref->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+			ref->targetId.nodeId = UA_NODEID_NUMERIC(1, 100 + i);
+		} else if (i % 3 == 1) {
+			ref->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+			ref->isInverse = true;
+			snprintf(name, sizeof(name), "Target%u", i);
+			ref->targetId.nodeId = UA_NODEID_STRING_ALLOC(1, name);
+		} else {
+			ref->referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+			ref->isInverse = true;
+			ref->targetId.nodeId = UA_NODEID_NUMERIC(1, 100 + i);
+			ref->targetId.serverIndex = 1;
+		}
+	}
+	UA_NodeStore_insert(ns, parent);
+	const UA_Node *node = UA_NodeStore_get(ns, &parent->nodeId);
+	UA_NodeId hasComponent = UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT);
+	UA_NodeId organizes = UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES);
+	UA_NodeId target;
+
+	/* Every group is found in the order of the references */
+	size_t found = 0;
+	for (size_t i = UA_NodeStore_findReference(ns, node, &hasComponent, false, 0, &target);
+	     i < node->referencesSize;
+	     i = UA_NodeStore_findReference(ns, node, &hasComponent, false, i + 1, &target)) {
+		ck_assert_int_eq(i, found * 3);
+		ck_assert(UA_NodeId_equal(&target, &node->references[i].targetId.nodeId));
+		found++;
+	}
+	ck_assert_int_eq(found, 20);
+	ck_assert_int_eq(UA_NodeStore_findReference(ns, node, &organizes, true, 29, &target), 31);
+	ck_assert(UA_NodeId_equal(&target, &node->references[31].targetId.nodeId));
+	ck_assert_int_eq(UA_NodeStore_findReference(ns, node, &hasComponent, true, 30, &target), 32);
+	ck_assert_int_eq(target.identifier.numeric, 132);
+	ck_assert_int_eq(UA_NodeStore_findReference(ns, node, &hasComponent, true, 60, NULL), 60);
+	ck_assert_int_eq(UA_NodeStore_findReference(ns, node, &organizes, false, 0, NULL), 60);
+
+	/* The references of the parent are edited */
+	UA_Node *edit;
+	ck_assert_int_eq(UA_NodeStore_getEditable(ns, &parent->nodeId, &edit), UA_STATUSCODE_GOOD);
+	edit->references[0].referenceTypeId = organizes;
+	ck_assert_int_eq(UA_NodeStore_findReference(ns, node, &hasComponent, false, 0, NULL), 3);
+	ck_assert_int_eq(UA_NodeStore_findReference(ns, node, &organizes, false, 0, &target), 0);
+	ck_assert_int_eq(target.identifier.numeric, 100);
+
+	/* The index is rebuilt once another node is editable */
+	UA_NodeStore_insert(ns, createChild(ns, 1000, "Other"));
+	UA_NodeId otherId = UA_NODEID_NUMERIC(1, 1000);
+	ck_assert_int_eq(UA_NodeStore_getEditable(ns, &otherId, &edit), UA_STATUSCODE_GOOD);
+	ck_assert_int_eq(UA_NodeStore_findReference(ns, node, &organizes, false, 0, NULL), 0);
+	ck_assert_int_eq(UA_NodeStore_findReference(ns, node, &organizes, false, 1, NULL), 60);
+	ck_assert_int_eq(UA_NodeStore_findReference(ns, node, &hasComponent, false, 1, NULL), 3);
+
+	UA_NodeStore_delete(ns);
+}
+END_TEST
+
+#endif
+
 /************************************/
 /* Performance Profiling Test Cases */
 /************************************/
@@ -269,10 +1140,12 @@ struct UA_NodeStoreProfileTest {
 	UA_Int32 min_val;
 	UA_Int32 max_val;
 	UA_Int32 rounds;
+	UA_Boolean replace;
 };
 
 static void *profileGetThread(void *arg) {
    	rcu_register_thread();
+	UA_RCU_LOCK();
 	struct UA_NodeStoreProfileTest *test = (struct UA_NodeStoreProfileTest*) arg;
 	UA_NodeId id;
     UA_NodeId_init(&id);
@@ -284,6 +1157,7 @@ static void *profileGetThread(void *arg) {
 			UA_NodeStore_get(ns,&id);
 		}
 	}
+	UA_RCU_UNLOCK();
 	rcu_unregister_thread();
 	
 	return NULL;
@@ -293,13 +1167,14 @@ static void *profileGetThread(void *arg) {
 START_TEST(profileGetDelete) {
 #ifdef UA_ENABLE_MULTITHREADING
    	rcu_register_thread();
+	UA_RCU_LOCK();
 #endif
 
 #define N 1000000
 	UA_NodeStore *ns = UA_NodeStore_new();
 	UA_Node *n;
 	for (int i=0; i<N; i++) {
-		n = createNode(0,i);
+		n = createNode(ns, 0,i);
         UA_NodeStore_insert(ns, n);
 	}
 	clock_t begin, end;
@@ -309,7 +1184,7 @@ START_TEST(profileGetDelete) {
     pthread_t t[THREADS];
 	struct UA_NodeStoreProfileTest p[THREADS];
 	for (int i = 0; i < THREADS; i++) {
-		p[i] = (struct UA_NodeStoreProfileTest){ns, i*(N/THREADS), (i+1)*(N/THREADS), 50};
+		p[i] = (struct UA_NodeStoreProfileTest){ns, i*(N/THREADS), (i+1)*(N/THREADS), 50, false};
 		pthread_create(&t[i], NULL, profileGetThread, &p[i]);
 	}
 	for (int i = 0; i < THREADS; i++)
@@ -332,11 +1207,233 @@ START_TEST(profileGetDelete) {
 	UA_NodeStore_delete(ns);
 
 #ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
+#ifdef UA_ENABLE_MULTITHREADING
+/* Readers look up all nodes while writers replace the nodes of their range with
+ * an edited copy */
+#define STRESS_NODES 100000
+#define STRESS_READERS 4
+#define STRESS_WRITERS 4
+
+static void *profileReadReplaceThread(void *arg) {
+   	rcu_register_thread();
+	struct UA_NodeStoreProfileTest *test = (struct UA_NodeStoreProfileTest*) arg;
+	UA_NodeId id = UA_NODEID_NUMERIC(0, 0);
+	for(UA_Int32 x = 0; x < test->rounds; x++) {
+		for(UA_Int32 i = test->min_val; i < test->max_val; i++) {
+			id.identifier.numeric = (UA_UInt32)i;
+			UA_RCU_LOCK();
+			if(test->replace) {
+				UA_Node *copy = UA_NodeStore_getCopy(test->ns, &id);
+				if(copy)
+					UA_NodeStore_replace(test->ns, copy);
+			} else {
+				UA_NodeStore_get(test->ns, &id);
+			}
+			UA_RCU_UNLOCK();
+		}
+	}
+	rcu_unregister_thread();
+	return NULL;
+}
+
+static double profileReadReplace(UA_NodeStore *ns) {
+	UA_RCU_LOCK();
+	for (int i = 1; i <= STRESS_NODES; i++)
+		UA_NodeStore_insert(ns, createNode(ns, 0,i));
+	UA_RCU_UNLOCK();
+	pthread_t t[STRESS_READERS + STRESS_WRITERS];
+	struct UA_NodeStoreProfileTest p[STRESS_READERS + STRESS_WRITERS];
+	UA_DateTime begin = UA_DateTime_nowMonotonic();
+	for (int i = 0; i < STRESS_READERS; i++) {
+		p[i] = (struct UA_NodeStoreProfileTest){ns, 1, STRESS_NODES + 1, 10, false};
+		pthread_create(&t[i], NULL, profileReadReplaceThread, &p[i]);
+	}
+	for (int i = 0; i < STRESS_WRITERS; i++) {
+		int chunk = STRESS_NODES / STRESS_WRITERS;
+		p[STRESS_READERS + i] = (struct UA_NodeStoreProfileTest){ns, 1 + i*chunk, 1 + (i+1)*chunk, 1, true};
+		pthread_create(&t[STRESS_READERS + i], NULL, profileReadReplaceThread, &p[STRESS_READERS + i]);
+	}
+	for (int i = 0; i < STRESS_READERS + STRESS_WRITERS; i++)
+		pthread_join(t[i], NULL);
+	UA_DateTime end = UA_DateTime_nowMonotonic();
+	return (double)(end - begin) / UA_SEC_TO_DATETIME;
+}
+
+START_TEST(profileReadReplaceSharded) {
+   	rcu_register_thread();
+	UA_NodeStore *ns = UA_NodeStore_newSharded(1);
+	double single = profileReadReplace(ns);
+	UA_RCU_LOCK();
+	UA_NodeStore_delete(ns);
+	UA_RCU_UNLOCK();
+	ns = UA_NodeStore_new();
+	double sharded = profileReadReplace(ns);
+	UA_RCU_LOCK();
+	UA_NodeStore_delete(ns);
+	UA_RCU_UNLOCK();
+	rcu_barrier();
+	printf("Time for %d readers and %d writers on %d nodes: single table %fs, sharded %fs.\n",
+	       STRESS_READERS, STRESS_WRITERS, STRESS_NODES, single, sharded);
+	rcu_unregister_thread();
+}
+END_TEST
+#endif
+
+/* Lookups in a nodestore that holds numeric and string nodeids, as loaded from a
+ * nodeset. Half of the lookups are misses from other namespaces. */
+START_TEST(profileGetHitsAndMisses) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+	UA_RCU_LOCK();
+#endif
+	UA_NodeStore *ns = UA_NodeStore_new();
+	char name[32];
+	for (int i=0; i<N; i++) {
+		UA_Node *n = createNode(ns, 1,i+1);
+		if (i % 4 == 0) {
+			snprintf(name, sizeof(name), "Device%d.Value", i);
+			n->nodeId = UA_NODEID_STRING_ALLOC(2, name);
+		}
+		UA_NodeStore_insert(ns, n);
+	}
+
+	UA_NodeId *ids = malloc(sizeof(UA_NodeId) * N);
+	for (int i=0; i<N; i++) {
+		/* odd namespaces miss */
+		UA_UInt16 nsIndex = (UA_UInt16)(1 + ((i / 4) % 2) * 2);
+		if (i % 4 == 0) {
+			snprintf(name, sizeof(name), "Device%d.Value", i);
+			ids[i] = UA_NODEID_STRING_ALLOC((UA_UInt16)(nsIndex + 1), name);
+		} else
+			ids[i] = UA_NODEID_NUMERIC(nsIndex, (UA_UInt32)i+1);
+	}
+
+	size_t found = 0;
+	clock_t begin = clock();
+	for (int x = 0; x < 20; x++) {
+		for (int i=0; i<N; i++) {
+			if (UA_NodeStore_get(ns, &ids[((size_t)i * 7919) % N]))
+				found++;
+		}
+	}
+	clock_t end = clock();
+	printf("Time for %d get (%lu found) in a namespace of %d nodes: %fs.\n", 20 * N,
+	       (unsigned long)found, N, (double)(end - begin) / CLOCKS_PER_SEC);
+	ck_assert_uint_eq(found, 20 * (N / 2));
+
+	for (int i=0; i<N; i++)
+		UA_NodeId_deleteMembers(&ids[i]);
+	free(ids);
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
+	rcu_unregister_thread();
+#endif
+}
+END_TEST
+
+/* Lookups of the nodes of a large read request one by one and in batches.
+ * The nodestore is much larger than the cache. */
+START_TEST(profileGetBatch) {
+#ifdef UA_ENABLE_MULTITHREADING
+   	rcu_register_thread();
+	UA_RCU_LOCK();
+#endif
+	UA_NodeStore *ns = UA_NodeStore_new();
+	char name[32];
+	for (int i=0; i<N; i++) {
+		UA_Node *n = createNode(ns, 1,i+1);
+		if (i % 4 == 0) {
+			snprintf(name, sizeof(name), "Device%d.Value", i);
+			n->nodeId = UA_NODEID_STRING_ALLOC(2, name);
+		} else if (i % 4 == 1)
+			n->nodeId.identifier.numeric = (UA_UInt32)(i+1) * 64;
+		UA_NodeStore_insert(ns, n);
+	}
+
+	UA_NodeId *ids = malloc(sizeof(UA_NodeId) * N);
+	for (int i=0; i<N; i++) {
+		int j = (int)(((size_t)i * 7919) % N);
+		if (j % 4 == 0) {
+			snprintf(name, sizeof(name), "Device%d.Value", j);
+			ids[i] = UA_NODEID_STRING_ALLOC(2, name);
+		} else if (j % 4 == 1)
+			ids[i] = UA_NODEID_NUMERIC(1, (UA_UInt32)(j+1) * 64);
+		else
+			ids[i] = UA_NODEID_NUMERIC(1, (UA_UInt32)j+1);
+	}
+
+	const UA_Node *nodes[256];
+	size_t found = 0;
+	clock_t begin = clock();
+	for (int x = 0; x < 5; x++) {
+		for (int i=0; i<N; i++) {
+			if (UA_NodeStore_get(ns, &ids[i]))
+				found++;
+		}
+	}
+	clock_t end = clock();
+	double single = (double)(end - begin) / CLOCKS_PER_SEC;
+	ck_assert_uint_eq(found, 5 * N);
+
+	found = 0;
+	begin = clock();
+	for (int x = 0; x < 5; x++) {
+		for (int i=0; i<N; i += 256) {
+			size_t n = N - i < 256 ? (size_t)(N - i) : 256;
+			UA_NodeStore_getBatch(ns, &ids[i], n, nodes);
+			for (size_t j = 0; j < n; j++) {
+				if (nodes[j])
+					found++;
+			}
+		}
+	}
+	end = clock();
+	double batch = (double)(end - begin) / CLOCKS_PER_SEC;
+	ck_assert_uint_eq(found, 5 * N);
+	printf("Time for %d lookups in a namespace of %d nodes: get %fs, getBatch %fs.\n",
+	       5 * N, N, single, batch);
+
+	for (int i=0; i<N; i++)
+		UA_NodeId_deleteMembers(&ids[i]);
+	free(ids);
+	UA_NodeStore_delete(ns);
+#ifdef UA_ENABLE_MULTITHREADING
+	UA_RCU_UNLOCK();
 	rcu_unregister_thread();
 #endif
 }
 END_TEST
 
+#ifndef UA_ENABLE_MULTITHREADING
+/* The heap used by the nodes of N variables from instances of a type before
+   and after their strings were interned */
+START_TEST(profileInternStrings) {
+	size_t before = heapInUse();
+	UA_NodeStore *ns = UA_NodeStore_new();
+	for (int i=0; i<N; i++)
+		UA_NodeStore_insert(ns, createInstanceNode(ns, i));
+	size_t inserted = heapInUse() - before;
+	UA_NodeStoreCursor c;
+	UA_NodeStoreCursor_init(&c);
+	clock_t begin = clock();
+	UA_NodeStore_maintain(ns, &c, 0);
+	clock_t end = clock();
+	size_t interned = heapInUse() - before;
+	printf("Footprint of %d instance variables: %lu bytes, %lu bytes interned (%fs)\n",
+	       N, (unsigned long)inserted, (unsigned long)interned,
+	       (double)(end - begin) / CLOCKS_PER_SEC);
+	UA_NodeStore_delete(ns);
+}
+END_TEST
+#endif
+
 static Suite * namespace_suite (void) {
 	Suite *s = suite_create ("UA_NodeStore");
 
@@ -346,6 +1443,9 @@ static Suite * namespace_suite (void) {
 	tcase_add_test (tc_find, findNodeInExpandedNamespace);
 	tcase_add_test (tc_find, failToFindNonExistantNodeInUA_NodeStoreWithSeveralEntries);
 	tcase_add_test (tc_find, failToFindNodeInOtherUA_NodeStore);
+	tcase_add_test (tc_find, removeFromExpandedNamespace);
+	tcase_add_test (tc_find, findNodesInDenseAndSparseRanges);
+	tcase_add_test (tc_find, getBatchOfNodes);
 	suite_add_tcase (s, tc_find);
 
 	TCase *tc_replace = tcase_create("Replace");
@@ -356,10 +1456,47 @@ static Suite * namespace_suite (void) {
 	TCase* tc_iterate = tcase_create ("Iterate");
 	tcase_add_test (tc_iterate, iterateOverUA_NodeStoreShallNotVisitEmptyNodes);
 	tcase_add_test (tc_iterate, iterateOverExpandedNamespaceShallNotVisitEmptyNodes);
+	tcase_add_test (tc_iterate, iterateInStepsWithCursor);
+	tcase_add_test (tc_iterate, stopAndResumeCursor);
 	suite_add_tcase (s, tc_iterate);
+
+#ifndef UA_ENABLE_MULTITHREADING
+	TCase* tc_pack = tcase_create ("Pack");
+	tcase_add_test (tc_pack, packNodesIntoArena);
+	tcase_add_test (tc_pack, internSharedStrings);
+	suite_add_tcase (s, tc_pack);
+
+	TCase* tc_image = tcase_create ("Image");
+	tcase_add_test (tc_image, serveNodesFromImage);
+	suite_add_tcase (s, tc_image);
+
+	TCase* tc_snapshot = tcase_create ("Snapshot");
+	tcase_add_test (tc_snapshot, roundTripSnapshot);
+	tcase_add_test (tc_snapshot, loadSnapshotLazily);
+#ifdef UA_ENABLE_NODESTORE_MMAP
+	tcase_add_test (tc_snapshot, mapSnapshotFile);
+#endif
+	suite_add_tcase (s, tc_snapshot);
+
+	TCase* tc_children = tcase_create ("Children");
+	tcase_add_test (tc_children, findChildrenByBrowseName);
+	suite_add_tcase (s, tc_children);
+
+	TCase* tc_references = tcase_create ("References");
+	tcase_add_test (tc_references, findReferencesByTypeAndDirection);
+	suite_add_tcase (s, tc_references);
+#endif
 	
 	/* TCase* tc_profile = tcase_create ("Profile"); */
 	/* tcase_add_test (tc_profile, profileGetDelete); */
+	/* tcase_add_test (tc_profile, profileGetHitsAndMisses); */
+	/* tcase_add_test (tc_profile, profileGetBatch); */
+#ifndef UA_ENABLE_MULTITHREADING
+	/* tcase_add_test (tc_profile, profileInternStrings); */
+#endif
+#ifdef UA_ENABLE_MULTITHREADING
+	/* tcase_add_test (tc_profile, profileReadReplaceSharded); */
+#endif
 	/* suite_add_tcase (s, tc_profile); */
 
 	return s;
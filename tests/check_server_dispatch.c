@@ -0,0 +1,245 @@
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+
+#include "ua_server.h"
+#include "ua_util.h"
+#include "ua_nodeids.h"
+#include "server/ua_server_internal.h"
+#include "testing_networklayers.h"
+
+#define MESSAGESIZE 32
+
+static void writeUInt32(UA_Byte *pos, UA_UInt32 value) {
+    pos[0] = (UA_Byte)value;
+    pos[1] = (UA_Byte)(value >> 8);
+    pos[2] = (UA_Byte)(value >> 16);
+    pos[3] = (UA_Byte)(value >> 24);
+}
+
+/* A MSG chunk whose body starts with the nodeid of the request type. The
+   channel id does not match, so that the server drops the message. */
+static void
+encodeChunk(UA_Byte *buf, UA_Byte chunkType, UA_UInt32 requestId, UA_UInt16 requestType) {
+    memset(buf, 0, MESSAGESIZE);
+    buf[0] = 'M';
+    buf[1] = 'S';
+    buf[2] = 'G';
+    buf[3] = chunkType;
+    writeUInt32(&buf[4], MESSAGESIZE);
+    writeUInt32(&buf[8], 1); // secure channel id
+    writeUInt32(&buf[16], requestId); // sequence number
+    writeUInt32(&buf[20], requestId);
+    /* four-byte nodeid in namespace zero */
+    UA_UInt16 id = (UA_UInt16)(requestType + UA_ENCODINGOFFSET_BINARY);
+    buf[24] = 0x01;
+    buf[25] = 0;
+    buf[26] = (UA_Byte)id;
+    buf[27] = (UA_Byte)(id >> 8);
+}
+
+static UA_JobPriority
+classify(UA_Server *server, UA_Connection *c, UA_Byte chunkType, UA_UInt32 requestId,
+         UA_UInt16 requestType) {
+    UA_Byte buf[MESSAGESIZE];
+    encodeChunk(buf, chunkType, requestId, requestType);
+    UA_ByteString msg = {MESSAGESIZE, buf};
+    return UA_Server_classifyBinaryMessage(server, c, &msg);
+}
+
+START_TEST(classifyChunkedMessages) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_Connection c = createDummyConnection();
+
+    ck_assert_int_eq(classify(server, &c, 'F', 1, UA_NS0ID_PUBLISHREQUEST), UA_JOBPRIORITY_REALTIME);
+    ck_assert_int_eq(classify(server, &c, 'F', 2, 12345), UA_JOBPRIORITY_NORMAL);
+
+    /* The payload of the final chunk is not a request header */
+    ck_assert_int_eq(classify(server, &c, 'C', 3, UA_NS0ID_PUBLISHREQUEST), UA_JOBPRIORITY_NORMAL);
+    ck_assert_int_eq(classify(server, &c, 'C', 3, UA_NS0ID_PUBLISHREQUEST), UA_JOBPRIORITY_NORMAL);
+    ck_assert_int_eq(classify(server, &c, 'F', 4, UA_NS0ID_PUBLISHREQUEST), UA_JOBPRIORITY_REALTIME);
+    ck_assert_int_eq(classify(server, &c, 'F', 3, UA_NS0ID_PUBLISHREQUEST), UA_JOBPRIORITY_NORMAL);
+    ck_assert_int_eq(classify(server, &c, 'F', 3, UA_NS0ID_PUBLISHREQUEST), UA_JOBPRIORITY_REALTIME);
+
+    /* An aborted request */
+    ck_assert_int_eq(classify(server, &c, 'C', 5, UA_NS0ID_PUBLISHREQUEST), UA_JOBPRIORITY_NORMAL);
+    ck_assert_int_eq(classify(server, &c, 'A', 5, UA_NS0ID_PUBLISHREQUEST), UA_JOBPRIORITY_NORMAL);
+    ck_assert_int_eq(classify(server, &c, 'F', 5, UA_NS0ID_PUBLISHREQUEST), UA_JOBPRIORITY_REALTIME);
+
+    /* The chunks are tracked for all messages in the buffer */
+    UA_Byte buf[2 * MESSAGESIZE];
+    encodeChunk(buf, 'F', 6, UA_NS0ID_PUBLISHREQUEST);
+    encodeChunk(&buf[MESSAGESIZE], 'C', 7, UA_NS0ID_PUBLISHREQUEST);
+    UA_ByteString msg = {2 * MESSAGESIZE, buf};
+    ck_assert_int_eq(UA_Server_classifyBinaryMessage(server, &c, &msg), UA_JOBPRIORITY_NORMAL);
+    ck_assert_int_eq(classify(server, &c, 'F', 7, UA_NS0ID_PUBLISHREQUEST), UA_JOBPRIORITY_NORMAL);
+
+    /* Too many chunked requests. Every message may be a final chunk. */
+    for(UA_UInt32 i = 0; i <= UA_CONNECTION_CHUNKEDREQUESTS; i++)
+        classify(server, &c, 'C', 10 + i, UA_NS0ID_PUBLISHREQUEST);
+    ck_assert_int_eq(classify(server, &c, 'F', 100, UA_NS0ID_PUBLISHREQUEST), UA_JOBPRIORITY_NORMAL);
+
+    UA_Connection_deleteMembers(&c);
+    UA_Server_delete(server);
+} END_TEST
+
+/* A networklayer that hands out the messages of one connection. The worker is
+   blocked in the first message until the main loop has dispatched the others.
+   So they are waiting in the lanes of the worker at the same time. */
+
+#define MESSAGES 6
+
+static UA_Byte messages[MESSAGES][MESSAGESIZE];
+static size_t processed[MESSAGES];
+static size_t processedSize;
+static size_t getJobsCalls;
+static volatile UA_Boolean released;
+static UA_Connection connection;
+
+static void
+recordReleaseRecvBuffer(UA_Connection *c, UA_ByteString *buf) {
+    for(size_t i = 0; i < MESSAGES; i++) {
+        if(buf->data == messages[i])
+            processed[processedSize] = i;
+    }
+    processedSize++;
+    while(!released) {}
+}
+
+static UA_StatusCode
+orderStart(UA_ServerNetworkLayer *nl, UA_Logger logger) {
+    return UA_STATUSCODE_GOOD;
+}
+
+static size_t
+orderGetJobs(UA_ServerNetworkLayer *nl, UA_Job **jobs, UA_UInt16 timeout) {
+    getJobsCalls++;
+    size_t first, last;
+    if(getJobsCalls == 1) {
+        first = 0;
+        last = 1;
+    } else if(getJobsCalls == 2) {
+        first = 1;
+        last = MESSAGES;
+    } else {
+        released = true;
+        return 0;
+    }
+    *jobs = malloc(sizeof(UA_Job) * (last - first));
+    for(size_t i = first; i < last; i++) {
+        UA_Job *job = &(*jobs)[i - first];
+        job->type = UA_JOBTYPE_BINARYMESSAGE_NETWORKLAYER;
+        job->job.binaryMessage.connection = &connection;
+        job->job.binaryMessage.message.data = messages[i];
+        job->job.binaryMessage.message.length = MESSAGESIZE;
+    }
+    return last - first;
+}
+
+static size_t
+orderStop(UA_ServerNetworkLayer *nl, UA_Job **jobs) {
+    *jobs = NULL;
+    return 0;
+}
+
+static void orderDeleteMembers(UA_ServerNetworkLayer *nl) {}
+
+START_TEST(affinityKeepsConnectionOrder) {
+    /* A chunked request, followed by a publish request */
+    encodeChunk(messages[0], 'F', 1, UA_NS0ID_READREQUEST);
+    encodeChunk(messages[1], 'C', 2, UA_NS0ID_READREQUEST);
+    encodeChunk(messages[2], 'C', 2, UA_NS0ID_PUBLISHREQUEST);
+    encodeChunk(messages[3], 'F', 2, UA_NS0ID_PUBLISHREQUEST);
+    encodeChunk(messages[4], 'F', 3, UA_NS0ID_PUBLISHREQUEST);
+    encodeChunk(messages[5], 'F', 4, UA_NS0ID_READREQUEST);
+    connection = createDummyConnection();
+    connection.releaseRecvBuffer = recordReleaseRecvBuffer;
+    processedSize = 0;
+    getJobsCalls = 0;
+    released = false;
+
+    UA_ServerNetworkLayer nl;
+    memset(&nl, 0, sizeof(nl));
+    nl.start = orderStart;
+    nl.getJobs = orderGetJobs;
+    nl.stop = orderStop;
+    nl.deleteMembers = orderDeleteMembers;
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.logger = NULL;
+    config.nThreads = 2;
+    config.connectionAffinity = true;
+    config.networkLayers = &nl;
+    config.networkLayersSize = 1;
+    UA_Server *server = UA_Server_new(config);
+    UA_Server_run_startup(server);
+    for(size_t i = 0; i < 3; i++)
+        UA_Server_run_iterate(server, false);
+    UA_Server_run_shutdown(server);
+    UA_Server_delete(server);
+
+    ck_assert_int_eq(processedSize, MESSAGES);
+    for(size_t i = 0; i < MESSAGES; i++)
+        ck_assert_int_eq(processed[i], i);
+    UA_Connection_deleteMembers(&connection);
+} END_TEST
+
+static void dummyJob(UA_Server *server, void *data) {}
+
+#define REPEATEDJOBS 40
+
+START_TEST(repeatedJobHandles) {
+    UA_ServerConfig config = UA_ServerConfig_standard;
+    config.logger = NULL;
+    config.nThreads = 2;
+    config.networkLayersSize = 0;
+    UA_Server *server = UA_Server_new(config);
+    UA_Server_run_startup(server);
+    UA_Server_run_iterate(server, false);
+    size_t base = server->repeatedJobsSize;
+
+    /* The handles are valid before the main loop adds the jobs. More jobs
+       than the initial heap capacity are added at once. */
+    UA_Job job = {.type = UA_JOBTYPE_METHODCALL, .job.methodCall = {.data = NULL, .method = dummyJob}};
+    UA_RepeatedJob *handles[REPEATEDJOBS];
+    for(size_t i = 0; i < REPEATEDJOBS; i++)
+        ck_assert_int_eq(UA_Server_addRepeatedJobHandle(server, job, 1000, &handles[i]),
+                         UA_STATUSCODE_GOOD);
+    for(size_t i = 0; i < REPEATEDJOBS / 4; i++)
+        ck_assert_int_eq(UA_Server_removeRepeatedJobHandle(server, handles[i]), UA_STATUSCODE_GOOD);
+    UA_Server_run_iterate(server, false);
+    ck_assert_int_eq(server->repeatedJobsSize, base + REPEATEDJOBS - (REPEATEDJOBS / 4));
+    ck_assert_int_eq(server->repeatedJobsReserved, server->repeatedJobsSize);
+    ck_assert(server->repeatedJobsCapacity >= server->repeatedJobsSize);
+
+    for(size_t i = REPEATEDJOBS / 4; i < REPEATEDJOBS; i++)
+        UA_Server_removeRepeatedJobHandle(server, handles[i]);
+    UA_Server_run_iterate(server, false);
+    ck_assert_int_eq(server->repeatedJobsSize, base);
+    ck_assert_int_eq(server->repeatedJobsReserved, base);
+
+    UA_Server_run_shutdown(server);
+    UA_Server_delete(server);
+} END_TEST
+
+static Suite * testSuite_dispatch(void) {
+    Suite *s = suite_create("Server dispatch");
+    TCase *tc_lanes = tcase_create("lanes");
+    tcase_add_test(tc_lanes, classifyChunkedMessages);
+    tcase_add_test(tc_lanes, affinityKeepsConnectionOrder);
+    suite_add_tcase(s, tc_lanes);
+    TCase *tc_repeated = tcase_create("repeated jobs");
+    tcase_add_test(tc_repeated, repeatedJobHandles);
+    suite_add_tcase(s, tc_repeated);
+    return s;
+}
+
+int main(void) {
+    int number_failed = 0;
+    Suite *s = testSuite_dispatch();
+    SRunner *sr = srunner_create(s);
+    srunner_set_fork_status(sr, CK_NOFORK);
+    srunner_run_all(sr, CK_NORMAL);
+    number_failed += srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return (number_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -121,8 +121,8 @@ static UA_Server* makeTestSequence(void) {
 	return server;
 }
 
-static UA_VariableNode* makeCompareSequence(void) {
-	UA_VariableNode *node = UA_NodeStore_newVariableNode();
+static UA_VariableNode* makeCompareSequence(UA_Server *server) {
+	UA_VariableNode *node = UA_NodeStore_newVariableNode(server->nodestore);
 
 	UA_Int32 myInteger = 42;
 	UA_Variant_setScalarCopy(&node->value.variant.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
@@ -142,6 +142,7 @@ static UA_VariableNode* makeCompareSequence(void) {
 
 START_TEST(ReadSingleAttributeValueWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -154,6 +155,7 @@ START_TEST(ReadSingleAttributeValueWithoutTimestamp) {
     ck_assert_int_eq(0, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_INT32], resp.value.type);
     ck_assert_int_eq(42, *(UA_Int32* )resp.value.data);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
@@ -161,6 +163,7 @@ START_TEST(ReadSingleAttributeValueWithoutTimestamp) {
 
 START_TEST(ReadSingleAttributeValueRangeWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -173,6 +176,7 @@ START_TEST(ReadSingleAttributeValueRangeWithoutTimestamp) {
     Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rReq.nodesToRead[0], &resp);
     ck_assert_int_eq(4, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_INT32], resp.value.type);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
@@ -180,6 +184,7 @@ START_TEST(ReadSingleAttributeValueRangeWithoutTimestamp) {
 
 START_TEST(ReadSingleAttributeNodeIdWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -197,11 +202,13 @@ START_TEST(ReadSingleAttributeNodeIdWithoutTimestamp) {
     ck_assert(UA_String_equal(&myIntegerNodeId.identifier.string, &respval->identifier.string));
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeNodeClassWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -216,11 +223,13 @@ START_TEST(ReadSingleAttributeNodeClassWithoutTimestamp) {
     ck_assert_int_eq(*(UA_Int32*)resp.value.data,UA_NODECLASS_VARIABLE);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeBrowseNameWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -238,11 +247,13 @@ START_TEST(ReadSingleAttributeBrowseNameWithoutTimestamp) {
     ck_assert(UA_String_equal(&myIntegerName.name, &respval->name));
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeDisplayNameWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -254,19 +265,21 @@ START_TEST(ReadSingleAttributeDisplayNameWithoutTimestamp) {
     Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rReq.nodesToRead[0], &resp);
     UA_LocalizedText* respval = (UA_LocalizedText*) resp.value.data;
     const UA_LocalizedText comp = UA_LOCALIZEDTEXT("locale", "the answer");
-    UA_VariableNode* compNode = makeCompareSequence();
+    UA_VariableNode* compNode = makeCompareSequence(server);
     ck_assert_int_eq(0, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_LOCALIZEDTEXT], resp.value.type);
     ck_assert(UA_String_equal(&comp.text, &respval->text));
     ck_assert(UA_String_equal(&compNode->displayName.locale, &respval->locale));
-    UA_Server_delete(server);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
-    UA_NodeStore_deleteNode((UA_Node*)compNode);
+    UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)compNode);
+    UA_RCU_UNLOCK();
+    UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeDescriptionWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -277,19 +290,21 @@ START_TEST(ReadSingleAttributeDescriptionWithoutTimestamp) {
     rReq.nodesToRead[0].attributeId = UA_ATTRIBUTEID_DESCRIPTION;
     Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rReq.nodesToRead[0], &resp);
     UA_LocalizedText* respval = (UA_LocalizedText*) resp.value.data;
-    UA_VariableNode* compNode = makeCompareSequence();
+    UA_VariableNode* compNode = makeCompareSequence(server);
     ck_assert_int_eq(0, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_LOCALIZEDTEXT], resp.value.type);
     ck_assert(UA_String_equal(&compNode->description.locale, &respval->locale));
     ck_assert(UA_String_equal(&compNode->description.text, &respval->text));
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
-    UA_NodeStore_deleteNode((UA_Node*)compNode);
+    UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)compNode);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeWriteMaskWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -305,11 +320,13 @@ START_TEST(ReadSingleAttributeWriteMaskWithoutTimestamp) {
     ck_assert_int_eq(0,*respval);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeUserWriteMaskWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -325,11 +342,13 @@ START_TEST(ReadSingleAttributeUserWriteMaskWithoutTimestamp) {
     ck_assert_int_eq(0,*respval);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeIsAbstractWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -344,11 +363,13 @@ START_TEST(ReadSingleAttributeIsAbstractWithoutTimestamp) {
     ck_assert(*(UA_Boolean* )resp.value.data==false);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeSymmetricWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -363,11 +384,13 @@ START_TEST(ReadSingleAttributeSymmetricWithoutTimestamp) {
     ck_assert(*(UA_Boolean* )resp.value.data==false);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeInverseNameWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -385,11 +408,13 @@ START_TEST(ReadSingleAttributeInverseNameWithoutTimestamp) {
     ck_assert(UA_String_equal(&comp.locale, &respval->locale));
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeContainsNoLoopsWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -404,11 +429,13 @@ START_TEST(ReadSingleAttributeContainsNoLoopsWithoutTimestamp) {
     ck_assert(*(UA_Boolean* )resp.value.data==false);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeEventNotifierWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -424,11 +451,13 @@ START_TEST(ReadSingleAttributeEventNotifierWithoutTimestamp) {
     ck_assert_int_eq(*(UA_Byte*)resp.value.data, 0);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeDataTypeWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -445,11 +474,13 @@ START_TEST(ReadSingleAttributeDataTypeWithoutTimestamp) {
     ck_assert_int_eq(respval->identifier.numeric,UA_NS0ID_INT32);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeValueRankWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -464,11 +495,13 @@ START_TEST(ReadSingleAttributeValueRankWithoutTimestamp) {
     ck_assert_int_eq(-2, *(UA_Int32* )resp.value.data);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeArrayDimensionsWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -483,11 +516,13 @@ START_TEST(ReadSingleAttributeArrayDimensionsWithoutTimestamp) {
     ck_assert_ptr_eq((UA_Int32*)resp.value.data,0);
     UA_DataValue_deleteMembers(&resp);
     UA_ReadRequest_deleteMembers(&rReq);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeAccessLevelWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -502,11 +537,13 @@ START_TEST(ReadSingleAttributeAccessLevelWithoutTimestamp) {
     ck_assert_int_eq(*(UA_Byte*)resp.value.data, 0);
     UA_DataValue_deleteMembers(&resp);
     UA_ReadRequest_deleteMembers(&rReq);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeUserAccessLevelWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -521,6 +558,7 @@ START_TEST(ReadSingleAttributeUserAccessLevelWithoutTimestamp) {
     ck_assert_int_eq(0, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_BYTE], resp.value.type);
     ck_assert_int_eq(*(UA_Byte*)resp.value.data, compNode->userAccessLevel);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
     UA_DataValue_deleteMembers(&resp);
     UA_ReadRequest_deleteMembers(&rReq);
@@ -528,6 +566,7 @@ START_TEST(ReadSingleAttributeUserAccessLevelWithoutTimestamp) {
 
 START_TEST(ReadSingleAttributeMinimumSamplingIntervalWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -538,19 +577,21 @@ START_TEST(ReadSingleAttributeMinimumSamplingIntervalWithoutTimestamp) {
     rReq.nodesToRead[0].attributeId = UA_ATTRIBUTEID_MINIMUMSAMPLINGINTERVAL;
     Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rReq.nodesToRead[0], &resp);
     UA_Double* respval = (UA_Double*) resp.value.data;
-    UA_VariableNode *compNode = makeCompareSequence();
+    UA_VariableNode *compNode = makeCompareSequence(server);
     UA_Double comp = (UA_Double) compNode->minimumSamplingInterval;
     ck_assert_int_eq(0, resp.value.arrayLength);
     ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_DOUBLE], resp.value.type);
     ck_assert(*respval == comp);
     UA_DataValue_deleteMembers(&resp);
     UA_ReadRequest_deleteMembers(&rReq);
-    UA_NodeStore_deleteNode((UA_Node*)compNode);
+    UA_NodeStore_deleteNode(server->nodestore, (UA_Node*)compNode);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeHistorizingWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -565,12 +606,14 @@ START_TEST(ReadSingleAttributeHistorizingWithoutTimestamp) {
     ck_assert(*(UA_Boolean*)resp.value.data==false);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(ReadSingleAttributeExecutableWithoutTimestamp) {
 #ifdef UA_ENABLE_METHODCALLS
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -585,6 +628,7 @@ START_TEST(ReadSingleAttributeExecutableWithoutTimestamp) {
     ck_assert(*(UA_Boolean*)resp.value.data==false);
     UA_DataValue_deleteMembers(&resp);
     UA_ReadRequest_deleteMembers(&rReq);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 #endif
 } END_TEST
@@ -592,6 +636,7 @@ START_TEST(ReadSingleAttributeExecutableWithoutTimestamp) {
 START_TEST(ReadSingleAttributeUserExecutableWithoutTimestamp) {
 #ifdef UA_ENABLE_METHODCALLS
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -606,12 +651,14 @@ START_TEST(ReadSingleAttributeUserExecutableWithoutTimestamp) {
     ck_assert(*(UA_Boolean*)resp.value.data==false);
     UA_DataValue_deleteMembers(&resp);
     UA_ReadRequest_deleteMembers(&rReq);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 #endif
 } END_TEST
 
 START_TEST(ReadSingleDataSourceAttributeDataTypeWithoutTimestampFromBrokenSource) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -622,6 +669,7 @@ START_TEST(ReadSingleDataSourceAttributeDataTypeWithoutTimestampFromBrokenSource
     rReq.nodesToRead[0].attributeId = UA_ATTRIBUTEID_DATATYPE;
     Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rReq.nodesToRead[0], &resp);
     ck_assert_int_eq(UA_STATUSCODE_GOOD, resp.status);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
@@ -629,6 +677,7 @@ START_TEST(ReadSingleDataSourceAttributeDataTypeWithoutTimestampFromBrokenSource
 
 START_TEST(ReadSingleDataSourceAttributeValueWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -639,13 +688,74 @@ START_TEST(ReadSingleDataSourceAttributeValueWithoutTimestamp) {
     rReq.nodesToRead[0].attributeId = UA_ATTRIBUTEID_VALUE;
     Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rReq.nodesToRead[0], &resp);
     ck_assert_int_eq(UA_STATUSCODE_BADINTERNALERROR, resp.status);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
 } END_TEST
 
+START_TEST(ReadManyAttributesInBatches) {
+    UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
+    UA_ReadRequest rReq;
+    UA_ReadRequest_init(&rReq);
+    rReq.nodesToReadSize = 100;
+    rReq.nodesToRead = UA_Array_new(rReq.nodesToReadSize, &UA_TYPES[UA_TYPES_READVALUEID]);
+    for(size_t i = 0; i < rReq.nodesToReadSize; i++) {
+        switch(i % 4) {
+        case 0:
+            rReq.nodesToRead[i].nodeId = UA_NODEID_STRING_ALLOC(1, "the.answer");
+            rReq.nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+            break;
+        case 1:
+            rReq.nodesToRead[i].nodeId = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+            rReq.nodesToRead[i].attributeId = UA_ATTRIBUTEID_BROWSENAME;
+            break;
+        case 2:
+            rReq.nodesToRead[i].nodeId = UA_NODEID_NUMERIC(1, 4242);
+            rReq.nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+            break;
+        default:
+            rReq.nodesToRead[i].nodeId = UA_NODEID_STRING_ALLOC(1, "cpu.temperature");
+            rReq.nodesToRead[i].attributeId = UA_ATTRIBUTEID_VALUE;
+            break;
+        }
+    }
+    UA_ReadResponse rResp;
+    UA_ReadResponse_init(&rResp);
+    Service_Read(server, &adminSession, &rReq, &rResp);
+    ck_assert_int_eq(rResp.responseHeader.serviceResult, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(rResp.resultsSize, rReq.nodesToReadSize);
+    for(size_t i = 0; i < rResp.resultsSize; i++) {
+        UA_DataValue *v = &rResp.results[i];
+        switch(i % 4) {
+        case 0:
+            ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_INT32], v->value.type);
+            ck_assert_int_eq(42, *(UA_Int32*)v->value.data);
+            break;
+        case 1: {
+            UA_QualifiedName objects = UA_QUALIFIEDNAME(0, "Objects");
+            ck_assert_ptr_eq(&UA_TYPES[UA_TYPES_QUALIFIEDNAME], v->value.type);
+            ck_assert(UA_String_equal(&objects.name, &((UA_QualifiedName*)v->value.data)->name));
+            break;
+        }
+        case 2:
+            ck_assert_int_eq(UA_STATUSCODE_BADNODEIDUNKNOWN, v->status);
+            break;
+        default:
+            ck_assert_int_eq(UA_STATUSCODE_BADINTERNALERROR, v->status);
+            break;
+        }
+    }
+    UA_RCU_UNLOCK();
+    UA_Server_delete(server);
+    UA_ReadRequest_deleteMembers(&rReq);
+    UA_ReadResponse_deleteMembers(&rResp);
+} END_TEST
+
 START_TEST(ReadSingleDataSourceAttributeDataTypeWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -656,6 +766,7 @@ START_TEST(ReadSingleDataSourceAttributeDataTypeWithoutTimestamp) {
     rReq.nodesToRead[0].attributeId = UA_ATTRIBUTEID_DATATYPE;
     Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rReq.nodesToRead[0], &resp);
     ck_assert_int_eq(UA_STATUSCODE_BADINTERNALERROR, resp.status);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
@@ -663,6 +774,7 @@ START_TEST(ReadSingleDataSourceAttributeDataTypeWithoutTimestamp) {
 
 START_TEST (ReadSingleDataSourceAttributeArrayDimensionsWithoutTimestamp) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_DataValue resp;
     UA_DataValue_init(&resp);
     UA_ReadRequest rReq;
@@ -673,6 +785,7 @@ START_TEST (ReadSingleDataSourceAttributeArrayDimensionsWithoutTimestamp) {
     rReq.nodesToRead[0].attributeId = UA_ATTRIBUTEID_ARRAYDIMENSIONS;
     Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &rReq.nodesToRead[0], &resp);
     ck_assert_int_eq(UA_STATUSCODE_BADINTERNALERROR, resp.status);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
     UA_ReadRequest_deleteMembers(&rReq);
     UA_DataValue_deleteMembers(&resp);
@@ -682,6 +795,7 @@ START_TEST (ReadSingleDataSourceAttributeArrayDimensionsWithoutTimestamp) {
 
 START_TEST(WriteSingleAttributeNodeId) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_NodeId id;
@@ -692,11 +806,13 @@ START_TEST(WriteSingleAttributeNodeId) {
     UA_Variant_setScalar(&wValue.value.value, &id, &UA_TYPES[UA_TYPES_NODEID]);
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_BADWRITENOTSUPPORTED);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeNodeclass) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     wValue.nodeId = UA_NODEID_STRING(1, "the.answer");
@@ -707,11 +823,13 @@ START_TEST(WriteSingleAttributeNodeclass) {
     UA_Variant_setScalar(&wValue.value.value, &class, &UA_TYPES[UA_TYPES_NODECLASS]);
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_BADWRITENOTSUPPORTED);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeBrowseName) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_QualifiedName testValue = UA_QUALIFIEDNAME(1, "the.answer");
@@ -721,11 +839,13 @@ START_TEST(WriteSingleAttributeBrowseName) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeDisplayName) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_LocalizedText testValue = UA_LOCALIZEDTEXT("en_EN", "the.answer");
@@ -735,11 +855,13 @@ START_TEST(WriteSingleAttributeDisplayName) {
     wValue.attributeId = UA_ATTRIBUTEID_DISPLAYNAME;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeDescription) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_LocalizedText testValue = UA_LOCALIZEDTEXT("en_EN", "the.answer");
@@ -751,11 +873,13 @@ START_TEST(WriteSingleAttributeDescription) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeWriteMask) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Int32 testValue = 0;
@@ -766,11 +890,13 @@ START_TEST(WriteSingleAttributeWriteMask) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeUserWriteMask) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Int32 testValue = 0;
@@ -780,11 +906,13 @@ START_TEST(WriteSingleAttributeUserWriteMask) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeIsAbstract) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Boolean testValue = true;
@@ -794,11 +922,13 @@ START_TEST(WriteSingleAttributeIsAbstract) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_BADNODECLASSINVALID);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeSymmetric) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Boolean testValue = true;
@@ -808,11 +938,13 @@ START_TEST(WriteSingleAttributeSymmetric) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_BADNODECLASSINVALID);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeInverseName) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_LocalizedText testValue = UA_LOCALIZEDTEXT("en_US", "not.the.answer");
@@ -822,11 +954,13 @@ START_TEST(WriteSingleAttributeInverseName) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_BADNODECLASSINVALID);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeContainsNoLoops) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Boolean testValue = true;
@@ -836,11 +970,13 @@ START_TEST(WriteSingleAttributeContainsNoLoops) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_BADNODECLASSINVALID);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeEventNotifier) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Byte testValue = 0;
@@ -850,11 +986,13 @@ START_TEST(WriteSingleAttributeEventNotifier) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_BADNODECLASSINVALID);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeValue) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Int32 myInteger = 20;
@@ -875,11 +1013,54 @@ START_TEST(WriteSingleAttributeValue) {
     ck_assert(wValue.value.hasValue);
     ck_assert_int_eq(20, *(UA_Int32*)resp.value.data);
     UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
+    UA_Server_delete(server);
+} END_TEST
+
+START_TEST(WriteSingleAttributeValueRepeated) {
+    UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
+    UA_WriteValue wValue;
+    UA_WriteValue_init(&wValue);
+    UA_Int32 myInteger = 20;
+    UA_Variant_setScalar(&wValue.value.value, &myInteger, &UA_TYPES[UA_TYPES_INT32]);
+    wValue.value.hasValue = true;
+    wValue.nodeId = UA_NODEID_STRING(1, "the.answer");
+    wValue.attributeId = UA_ATTRIBUTEID_VALUE;
+    UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+
+    /* With multithreading, later writes swap the value without replacing the node */
+    const UA_Node *node = UA_NodeStore_get(server->nodestore, &wValue.nodeId);
+    for(myInteger = 21; myInteger < 25; myInteger++) {
+        retval = Service_Write_single(server, &adminSession, &wValue);
+        ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+        ck_assert_ptr_eq(UA_NodeStore_get(server->nodestore, &wValue.nodeId), node);
+    }
+
+    /* The type is still checked */
+    UA_Double myDouble = 1.0;
+    UA_Variant_setScalar(&wValue.value.value, &myDouble, &UA_TYPES[UA_TYPES_DOUBLE]);
+    retval = Service_Write_single(server, &adminSession, &wValue);
+    ck_assert_int_eq(retval, UA_STATUSCODE_BADTYPEMISMATCH);
+
+    UA_DataValue resp;
+    UA_DataValue_init(&resp);
+    UA_ReadValueId id;
+    UA_ReadValueId_init(&id);
+    id.nodeId = UA_NODEID_STRING(1, "the.answer");
+    id.attributeId = UA_ATTRIBUTEID_VALUE;
+    Service_Read_single(server, &adminSession, UA_TIMESTAMPSTORETURN_NEITHER, &id, &resp);
+    ck_assert(resp.hasValue);
+    ck_assert_int_eq(24, *(UA_Int32*)resp.value.data);
+    UA_DataValue_deleteMembers(&resp);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeDataType) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_NodeId typeId;
@@ -890,11 +1071,13 @@ START_TEST(WriteSingleAttributeDataType) {
     UA_Variant_setScalar(&wValue.value.value, &typeId, &UA_TYPES[UA_TYPES_NODEID]);
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_BADWRITENOTSUPPORTED);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeValueRank) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Int32 testValue = -1;
@@ -905,11 +1088,13 @@ START_TEST(WriteSingleAttributeValueRank) {
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     // Returns attributeInvalid, since variant/value may be writable
     ck_assert_int_eq(retval, UA_STATUSCODE_BADATTRIBUTEIDINVALID);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeArrayDimensions) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Int32 testValue[] = {-1,-1,-1};
@@ -920,11 +1105,13 @@ START_TEST(WriteSingleAttributeArrayDimensions) {
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     // Returns attributeInvalid, since variant/value may be writable
     ck_assert_int_eq(retval, UA_STATUSCODE_BADATTRIBUTEIDINVALID);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeAccessLevel) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Byte testValue = 0;
@@ -934,11 +1121,13 @@ START_TEST(WriteSingleAttributeAccessLevel) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeUserAccessLevel) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Byte testValue = 0;
@@ -948,11 +1137,13 @@ START_TEST(WriteSingleAttributeUserAccessLevel) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeMinimumSamplingInterval) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Double testValue = 0.0;
@@ -962,11 +1153,13 @@ START_TEST(WriteSingleAttributeMinimumSamplingInterval) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeHistorizing) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Boolean testValue = true;
@@ -976,11 +1169,13 @@ START_TEST(WriteSingleAttributeHistorizing) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_GOOD);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeExecutable) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Boolean testValue = true;
@@ -990,11 +1185,13 @@ START_TEST(WriteSingleAttributeExecutable) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_BADNODECLASSINVALID);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleAttributeUserExecutable) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Boolean testValue = true;
@@ -1004,11 +1201,13 @@ START_TEST(WriteSingleAttributeUserExecutable) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_BADNODECLASSINVALID);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
 START_TEST(WriteSingleDataSourceAttributeValue) {
     UA_Server *server = makeTestSequence();
+    UA_RCU_LOCK();
     UA_WriteValue wValue;
     UA_WriteValue_init(&wValue);
     UA_Int32 testValue = 0;
@@ -1018,6 +1217,7 @@ START_TEST(WriteSingleDataSourceAttributeValue) {
     wValue.value.hasValue = true;
     UA_StatusCode retval = Service_Write_single(server, &adminSession, &wValue);
     ck_assert_int_eq(retval, UA_STATUSCODE_BADWRITENOTSUPPORTED);
+    UA_RCU_UNLOCK();
     UA_Server_delete(server);
 } END_TEST
 
@@ -1067,6 +1267,7 @@ static Suite * testSuite_services_attributes(void) {
         tcase_add_test(tc_readSingleAttributes, ReadSingleDataSourceAttributeValueWithoutTimestamp);
 	tcase_add_test(tc_readSingleAttributes, ReadSingleDataSourceAttributeDataTypeWithoutTimestamp);
 	tcase_add_test(tc_readSingleAttributes, ReadSingleDataSourceAttributeArrayDimensionsWithoutTimestamp);
+	tcase_add_test(tc_readSingleAttributes, ReadManyAttributesInBatches);
 
 	suite_add_tcase(s, tc_readSingleAttributes);
 
@@ -1084,6 +1285,7 @@ static Suite * testSuite_services_attributes(void) {
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeContainsNoLoops);
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeEventNotifier);
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValue);
+	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRepeated);
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeDataType);
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeValueRank);
 	tcase_add_test(tc_writeSingleAttributes, WriteSingleAttributeArrayDimensions);
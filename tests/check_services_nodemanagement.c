@@ -88,6 +88,239 @@ START_TEST(AddNodeTwiceGivesError) {
     UA_Server_delete(server);
 } END_TEST
 
+/* Returns the first target of a forward reference of the given type */
+static const UA_Node *
+findTarget(UA_Server *server, const UA_Node *node, UA_UInt32 referenceType) {
+    for(size_t i = 0; i < node->referencesSize; i++) {
+        const UA_ReferenceNode *rn = &node->references[i];
+        if(!rn->isInverse && rn->referenceTypeId.namespaceIndex == 0 &&
+           rn->referenceTypeId.identifier.numeric == referenceType)
+            return UA_NodeStore_get(server->nodestore, &rn->targetId.nodeId);
+    }
+    return NULL;
+}
+
+START_TEST(InstantiateObjectType) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+    /* an object type with a variable */
+    UA_ObjectTypeAttributes otattr;
+    UA_ObjectTypeAttributes_init(&otattr);
+    otattr.displayName = UA_LOCALIZEDTEXT("en_US", "DeviceType");
+    UA_NodeId deviceType = UA_NODEID_NUMERIC(1, 5000);
+    UA_StatusCode res =
+        UA_Server_addObjectTypeNode(server, deviceType, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                    UA_QUALIFIEDNAME(1, "DeviceType"), otattr, NULL, NULL);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    UA_NodeId variable = UA_NODEID_NUMERIC(1, 5001);
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Double temperature = 20.5;
+    UA_Variant_setScalar(&vattr.value, &temperature, &UA_TYPES[UA_TYPES_DOUBLE]);
+    vattr.displayName = UA_LOCALIZEDTEXT("en_US", "Temperature");
+    vattr.description = UA_LOCALIZEDTEXT("en_US", "The temperature of the device");
+    res = UA_Server_addVariableNode(server, variable, deviceType,
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                    UA_QUALIFIEDNAME(1, "Temperature"),
+                                    UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                                    vattr, NULL, NULL);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+
+#ifndef UA_ENABLE_MULTITHREADING
+    /* intern the strings of the type */
+    UA_NodeStoreCursor c;
+    UA_NodeStoreCursor_init(&c);
+    UA_NodeStore_maintain(server->nodestore, &c, 0);
+#endif
+
+    /* two instances */
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    oattr.displayName = UA_LOCALIZEDTEXT("en_US", "Device");
+    for(UA_UInt32 i = 1; i <= 2; i++) {
+        res = UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 6000 + i),
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                                      UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                      UA_QUALIFIEDNAME(1, "Device"), deviceType, oattr, NULL, NULL);
+        ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    }
+
+    UA_RCU_LOCK();
+    UA_NodeId device1 = UA_NODEID_NUMERIC(1, 6001);
+    const UA_Node *prototype = UA_NodeStore_get(server->nodestore, &variable);
+    const UA_Node *device = UA_NodeStore_get(server->nodestore, &device1);
+    ck_assert_ptr_ne(device, NULL);
+    const UA_Node *type = findTarget(server, device, UA_NS0ID_HASTYPEDEFINITION);
+    ck_assert_ptr_ne(type, NULL);
+    ck_assert(UA_NodeId_equal(&type->nodeId, &deviceType));
+
+    /* the instance of the variable */
+    const UA_VariableNode *instance =
+        (const UA_VariableNode*)findTarget(server, device, UA_NS0ID_HASCOMPONENT);
+    ck_assert_ptr_ne(instance, NULL);
+    ck_assert(!UA_NodeId_equal(&instance->nodeId, &prototype->nodeId));
+    ck_assert_int_eq(instance->browseName.namespaceIndex, prototype->browseName.namespaceIndex);
+    ck_assert(UA_String_equal(&instance->browseName.name, &prototype->browseName.name));
+    ck_assert(UA_String_equal(&instance->description.text, &prototype->description.text));
+    ck_assert_int_eq(*(UA_Double*)instance->value.variant.value.data, 20.5);
+    ck_assert_ptr_ne(instance->value.variant.value.data,
+                     ((const UA_VariableNode*)prototype)->value.variant.value.data);
+    type = findTarget(server, (const UA_Node*)instance, UA_NS0ID_HASTYPEDEFINITION);
+    ck_assert_ptr_ne(type, NULL);
+    ck_assert_int_eq(type->nodeId.identifier.numeric, UA_NS0ID_BASEDATAVARIABLETYPE);
+    UA_Boolean hasParent = false;
+    for(size_t i = 0; i < instance->referencesSize; i++) {
+        if(instance->references[i].isInverse &&
+           UA_NodeId_equal(&instance->references[i].targetId.nodeId, &device1))
+            hasParent = true;
+    }
+    ck_assert(hasParent);
+#ifndef UA_ENABLE_MULTITHREADING
+    /* the strings are shared with the variable of the type */
+    ck_assert_ptr_eq(instance->browseName.name.data, prototype->browseName.name.data);
+    ck_assert_ptr_eq(instance->description.text.data, prototype->description.text.data);
+#endif
+    UA_NodeId instanceId = instance->nodeId;
+    UA_RCU_UNLOCK();
+
+    /* writing the instance does not change the type */
+    res = UA_Server_writeDisplayName(server, instanceId, UA_LOCALIZEDTEXT("de", "Temperatur"));
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    UA_RCU_LOCK();
+    prototype = UA_NodeStore_get(server->nodestore, &variable);
+    UA_String name = UA_STRING("Temperature");
+    ck_assert(UA_String_equal(&prototype->displayName.text, &name));
+    UA_RCU_UNLOCK();
+
+    res = UA_Server_deleteNode(server, UA_NODEID_NUMERIC(1, 6002), true);
+    ck_assert_int_eq(res, UA_STATUSCODE_GOOD);
+    UA_Server_delete(server);
+} END_TEST
+
+static void
+setAddNodesItem(UA_AddNodesItem *item, UA_NodeClass nodeClass, UA_NodeId nodeId,
+                UA_NodeId parent, UA_UInt32 referenceType, UA_NodeId typeDefinition,
+                const UA_DataType *attributesType, void *attributes) {
+    UA_AddNodesItem_init(item);
+    item->nodeClass = nodeClass;
+    item->requestedNewNodeId.nodeId = nodeId;
+    item->parentNodeId.nodeId = parent;
+    item->referenceTypeId = UA_NODEID_NUMERIC(0, referenceType);
+    item->typeDefinition.nodeId = typeDefinition;
+    item->browseName = UA_QUALIFIEDNAME(1, "Batch");
+    item->nodeAttributes.encoding = UA_EXTENSIONOBJECT_DECODED_NODELETE;
+    item->nodeAttributes.content.decoded.type = attributesType;
+    item->nodeAttributes.content.decoded.data = attributes;
+}
+
+static UA_Boolean
+hasForwardReference(const UA_Node *node, const UA_NodeId *target) {
+    for(size_t i = 0; i < node->referencesSize; i++) {
+        if(!node->references[i].isInverse &&
+           UA_NodeId_equal(&node->references[i].targetId.nodeId, target))
+            return true;
+    }
+    return false;
+}
+
+#define BATCH_DEVICES 20
+
+START_TEST(AddNodesBatch) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+
+    UA_ObjectTypeAttributes otattr;
+    UA_ObjectTypeAttributes_init(&otattr);
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    UA_Double temperature = 20.5;
+    UA_Variant_setScalar(&vattr.value, &temperature, &UA_TYPES[UA_TYPES_DOUBLE]);
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+
+    /* A type with a variable, a folder and instances of the type in the folder.
+       The last two items fail. */
+    UA_AddNodesItem items[BATCH_DEVICES + 5];
+    UA_NodeId deviceType = UA_NODEID_NUMERIC(1, 7000);
+    UA_NodeId folder = UA_NODEID_NUMERIC(1, 7100);
+    setAddNodesItem(&items[0], UA_NODECLASS_OBJECTTYPE, deviceType,
+                    UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), UA_NS0ID_HASSUBTYPE,
+                    UA_NODEID_NULL, &UA_TYPES[UA_TYPES_OBJECTTYPEATTRIBUTES], &otattr);
+    setAddNodesItem(&items[1], UA_NODECLASS_VARIABLE, UA_NODEID_NUMERIC(1, 7001), deviceType,
+                    UA_NS0ID_HASCOMPONENT, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                    &UA_TYPES[UA_TYPES_VARIABLEATTRIBUTES], &vattr);
+    items[1].browseName = UA_QUALIFIEDNAME(1, "Temperature");
+    setAddNodesItem(&items[2], UA_NODECLASS_OBJECT, folder,
+                    UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER), UA_NS0ID_ORGANIZES,
+                    UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE),
+                    &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES], &oattr);
+    for(UA_UInt32 i = 0; i < BATCH_DEVICES; i++)
+        setAddNodesItem(&items[3 + i], UA_NODECLASS_OBJECT, UA_NODEID_NUMERIC(1, 7200 + i),
+                        folder, UA_NS0ID_ORGANIZES, deviceType,
+                        &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES], &oattr);
+    setAddNodesItem(&items[BATCH_DEVICES + 3], UA_NODECLASS_OBJECT, UA_NODEID_NUMERIC(1, 7998),
+                    UA_NODEID_NUMERIC(1, 9999), UA_NS0ID_ORGANIZES, UA_NODEID_NULL,
+                    &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES], &oattr);
+    setAddNodesItem(&items[BATCH_DEVICES + 4], UA_NODECLASS_OBJECT, UA_NODEID_NUMERIC(1, 7999),
+                    folder, UA_NS0ID_ORGANIZES, UA_NODEID_NUMERIC(0, UA_NS0ID_BASEDATAVARIABLETYPE),
+                    &UA_TYPES[UA_TYPES_OBJECTATTRIBUTES], &oattr);
+
+    UA_AddNodesRequest request;
+    UA_AddNodesRequest_init(&request);
+    request.nodesToAdd = items;
+    request.nodesToAddSize = BATCH_DEVICES + 5;
+    UA_AddNodesResponse response;
+    UA_AddNodesResponse_init(&response);
+    UA_RCU_LOCK();
+    Service_AddNodes(server, &adminSession, &request, &response);
+
+    ck_assert_int_eq(response.resultsSize, BATCH_DEVICES + 5);
+    for(size_t i = 0; i < BATCH_DEVICES + 3; i++)
+        ck_assert_int_eq(response.results[i].statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(response.results[BATCH_DEVICES + 3].statusCode,
+                     UA_STATUSCODE_BADPARENTNODEIDINVALID);
+    ck_assert_int_eq(response.results[BATCH_DEVICES + 4].statusCode,
+                     UA_STATUSCODE_BADNODECLASSINVALID);
+    ck_assert_ptr_eq(UA_NodeStore_get(server->nodestore, &items[BATCH_DEVICES + 3].requestedNewNodeId.nodeId), NULL);
+    ck_assert_ptr_eq(UA_NodeStore_get(server->nodestore, &items[BATCH_DEVICES + 4].requestedNewNodeId.nodeId), NULL);
+
+    /* the folder references the devices in the order of the request */
+    const UA_Node *folderNode = UA_NodeStore_get(server->nodestore, &folder);
+    ck_assert_ptr_ne(folderNode, NULL);
+    UA_UInt32 next = 7200;
+    for(size_t i = 0; i < folderNode->referencesSize; i++) {
+        const UA_ReferenceNode *rn = &folderNode->references[i];
+        if(rn->isInverse || rn->referenceTypeId.identifier.numeric != UA_NS0ID_ORGANIZES)
+            continue;
+        ck_assert_int_eq(rn->targetId.nodeId.identifier.numeric, next);
+        next++;
+    }
+    ck_assert_int_eq(next, 7200 + BATCH_DEVICES);
+
+    /* the devices are instances of the type added in the same request */
+    UA_String temperatureName = UA_STRING("Temperature");
+    for(UA_UInt32 i = 0; i < BATCH_DEVICES; i++) {
+        const UA_Node *device = UA_NodeStore_get(server->nodestore, &items[3 + i].requestedNewNodeId.nodeId);
+        ck_assert_ptr_ne(device, NULL);
+        const UA_Node *type = findTarget(server, device, UA_NS0ID_HASTYPEDEFINITION);
+        ck_assert_ptr_ne(type, NULL);
+        ck_assert(UA_NodeId_equal(&type->nodeId, &deviceType));
+        const UA_Node *instance = findTarget(server, device, UA_NS0ID_HASCOMPONENT);
+        ck_assert_ptr_ne(instance, NULL);
+        ck_assert(UA_String_equal(&instance->browseName.name, &temperatureName));
+    }
+
+    /* the parents outside of the request reference the new nodes */
+    const UA_Node *baseType = UA_NodeStore_get(server->nodestore, &items[0].parentNodeId.nodeId);
+    ck_assert(hasForwardReference(baseType, &deviceType));
+    const UA_Node *objects = UA_NodeStore_get(server->nodestore, &items[2].parentNodeId.nodeId);
+    ck_assert(hasForwardReference(objects, &folder));
+    UA_RCU_UNLOCK();
+
+    UA_AddNodesResponse_deleteMembers(&response);
+    UA_Server_delete(server);
+} END_TEST
+
 static Suite * testSuite_services_nodemanagement(void) {
 	Suite *s = suite_create("services_nodemanagement");
 
@@ -95,6 +328,8 @@ static Suite * testSuite_services_nodemanagement(void) {
 	tcase_add_test(tc_addnodes, AddVariableNode);
         tcase_add_test(tc_addnodes, AddComplexTypeWithInheritance);
 	tcase_add_test(tc_addnodes, AddNodeTwiceGivesError);
+	tcase_add_test(tc_addnodes, InstantiateObjectType);
+	tcase_add_test(tc_addnodes, AddNodesBatch);
 
 	suite_add_tcase(s, tc_addnodes);
 	return s;
@@ -3,6 +3,8 @@
 
 #include "ua_types.h"
 #include "server/ua_services.h"
+#include "server/ua_server_internal.h"
+#include "ua_nodeids.h"
 #include "ua_statuscodes.h"
 #include "check.h"
 
@@ -28,10 +30,192 @@
 }
 END_TEST */
 
+/* A folder with many devices that have the same children */
+static UA_Server * makeDeviceFolder(void) {
+    UA_Server *server = UA_Server_new(UA_ServerConfig_standard);
+    UA_ObjectAttributes oattr;
+    UA_ObjectAttributes_init(&oattr);
+    UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 1000),
+                            UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER),
+                            UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), UA_QUALIFIEDNAME(1, "Devices"),
+                            UA_NODEID_NUMERIC(0, UA_NS0ID_FOLDERTYPE), oattr, NULL, NULL);
+    UA_VariableAttributes vattr;
+    UA_VariableAttributes_init(&vattr);
+    char name[32];
+    for(UA_UInt32 i = 0; i < 100; i++) {
+        snprintf(name, sizeof(name), "Device%u", i);
+        UA_Server_addObjectNode(server, UA_NODEID_NUMERIC(1, 2000 + i), UA_NODEID_NUMERIC(1, 1000),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES), UA_QUALIFIEDNAME(1, name),
+                                UA_NODEID_NUMERIC(0, UA_NS0ID_BASEOBJECTTYPE), oattr, NULL, NULL);
+        UA_Server_addVariableNode(server, UA_NODEID_NUMERIC(1, 3000 + i), UA_NODEID_NUMERIC(1, 2000 + i),
+                                  UA_NODEID_NUMERIC(0, UA_NS0ID_HASCOMPONENT),
+                                  UA_QUALIFIEDNAME(1, "Status"), UA_NODEID_NULL, vattr, NULL, NULL);
+    }
+    return server;
+}
+
+static void translateDevicePath(UA_Server *server, const char *device, UA_BrowsePathResult *result) {
+    UA_RelativePathElement elements[3];
+    const char *names[3] = {"Devices", device, "Status"};
+    for(size_t i = 0; i < 3; i++) {
+        UA_RelativePathElement_init(&elements[i]);
+        elements[i].referenceTypeId = UA_NODEID_NUMERIC(0, UA_NS0ID_HIERARCHICALREFERENCES);
+        elements[i].includeSubtypes = true;
+        elements[i].targetName = UA_QUALIFIEDNAME(1, (char*)(uintptr_t)names[i]);
+    }
+    UA_BrowsePath path;
+    UA_BrowsePath_init(&path);
+    path.startingNode = UA_NODEID_NUMERIC(0, UA_NS0ID_OBJECTSFOLDER);
+    path.relativePath.elementsSize = 3;
+    path.relativePath.elements = elements;
+    UA_BrowsePathResult_init(result);
+    UA_RCU_LOCK();
+    Service_TranslateBrowsePathsToNodeIds_single(server, &adminSession, &path, result);
+    UA_RCU_UNLOCK();
+}
+
+START_TEST(TranslatePathThroughLargeFolder) {
+    UA_Server *server = makeDeviceFolder();
+    UA_BrowsePathResult result;
+    translateDevicePath(server, "Device57", &result);
+    ck_assert_int_eq(result.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(result.targetsSize, 1);
+    ck_assert_int_eq(result.targets[0].targetId.nodeId.identifier.numeric, 3057);
+    UA_BrowsePathResult_deleteMembers(&result);
+
+    translateDevicePath(server, "Device100", &result);
+    ck_assert_int_eq(result.statusCode, UA_STATUSCODE_BADNOMATCH);
+    UA_BrowsePathResult_deleteMembers(&result);
+
+    /* The path follows a renamed device */
+    UA_Server_writeBrowseName(server, UA_NODEID_NUMERIC(1, 2057), UA_QUALIFIEDNAME(1, "Renamed"));
+    translateDevicePath(server, "Device57", &result);
+    ck_assert_int_eq(result.statusCode, UA_STATUSCODE_BADNOMATCH);
+    UA_BrowsePathResult_deleteMembers(&result);
+    translateDevicePath(server, "Renamed", &result);
+    ck_assert_int_eq(result.statusCode, UA_STATUSCODE_GOOD);
+    ck_assert_int_eq(result.targets[0].targetId.nodeId.identifier.numeric, 3057);
+    UA_BrowsePathResult_deleteMembers(&result);
+
+    UA_Server_delete(server);
+}
+END_TEST
+
+static void browseDevices(UA_Server *server, UA_Session *session, UA_UInt32 referenceType,
+                          UA_BrowseDirection direction, UA_UInt32 maxrefs, UA_BrowseResult *result) {
+    UA_BrowseDescription descr;
+    UA_BrowseDescription_init(&descr);
+    descr.nodeId = UA_NODEID_NUMERIC(1, 1000);
+    descr.browseDirection = direction;
+    descr.referenceTypeId = UA_NODEID_NUMERIC(0, referenceType);
+    descr.includeSubtypes = true;
+    descr.resultMask = UA_BROWSERESULTMASK_ALL;
+    UA_BrowseResult_init(result);
+    UA_RCU_LOCK();
+    Service_Browse_single(server, session, NULL, &descr, maxrefs, result);
+    UA_RCU_UNLOCK();
+}
+
+START_TEST(BrowseLargeFolderInPages) {
+    UA_Server *server = makeDeviceFolder();
+    UA_Session session;
+    UA_Session_init(&session);
+
+    /* The devices are returned in order over several pages */
+    UA_BrowseResult result;
+    browseDevices(server, &session, UA_NS0ID_HIERARCHICALREFERENCES, UA_BROWSEDIRECTION_FORWARD,
+                  30, &result);
+    UA_UInt32 devices = 0;
+    for(;;) {
+        ck_assert_int_eq(result.statusCode, UA_STATUSCODE_GOOD);
+        for(size_t i = 0; i < result.referencesSize; i++) {
+            UA_ReferenceDescription *rd = &result.references[i];
+            ck_assert_int_eq(rd->nodeId.nodeId.identifier.numeric, 2000 + devices);
+            ck_assert(rd->isForward);
+            ck_assert_int_eq(rd->referenceTypeId.identifier.numeric, UA_NS0ID_ORGANIZES);
+            ck_assert_int_eq(rd->typeDefinition.nodeId.identifier.numeric, UA_NS0ID_BASEOBJECTTYPE);
+            devices++;
+        }
+        if(result.continuationPoint.length == 0)
+            break;
+        UA_ByteString cp = result.continuationPoint;
+        UA_ByteString_init(&result.continuationPoint);
+        UA_BrowseResult_deleteMembers(&result);
+        UA_BrowseResult_init(&result);
+        UA_RCU_LOCK();
+        UA_Server_browseNext_single(server, &session, false, &cp, &result);
+        UA_RCU_UNLOCK();
+        UA_ByteString_deleteMembers(&cp);
+    }
+    ck_assert_int_eq(devices, 100);
+    ck_assert_int_eq(session.availableContinuationPoints, MAXCONTINUATIONPOINTS);
+    UA_BrowseResult_deleteMembers(&result);
+
+    /* Only the inverse reference from the objects folder */
+    browseDevices(server, &session, UA_NS0ID_HIERARCHICALREFERENCES, UA_BROWSEDIRECTION_INVERSE,
+                  0, &result);
+    ck_assert_int_eq(result.referencesSize, 1);
+    ck_assert_int_eq(result.references[0].nodeId.nodeId.identifier.numeric, UA_NS0ID_OBJECTSFOLDER);
+    UA_BrowseResult_deleteMembers(&result);
+
+    /* Only the type definition */
+    browseDevices(server, &session, UA_NS0ID_HASTYPEDEFINITION, UA_BROWSEDIRECTION_BOTH,
+                  0, &result);
+    ck_assert_int_eq(result.referencesSize, 1);
+    ck_assert_int_eq(result.references[0].nodeId.nodeId.identifier.numeric, UA_NS0ID_FOLDERTYPE);
+    UA_BrowseResult_deleteMembers(&result);
+
+    UA_Session_deleteMembersCleanup(&session, server);
+    UA_Server_delete(server);
+}
+END_TEST
+
+START_TEST(BrowseNewReferenceSubtype) {
+    UA_Server *server = makeDeviceFolder();
+    UA_BrowseResult result;
+    browseDevices(server, &adminSession, UA_NS0ID_ORGANIZES, UA_BROWSEDIRECTION_FORWARD, 0, &result);
+    ck_assert_int_eq(result.referencesSize, 100);
+    UA_BrowseResult_deleteMembers(&result);
+
+    /* A new subtype of Organizes */
+    UA_ReferenceTypeAttributes rattr;
+    UA_ReferenceTypeAttributes_init(&rattr);
+    UA_NodeId linksTo = UA_NODEID_NUMERIC(1, 4000);
+    ck_assert_int_eq(UA_Server_addReferenceTypeNode(server, linksTo,
+                                                    UA_NODEID_NUMERIC(0, UA_NS0ID_ORGANIZES),
+                                                    UA_NODEID_NUMERIC(0, UA_NS0ID_HASSUBTYPE),
+                                                    UA_QUALIFIEDNAME(1, "LinksTo"), rattr,
+                                                    NULL, NULL), UA_STATUSCODE_GOOD);
+    UA_ExpandedNodeId status = UA_EXPANDEDNODEID_NUMERIC(1, 3000);
+    ck_assert_int_eq(UA_Server_addReference(server, UA_NODEID_NUMERIC(1, 1000), linksTo,
+                                            status, true), UA_STATUSCODE_GOOD);
+    browseDevices(server, &adminSession, UA_NS0ID_ORGANIZES, UA_BROWSEDIRECTION_FORWARD, 0, &result);
+    ck_assert_int_eq(result.referencesSize, 101);
+    ck_assert_int_eq(result.references[100].nodeId.nodeId.identifier.numeric, 3000);
+    ck_assert(UA_NodeId_equal(&result.references[100].referenceTypeId, &linksTo));
+    UA_BrowseResult_deleteMembers(&result);
+    browseDevices(server, &adminSession, UA_NS0ID_HIERARCHICALREFERENCES, UA_BROWSEDIRECTION_BOTH,
+                  0, &result);
+    ck_assert_int_eq(result.referencesSize, 102);
+    UA_BrowseResult_deleteMembers(&result);
+
+    /* The reference type is removed */
+    ck_assert_int_eq(UA_Server_deleteNode(server, linksTo, false), UA_STATUSCODE_GOOD);
+    browseDevices(server, &adminSession, UA_NS0ID_ORGANIZES, UA_BROWSEDIRECTION_FORWARD, 0, &result);
+    ck_assert_int_eq(result.referencesSize, 100);
+    UA_BrowseResult_deleteMembers(&result);
+
+    UA_Server_delete(server);
+}
+END_TEST
+
 static Suite* testSuite_Service_TranslateBrowsePathsToNodeIds(void) {
 	Suite *s = suite_create("Service_TranslateBrowsePathsToNodeIds");
 	TCase *tc_core = tcase_create("Core");
 	//tcase_add_test(tc_core, Service_TranslateBrowsePathsToNodeIds_SmokeTest);
+	tcase_add_test(tc_core, TranslatePathThroughLargeFolder);
+	tcase_add_test(tc_core, BrowseLargeFolderInPages);
+	tcase_add_test(tc_core, BrowseNewReferenceSubtype);
 	suite_add_tcase(s,tc_core);
 	return s;
 }
@@ -38,6 +38,7 @@ UA_Connection createDummyConnection(void) {
     c.sockfd = 0;
     c.handle = NULL;
     c.incompleteMessage = UA_BYTESTRING_NULL;
+    c.chunkedRequestsSize = 0;
     c.getSendBuffer = dummyGetSendBuffer;
     c.releaseSendBuffer = dummyReleaseSendBuffer;
     c.send = dummySend;
@@ -24,7 +24,7 @@ from logger import *
 
 def usage():
   print("Script usage:")
-  print("generate_open62541CCode [-i <ignorefile> | -b <blacklistfile>] <namespace XML> [namespace.xml[ namespace.xml[...]]] <output file>\n")
+  print("generate_open62541CCode [-i <ignorefile> | -b <blacklistfile> | --image] <namespace XML> [namespace.xml[ namespace.xml[...]]] <output file>\n")
   print("generate_open62541CCode will first read all XML files passed on the command line, then ")
   print("link and check the namespace. All nodes that fullfill the basic requirements will then be")
   print("printed as C-Code intended to be included in the open62541 OPC-UA Server that will")
@@ -44,6 +44,9 @@ def usage():
   print("""   -s <attribute>  Suppresses the generation of some node attributes. Currently supported
                        options are 'description', 'browseName', 'displayName', 'writeMask', 'userWriteMask'
                        and 'nodeid'.""")
+  print("""   --image             Prints the nodes as a constant image that is served by the nodestore
+                       without copying (instead of code that creates the nodes at runtime).
+                       All nodes must have a numeric nodeid from the same namespace.""")
   print("""   namespaceXML Any number of namespace descriptions in XML format. Note that the
                        last description of a node encountered will be used and all prior definitions
                        are discarded.""")
@@ -55,6 +58,7 @@ if __name__ == '__main__':
   ignoreFiles = []
   blacklistFiles = []
   supressGenerationOfAttribute=[]
+  printImage = False
 
   GLOBAL_LOG_LEVEL = LOG_LEVEL_DEBUG
   
@@ -93,6 +97,8 @@ if __name__ == '__main__':
         arg_isBlacklist = True
       elif filename.lower() == "-s" or filename.lower() == "--suppress" :
         arg_isSupress = True
+      elif filename.lower() == "--image" :
+        printImage = True
       else:
         log(None, "File " + str(filename) + " does not exist.", LOG_LEVEL_ERROR)
         usage()
@@ -175,7 +181,10 @@ if __name__ == '__main__':
   # Create the C Code
   log(None, "Generating Header", LOG_LEVEL_INFO)
   # Returns a tuple of (["Header","lines"],["Code","lines","generated"])
-  generatedCode=ns.printOpen62541Header(ignoreNodes, supressGenerationOfAttribute, outfilename=path.basename(argv[-1]))
+  if printImage:
+    generatedCode=ns.printOpen62541Image(ignoreNodes, supressGenerationOfAttribute, outfilename=path.basename(argv[-1]))
+  else:
+    generatedCode=ns.printOpen62541Header(ignoreNodes, supressGenerationOfAttribute, outfilename=path.basename(argv[-1]))
   for line in generatedCode[0]:
     outfileh.write(line+"\n")
   for line in generatedCode[1]:
@@ -217,7 +217,7 @@ class open62541_MacroHelper():
       code.append("/* undefined nodeclass */")
       return;
 
-    code.append("UA_" + nodetype + "Node *" + node.getCodePrintableID() + " = UA_NodeStore_new" + nodetype + "Node();")
+    code.append("UA_" + nodetype + "Node *" + node.getCodePrintableID() + " = UA_NodeStore_new" + nodetype + "Node(server->nodestore);")
     if not "browsename" in self.supressGenerationOfAttribute:
       extrNs = node.browseName().split(":")
       if len(extrNs) > 1:
@@ -259,3 +259,37 @@ class open62541_MacroHelper():
         return []
 
     return code
+
+  ###
+  ### Constant initializers for the image of a namespace (--image)
+  ###
+
+  def getImageCString(self, data):
+    """ Returns a C string literal for the (utf-8 encoded) bytes in data. """
+    code = "\""
+    for c in bytearray(data):
+      if c == 0x22 or c == 0x5c:
+        code += "\\" + chr(c)
+      elif c >= 0x20 and c < 0x7f and c != 0x3f: # no trigraphs
+        code += chr(c)
+      else:
+        code += "\\%03o" % c
+    return code + "\""
+
+  def getImageString(self, data):
+    """ Returns the initializer of a UA_String with static content. """
+    if data == None or len(data) == 0:
+      return "{0, NULL}"
+    if not isinstance(data, bytes) and not isinstance(data, bytearray):
+      data = data.encode('utf-8')
+    return "{" + str(len(data)) + ", (UA_Byte*)" + self.getImageCString(data) + "}"
+
+  def getImageLocalizedText(self, locale, text):
+    return "{" + self.getImageString(locale) + ", " + self.getImageString(text) + "}"
+
+  def getImageQualifiedName(self, namespaceIndex, name):
+    return "{" + str(namespaceIndex) + ", " + self.getImageString(name) + "}"
+
+  def getImageNodeId(self, node):
+    """ Only numeric nodeids are part of an image. """
+    return "{" + str(node.id().ns) + ", UA_NODEIDTYPE_NUMERIC, {" + str(node.id().i) + "}}"
@@ -17,6 +17,7 @@
 ###
 
 import sys
+import struct
 import xml.dom.minidom as dom
 from ua_constants import *
 from logger import *
@@ -401,6 +402,83 @@ class opcua_value_t():
           code.append("UA_" + self.value[0].stringRepresentation + "_deleteMembers(&" + valueName + ");")
     return code
 
+  def printOpen62541Image(self, codegen):
+    """ printOpen62541Image
+
+        Returns a tuple (["definitions"], "initializer") with the constant
+        data of the value and the initializer of a UA_Variant that points to
+        it. The initializer is None if the value cannot be printed as constant
+        data.
+    """
+    valueName = self.parent.getCodePrintableID() + "_value"
+    if self.value == None or len(self.value) == 0:
+      return ([], None)
+    if not isinstance(self.value[0], opcua_value_t):
+      return ([], None)
+
+    # Same rule for arrays as in printOpen62541CCode
+    isArray = self.parent.valueRank() != -1 and (self.parent.valueRank() >= 0 or len(self.value) > 1)
+    code = []
+    elements = []
+    for v in self.value:
+      element = v.printOpen62541Image_SubType(codegen, valueName + "_" + str(len(elements)))
+      if element == None:
+        log(self, "Don't know how to print " + v.stringRepresentation + " as constant data in node " + str(self.parent.id()), LOG_LEVEL_WARN)
+        return ([], None)
+      code = code + element[0]
+      elements.append(element[1])
+
+    typeName = self.value[0].stringRepresentation
+    if isArray:
+      code.append("static const UA_" + typeName + " " + valueName + "[" + str(len(elements)) + "] = {")
+      for e in elements:
+        code.append("    " + e + ",")
+      code.append("};")
+      data = str(len(elements)) + ", (void*)" + valueName
+    else:
+      code.append("static const UA_" + typeName + " " + valueName + " = " + elements[0] + ";")
+      data = "0, (void*)&" + valueName
+    return (code, "{&UA_TYPES[UA_TYPES_" + typeName.upper() + "], UA_VARIANT_DATA_NODELETE, " + data + ", 0, NULL}")
+
+  # Formats of the numeric builtin types in the binary encoding
+  __binaryFormats__ = { "SByte": "<b", "Byte": "<B", "Int16": "<h", "UInt16": "<H",
+                        "Int32": "<i", "UInt32": "<I", "Int64": "<q", "UInt64": "<Q",
+                        "Float": "<f", "Double": "<d" }
+
+  def printOpen62541Image_SubType(self, codegen, name):
+    """ printOpen62541Image_SubType
+
+        Returns a tuple (["definitions"], "initializer") for a single element
+        of the value or None if the type is not supported. The base class
+        handles the numeric types.
+    """
+    if not self.stringRepresentation in self.__binaryFormats__:
+      return None
+    if self.stringRepresentation in ["Float", "Double"]:
+      return ([], repr(float(self.value)))
+    if self.stringRepresentation == "Int64":
+      return ([], str(self.value) + "LL")
+    if self.stringRepresentation == "UInt64":
+      return ([], str(self.value) + "ULL")
+    return ([], str(self.value))
+
+  def encodeOpen62541Binary(self):
+    """ encodeOpen62541Binary
+
+        Returns the binary encoding of the value or None if the type is not
+        supported. The base class handles the numeric types.
+    """
+    if not self.stringRepresentation in self.__binaryFormats__:
+      return None
+    return struct.pack(self.__binaryFormats__[self.stringRepresentation], self.value)
+
+  def encodeOpen62541BinaryString(self, data):
+    if data == None or len(data) == 0:
+      return struct.pack("<i", -1)
+    if not isinstance(data, bytes):
+      data = data.encode('utf-8')
+    return struct.pack("<i", len(data)) + data
+
 
 ###
 ### Actual buitlin types
@@ -522,6 +600,29 @@ class opcua_BuiltinType_extensionObject_t(opcua_value_t):
   def __str__(self):
     return "'" + self.alias() + "':" + self.stringRepresentation + "(" + str(self.value) + ")"
 
+  def printOpen62541Image_SubType(self, codegen, name):
+    # Encoded as a bytestring like in printOpen62541CCode_SubType_build
+    body = self.encodeOpen62541Binary()
+    dataType = self.parent.dataType().target()
+    if body == None or dataType.id().i == None:
+      return None
+    # The binary encoding id is the datatype id + UA_ENCODINGOFFSET_BINARY (2)
+    typeId = "{" + str(dataType.id().ns) + ", UA_NODEIDTYPE_NUMERIC, {" + str(dataType.id().i + 2) + "}}"
+    return ([], "{UA_EXTENSIONOBJECT_ENCODED_BYTESTRING, {.encoded = {" + typeId + ", " + codegen.getImageString(body) + "}}}")
+
+  def encodeOpen62541Binary(self):
+    # The fields are encoded one after another. Arrays of fields are not
+    # supported.
+    data = b""
+    for subv in self.value:
+      if isinstance(subv, list):
+        return None
+      encoded = subv.encodeOpen62541Binary()
+      if encoded == None:
+        return None
+      data = data + encoded
+    return data
+
 class opcua_BuiltinType_localizedtext_t(opcua_value_t):
   def setStringReprentation(self):
     self.stringRepresentation = "LocalizedText"
@@ -589,6 +690,20 @@ class opcua_BuiltinType_localizedtext_t(opcua_value_t):
         code = "UA_LOCALIZEDTEXT(\"" + str(self.value[0]) + "\", \"" + str(self.value[1].encode('utf-8')) + "\")"
       return code
 
+  def printOpen62541Image_SubType(self, codegen, name):
+    return ([], codegen.getImageLocalizedText(self.value[0], self.value[1]))
+
+  def encodeOpen62541Binary(self):
+    mask = 0
+    data = b""
+    if len(self.value[0]) > 0:
+      mask = mask | 0x01
+      data = data + self.encodeOpen62541BinaryString(self.value[0])
+    if len(self.value[1]) > 0:
+      mask = mask | 0x02
+      data = data + self.encodeOpen62541BinaryString(self.value[1])
+    return struct.pack("<B", mask) + data
+
 class opcua_BuiltinType_expandednodeid_t(opcua_value_t):
   def setStringReprentation(self):
     self.stringRepresentation = "ExpandedNodeId"
@@ -660,6 +775,25 @@ class opcua_BuiltinType_nodeid_t(opcua_value_t):
       return "UA_NODEID_NUMERIC(0,0)"
     return "UA_NODEID_NUMERIC(0,0)"
 
+  def printOpen62541Image_SubType(self, codegen, name):
+    if self.value == None:
+      return ([], "{0, UA_NODEIDTYPE_NUMERIC, {0}}")
+    if self.value.id().i == None:
+      return None
+    return ([], codegen.getImageNodeId(self.value))
+
+  def encodeOpen62541Binary(self):
+    if self.value == None:
+      return struct.pack("<BB", 0, 0)
+    nodeId = self.value.id()
+    if nodeId.i == None:
+      return None
+    if nodeId.ns == 0 and nodeId.i <= 0xff:
+      return struct.pack("<BB", 0, nodeId.i) # two byte encoding
+    if nodeId.ns <= 0xff and nodeId.i <= 0xffff:
+      return struct.pack("<BBH", 1, nodeId.ns, nodeId.i) # four byte encoding
+    return struct.pack("<BHI", 2, nodeId.ns, nodeId.i)
+
 class opcua_BuiltinType_datetime_t(opcua_value_t):
   def setStringReprentation(self):
     self.stringRepresentation = "DateTime"
@@ -747,6 +881,12 @@ class opcua_BuiltinType_qualifiedname_t(opcua_value_t):
       code = "UA_QUALIFIEDNAME_ALLOC(" + str(self.value[0]) + ", \"" + self.value[1].encode('utf-8') + "\")"
       return code
 
+  def printOpen62541Image_SubType(self, codegen, name):
+    return ([], codegen.getImageQualifiedName(self.value[0], self.value[1]))
+
+  def encodeOpen62541Binary(self):
+    return struct.pack("<H", self.value[0]) + self.encodeOpen62541BinaryString(self.value[1])
+
 class opcua_BuiltinType_statuscode_t(opcua_value_t):
   def setStringReprentation(self):
     self.stringRepresentation = "StatusCode"
@@ -850,6 +990,14 @@ class opcua_BuiltinType_boolean_t(opcua_value_t):
   def printOpen62541CCode_SubType(self, asIndirect=True):
     return "(UA_" + self.stringRepresentation + ") " + str(self.value)
 
+  def printOpen62541Image_SubType(self, codegen, name):
+    return ([], str(self.value))
+
+  def encodeOpen62541Binary(self):
+    if self.value == "true":
+      return struct.pack("<B", 1)
+    return struct.pack("<B", 0)
+
 class opcua_BuiltinType_byte_t(opcua_value_t):
   def setStringReprentation(self):
     self.stringRepresentation = "Byte"
@@ -1223,6 +1371,12 @@ class opcua_BuiltinType_string_t(opcua_value_t):
       code = "UA_STRING_ALLOC(\"" + self.value.encode('utf-8') + "\")"
       return code
 
+  def printOpen62541Image_SubType(self, codegen, name):
+    return ([], codegen.getImageString(self.value))
+
+  def encodeOpen62541Binary(self):
+    return self.encodeOpen62541BinaryString(self.value)
+
 class opcua_BuiltinType_xmlelement_t(opcua_BuiltinType_string_t):
   def setStringReprentation(self):
     self.stringRepresentation = "XmlElement"
@@ -1274,3 +1428,8 @@ class opcua_BuiltinType_bytestring_t(opcua_value_t):
 #        outs = outs + hex(ord(s)).upper().replace("0X", "\\x")
       code = "UA_STRING_ALLOC(\"" + outs + "\")"
       return code
+
+  def printOpen62541Image_SubType(self, codegen, name):
+    # Keep the content as in printOpen62541CCode_SubType
+    return ([], codegen.getImageString(str(self.value).replace("\n","")))
+
@@ -712,6 +712,129 @@ class opcua_namespace():
     code.append("}")
     return (header,code)
 
+  def printOpen62541Image(self, printedExternally=[], supressGenerationOfAttribute=[], outfilename=""):
+    """ printOpen62541Image
+
+        Prints the nodes as constant data instead of code that creates them
+        at runtime. The nodes are placed in an open-addressing hash-map that is
+        served by the nodestore without copying (see UA_NodeStoreImage in
+        ua_nodestore.h). All references between nodes of the image are stored
+        in both directions. Only nodes with a numeric nodeid in the namespace
+        of the first node are part of the image.
+
+        Returns a tuple of (["Header","lines"],["Code","lines","generated"])
+    """
+    code = []
+    header = []
+    codegen = open62541_MacroHelper(supressGenerationOfAttribute=supressGenerationOfAttribute)
+
+    # Nodes below externally created nodes cannot be part of the image. They
+    # would collide with the children created together with their parents.
+    excluded = list(printedExternally)
+    changed = True
+    while changed:
+      changed = False
+      for n in self.nodes:
+        if not n in excluded:
+          (parentNode, parentRef) = n.getFirstParentNode()
+          if parentNode != None and parentNode in excluded:
+            excluded.append(n)
+            changed = True
+
+    imageNodes = []
+    for n in self.nodes:
+      if n in printedExternally:
+        log(self, "Node " + str(n.id()) + " is being ignored.", LOG_LEVEL_DEBUG)
+      elif n in excluded:
+        log(self, "Node " + str(n.id()) + " has an externally created parent and is being ignored.", LOG_LEVEL_DEBUG)
+      elif n.id().i == None or (len(imageNodes) > 0 and n.id().ns != imageNodes[0].id().ns):
+        log(self, "Node " + str(n.id()) + " is not numeric or from another namespace and cannot be part of the image.", LOG_LEVEL_ERROR)
+      else:
+        imageNodes.append(n)
+
+    # Collect the references in both directions without duplicates
+    references = {}
+    for n in imageNodes:
+      references[n] = []
+    def addReference(source, referenceType, isForward, target):
+      if not (referenceType, isForward, target) in references[source]:
+        references[source].append((referenceType, isForward, target))
+    for n in imageNodes:
+      for r in n.getReferences():
+        if not isinstance(r.target(), opcua_node_t) or not isinstance(r.referenceType(), opcua_node_t):
+          continue
+        if r.referenceType().id().i == None or r.target().id().i == None:
+          continue
+        if r.target() in references:
+          addReference(n, r.referenceType(), r.isForward(), r.target())
+          addReference(r.target(), r.referenceType(), not r.isForward(), n)
+        elif r.target() in excluded:
+          # Only this direction is stored. The target is created at runtime.
+          addReference(n, r.referenceType(), r.isForward(), r.target())
+
+    # The table has at least twice as many slots as there are nodes
+    tableBits = 1
+    while (1 << tableBits) < 2 * len(imageNodes):
+      tableBits = tableBits + 1
+    mask = (1 << tableBits) - 1
+    table = [None] * (1 << tableBits)
+    for n in imageNodes:
+      # Same as UA_NODESTORE_IMAGEHASH
+      idx = ((n.id().i * 2654435761) & 0xffffffff) >> (32 - tableBits)
+      while table[idx] != None:
+        idx = (idx + 1) & mask
+      table[idx] = n
+    log(self, str(len(imageNodes)) + " nodes are placed in an image with " + str(1 << tableBits) + " slots.", LOG_LEVEL_DEBUG)
+
+    header.append("/* WARNING: This is a generated file.\n * Any manual changes will be overwritten.\n\n */")
+    code.append("/* WARNING: This is a generated file.\n * Any manual changes will be overwritten.\n\n */")
+
+    header.append('#ifndef '+outfilename.upper()+'_H_')
+    header.append('#define '+outfilename.upper()+'_H_')
+    header.append('#ifdef UA_NO_AMALGAMATION')
+    header.append('#include "server/ua_server_internal.h"')
+    header.append('#include "server/ua_nodes.h"')
+    header.append('#include "server/ua_nodestore.h"')
+    header.append('#include "ua_util.h"')
+    header.append('#include "ua_types.h"')
+    header.append('#else')
+    header.append('#include "open62541.h"')
+    header.append('#define NULL ((void *)0)')
+    header.append('#endif')
+    header.append("extern void "+outfilename+"(UA_Server *server);\n")
+    header.append("#endif /* "+outfilename.upper()+"_H_ */")
+
+    code.append('#include "'+outfilename+'.h"')
+    code.append("")
+    code.append("/* The constant nodes point to constant strings and arrays */")
+    code.append("#if ((__GNUC__ == 4 && __GNUC_MINOR__ >= 6) || __GNUC__ > 4 || defined(__clang__))")
+    code.append("#pragma GCC diagnostic push")
+    code.append('#pragma GCC diagnostic ignored "-Wcast-qual"')
+    code.append("#endif")
+    for n in imageNodes:
+      code = code + n.printOpen62541Image(references[n], supressGenerationOfAttribute=supressGenerationOfAttribute)
+
+    code.append("")
+    code.append("static const UA_Node *const " + outfilename + "_table[" + str(1 << tableBits) + "] = {")
+    for idx in range(len(table)):
+      if table[idx] != None:
+        code.append("    [" + str(idx) + "] = (const UA_Node*)&" + table[idx].getCodePrintableID() + ",")
+    code.append("};")
+    code.append("#if ((__GNUC__ == 4 && __GNUC_MINOR__ >= 6) || __GNUC__ > 4 || defined(__clang__))")
+    code.append("#pragma GCC diagnostic pop")
+    code.append("#endif")
+    code.append("")
+    namespaceIndex = 0
+    if len(imageNodes) > 0:
+      namespaceIndex = imageNodes[0].id().ns
+    code.append("static const UA_NodeStoreImage " + outfilename + "_image = {" + str(namespaceIndex) + ", " +
+                str(tableBits) + ", " + outfilename + "_table};")
+    code.append("")
+    code.append("UA_INLINE void "+outfilename+"(UA_Server *server) {")
+    code.append("    UA_NodeStore_setImage(server->nodestore, &" + outfilename + "_image);")
+    code.append("}")
+    return (header,code)
+
 ###
 ### Testing
 ###
@@ -732,6 +732,72 @@ class opcua_node_t:
     code.append("} while(0);")
     return code
 
+  def printOpen62541Image_Subtype(self, codegen):
+    """ printOpen62541Image_Subtype
+
+        Returns a tuple (["definitions"], ["initializers"]) with the constant
+        data and the designated initializers of the node type specific members
+        for the image of the namespace.
+    """
+    return ([], [])
+
+  def printOpen62541Image(self, references, supressGenerationOfAttribute=[]):
+    """ printOpen62541Image
+
+        Returns a list of strings containing the C-code of the node as
+        constant data for the image of the namespace. The references are
+        given as a list of (referenceType, isForward, target) tuples. Only
+        numeric nodeids can be part of the image.
+    """
+    codegen = open62541_MacroHelper(supressGenerationOfAttribute=supressGenerationOfAttribute)
+    nodetypes = { NODE_CLASS_OBJECT: "Object", NODE_CLASS_VARIABLE: "Variable",
+                  NODE_CLASS_METHOD: "Method", NODE_CLASS_OBJECTTYPE: "ObjectType",
+                  NODE_CLASS_REFERENCETYPE: "ReferenceType", NODE_CLASS_VARIABLETYPE: "VariableType",
+                  NODE_CLASS_DATATYPE: "DataType", NODE_CLASS_VIEW: "View" }
+    if not self.nodeClass() in nodetypes:
+      log(self, "Node " + str(self.id()) + " has an undefined nodeclass and is not part of the image.", LOG_LEVEL_ERROR)
+      return []
+    nodetype = nodetypes[self.nodeClass()]
+    name = self.getCodePrintableID()
+
+    code = []
+    code.append("")
+    code.append("/* " + str(self.id()) + ", " + str(self.browseName()).replace("*/", "* /") + " */")
+    if len(references) > 0:
+      code.append("static const UA_ReferenceNode " + name + "_references[" + str(len(references)) + "] = {")
+      for (referenceType, isForward, target) in references:
+        isInverse = "false" if isForward else "true"
+        code.append("    {" + codegen.getImageNodeId(referenceType) + ", " + isInverse + ", {" +
+                    codegen.getImageNodeId(target) + ", {0, NULL}, 0}},")
+      code.append("};")
+    (definitions, initializers) = self.printOpen62541Image_Subtype(codegen)
+    code = code + definitions
+
+    code.append("static const UA_" + nodetype + "Node " + name + " = {")
+    code.append("    .nodeId = " + codegen.getImageNodeId(self) + ",")
+    code.append("    .nodeClass = UA_NODECLASS_" + nodetype.upper() + ",")
+    if not "browsename" in supressGenerationOfAttribute:
+      extrNs = self.browseName().split(":")
+      if len(extrNs) > 1:
+        code.append("    .browseName = " + codegen.getImageQualifiedName(extrNs[0], extrNs[1]) + ",")
+      else:
+        code.append("    .browseName = " + codegen.getImageQualifiedName(0, self.browseName()) + ",")
+    if not "displayname" in supressGenerationOfAttribute:
+      code.append("    .displayName = " + codegen.getImageLocalizedText("en_US", self.displayName()) + ",")
+    if not "description" in supressGenerationOfAttribute:
+      code.append("    .description = " + codegen.getImageLocalizedText("en_US", self.description()) + ",")
+    if not "writemask" in supressGenerationOfAttribute and self.__node_writeMask__ != 0:
+      code.append("    .writeMask = " + str(self.__node_writeMask__) + ",")
+    if not "userwritemask" in supressGenerationOfAttribute and self.__node_userWriteMask__ != 0:
+      code.append("    .userWriteMask = " + str(self.__node_userWriteMask__) + ",")
+    if len(references) > 0:
+      code.append("    .referencesSize = " + str(len(references)) + ",")
+      code.append("    .references = (UA_ReferenceNode*)" + name + "_references,")
+    for i in initializers:
+      code.append("    " + i + ",")
+    code.append("};")
+    return code
+
 class opcua_node_referenceType_t(opcua_node_t):
   __isAbstract__    = False
   __symmetric__     = False
@@ -838,6 +904,16 @@ class opcua_node_referenceType_t(opcua_node_t):
       code.append(self.getCodePrintableID() + "->inverseName  = UA_LOCALIZEDTEXT_ALLOC(\"en_US\", \"" + self.__reference_inverseName__ + "\");")
     return code;
 
+  def printOpen62541Image_Subtype(self, codegen):
+    initializers = []
+    if self.isAbstract():
+      initializers.append(".isAbstract = true")
+    if self.symmetric():
+      initializers.append(".symmetric = true")
+    if self.__reference_inverseName__ != "":
+      initializers.append(".inverseName = " + codegen.getImageLocalizedText("en_US", self.__reference_inverseName__))
+    return ([], initializers)
+
 
 class opcua_node_object_t(opcua_node_t):
   __object_eventNotifier__ = 0
@@ -899,6 +975,9 @@ class opcua_node_object_t(opcua_node_t):
     code.append(self.getCodePrintableID() + "->eventNotifier = (UA_Byte) " + str(self.eventNotifier()) + ";")
     return code
 
+  def printOpen62541Image_Subtype(self, codegen):
+    return ([], [".eventNotifier = " + str(self.eventNotifier())])
+
 if sys.version_info[0] >= 3:
   # strings are already parsed to unicode
   def unicode(s):
@@ -1101,6 +1180,24 @@ class opcua_node_variable_t(opcua_node_t):
     code.append(self.getCodePrintableID() + "->valueSource = UA_VALUESOURCE_VARIANT;")
     return code
 
+  def printOpen62541Image_Subtype(self, codegen):
+    definitions = []
+    initializers = []
+    # Only encodable values are printed (see printOpen62541CCode_SubtypeEarly)
+    if self.dataType() != None and isinstance(self.dataType().target(), opcua_node_dataType_t):
+      if self.dataType().target().isEncodable() and self.value() != None:
+        (definitions, variant) = self.value().printOpen62541Image(codegen)
+        if variant != None:
+          initializers.append(".value.variant.value = " + variant)
+    if self.historizing():
+      initializers.append(".historizing = true")
+    initializers.append(".minimumSamplingInterval = " + repr(float(self.minimumSamplingInterval())))
+    initializers.append(".userAccessLevel = " + str(self.userAccessLevel()))
+    initializers.append(".accessLevel = " + str(self.accessLevel()))
+    initializers.append(".valueRank = " + str(self.valueRank()))
+    initializers.append(".valueSource = UA_VALUESOURCE_VARIANT")
+    return (definitions, initializers)
+
 class opcua_node_method_t(opcua_node_t):
   __executable__     = True
   __userExecutable__ = True
@@ -1171,6 +1268,14 @@ class opcua_node_method_t(opcua_node_t):
 
     return code
 
+  def printOpen62541Image_Subtype(self, codegen):
+    initializers = []
+    if self.executable():
+      initializers.append(".executable = true")
+    if self.userExecutable():
+      initializers.append(".userExecutable = true")
+    return ([], initializers)
+
 class opcua_node_objectType_t(opcua_node_t):
   __isAbstract__ = False
 
@@ -1234,6 +1339,11 @@ class opcua_node_objectType_t(opcua_node_t):
 
     return code
 
+  def printOpen62541Image_Subtype(self, codegen):
+    if self.isAbstract():
+      return ([], [".isAbstract = true"])
+    return ([], [])
+
 class opcua_node_variableType_t(opcua_node_t):
   __value__ = 0
   __dataType__ = None
@@ -1356,6 +1466,13 @@ class opcua_node_variableType_t(opcua_node_t):
     code.append(self.getCodePrintableID() + "->valueSource = UA_VALUESOURCE_VARIANT;")
     return code
 
+  def printOpen62541Image_Subtype(self, codegen):
+    # The value of variable types is not parsed
+    initializers = [".valueSource = UA_VALUESOURCE_VARIANT"]
+    if self.isAbstract():
+      initializers.append(".isAbstract = true")
+    return ([], initializers)
+
 class opcua_node_dataType_t(opcua_node_t):
   """ opcua_node_dataType_t is a subtype of opcua_note_t describing DataType nodes.
 
@@ -1701,6 +1818,11 @@ class opcua_node_dataType_t(opcua_node_t):
       code.append(self.getCodePrintableID() + "->isAbstract = false;")
     return code
 
+  def printOpen62541Image_Subtype(self, codegen):
+    if self.isAbstract():
+      return ([], [".isAbstract = true"])
+    return ([], [])
+
 class opcua_node_view_t(opcua_node_t):
   __containsNoLoops__ = True
   __eventNotifier__   = 0
@@ -1766,3 +1888,10 @@ class opcua_node_view_t(opcua_node_t):
     code.append(self.getCodePrintableID() + "->eventNotifier = (UA_Byte) " + str(self.eventNotifier()) + ";")
 
     return code
+
+  def printOpen62541Image_Subtype(self, codegen):
+    initializers = [".eventNotifier = " + str(self.eventNotifier())]
+    if self.containsNoLoops():
+      initializers.append(".containsNoLoops = true")
+    return ([], initializers)
+
@@ -91,6 +91,12 @@ else
 	make -j8
 	cd .. && rm build -rf
 
+	echo "Compile multithreaded version with the generated namespace 0 (no image)"
+	mkdir -p build && cd build
+	cmake -DUA_ENABLE_MULTITHREADING=ON -DUA_ENABLE_GENERATE_NAMESPACE0=ON -DUA_BUILD_EXAMPLESERVER=ON -DUA_BUILD_EXAMPLES=ON ..
+	make -j8
+	cd .. && rm build -rf
+
 	#this run inclides full examples and methodcalls
 	echo "Debug build and unit tests (64 bit)"
 	mkdir -p build && cd build